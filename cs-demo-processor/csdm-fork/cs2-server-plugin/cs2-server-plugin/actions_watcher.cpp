@@ -0,0 +1,167 @@
+#include "actions_watcher.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#include "utils.h"
+
+using std::string;
+
+// Seconds between 2 checks, the playback loop runs much more often.
+#define INOTIFY_CHECK_INTERVAL 0.1
+#define POLLING_CHECK_INTERVAL 1.0
+#define DEBOUNCE_DELAY 0.3
+
+static bool isWatcherEnabled = true;
+static string watchedPath;
+static string watchedFileName;
+static double nextCheckTime = 0;
+// Time of the last detected modification not reported yet, 0 if none.
+static double pendingChangeTime = 0;
+// Polling state.
+static time_t lastModificationTime = 0;
+static off_t lastSize = -1;
+#ifndef _WIN32
+static int inotifyFd = -1;
+#endif
+
+static void GetFileState(time_t& modificationTime, off_t& size)
+{
+    struct stat fileStat;
+    if (stat(watchedPath.c_str(), &fileStat) == 0) {
+        modificationTime = fileStat.st_mtime;
+        size = fileStat.st_size;
+    }
+    else {
+        modificationTime = 0;
+        size = -1;
+    }
+}
+
+void SetActionsWatcherEnabled(bool isEnabled)
+{
+    isWatcherEnabled = isEnabled;
+    if (!isEnabled) {
+        StopWatchingActionsFile();
+    }
+}
+
+#ifndef _WIN32
+static bool ReadInotifyEvents();
+#endif
+
+void WatchActionsFile(const string& path, double now)
+{
+    // The same file loaded again keeps its watch, only the changes seen before the load are dropped.
+    if (isWatcherEnabled && !watchedPath.empty() && path == watchedPath) {
+        nextCheckTime = now;
+        pendingChangeTime = 0;
+        GetFileState(lastModificationTime, lastSize);
+#ifndef _WIN32
+        if (inotifyFd >= 0) {
+            ReadInotifyEvents();
+        }
+#endif
+        return;
+    }
+
+    StopWatchingActionsFile();
+    if (!isWatcherEnabled) {
+        return;
+    }
+
+    watchedPath = path;
+    size_t separatorIndex = path.find_last_of("/\\");
+    watchedFileName = separatorIndex == string::npos ? path : path.substr(separatorIndex + 1);
+    string directory = separatorIndex == string::npos ? "." : path.substr(0, separatorIndex);
+    nextCheckTime = now;
+    pendingChangeTime = 0;
+    GetFileState(lastModificationTime, lastSize);
+
+#ifndef _WIN32
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+
+    if (inotifyFd < 0) {
+        Log("Watching actions file %s by polling", path.c_str());
+    }
+#endif
+}
+
+void StopWatchingActionsFile()
+{
+    watchedPath.clear();
+#ifndef _WIN32
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+}
+
+#ifndef _WIN32
+// Returns true if an event concerns the actions file, reads all the pending events.
+static bool ReadInotifyEvents()
+{
+    bool hasChanged = false;
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (char* pointer = buffer; pointer < buffer + length;) {
+            struct inotify_event* event = (struct inotify_event*)pointer;
+            if (event->len > 0 && watchedFileName == event->name) {
+                hasChanged = true;
+            }
+            pointer += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return hasChanged;
+}
+#endif
+
+bool HasActionsFileChanged(double now)
+{
+    if (watchedPath.empty() || now < nextCheckTime) {
+        return false;
+    }
+
+    bool hasChanged = false;
+#ifndef _WIN32
+    if (inotifyFd >= 0) {
+        nextCheckTime = now + INOTIFY_CHECK_INTERVAL;
+        hasChanged = ReadInotifyEvents();
+    }
+    else
+#endif
+    {
+        nextCheckTime = now + POLLING_CHECK_INTERVAL;
+        time_t modificationTime;
+        off_t size;
+        GetFileState(modificationTime, size);
+        hasChanged = modificationTime != lastModificationTime || size != lastSize;
+        lastModificationTime = modificationTime;
+        lastSize = size;
+    }
+
+    if (hasChanged) {
+        pendingChangeTime = now;
+        return false;
+    }
+
+    if (pendingChangeTime > 0 && now - pendingChangeTime >= DEBOUNCE_DELAY) {
+        pendingChangeTime = 0;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+
+// Watches the actions file of the current demo so that changes are applied during the playback, without restarting
+// the game. It uses inotify on Linux and falls back to polling the file modification time (Windows, inotify limits
+// reached...).
+// The directory is watched rather than the file because editors usually save by replacing the file.
+// Only used from the playback thread.
+
+void SetActionsWatcherEnabled(bool isEnabled);
+// Watching the path already watched keeps the watch and only drops the changes seen so far.
+void WatchActionsFile(const std::string& path, double now);
+void StopWatchingActionsFile();
+// Returns true once when the file has been modified and no other modification happened during the debounce delay,
+// so that a file being written is not read.
+bool HasActionsFileChanged(double now);
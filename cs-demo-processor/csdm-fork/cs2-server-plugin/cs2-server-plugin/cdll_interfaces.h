@@ -1,3 +1,4 @@
+#pragma once
 //===== Copyright 1996-2005, Valve Corporation, All rights reserved. ======//
 //
 // Purpose: Interfaces between the client.dll and engine
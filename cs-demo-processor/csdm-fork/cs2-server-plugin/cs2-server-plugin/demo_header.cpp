@@ -0,0 +1,142 @@
+#include "demo_header.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using std::string;
+
+#define SOURCE2_DEMO_MAGIC "PBDEMS2"
+// EDemoCommands values from demo.proto.
+#define DEM_FILE_INFO 2
+#define DEM_IS_COMPRESSED 64
+// The file info message is small, bigger values mean that the offset is wrong.
+#define MAX_FILE_INFO_SIZE 4096
+// Tick rates outside of this range are considered invalid.
+#define MIN_TICK_INTERVAL (1.0 / 256)
+#define MAX_TICK_INTERVAL (1.0 / 16)
+
+static bool ReadVarInt(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        uint8_t byte = *data++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool ReadVarInt(std::ifstream& file, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = file.get();
+        if (byte == EOF) {
+            return false;
+        }
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Reads the playback_time (1, float) and playback_ticks (2, int32) fields of a CDemoFileInfo message.
+static bool ParseFileInfo(const uint8_t* data, const uint8_t* end, float& playbackTime, uint64_t& playbackTicks)
+{
+    bool hasTime = false;
+    bool hasTicks = false;
+    while (data < end) {
+        uint64_t key;
+        if (!ReadVarInt(data, end, key)) {
+            return false;
+        }
+
+        uint64_t value;
+        switch (key & 7) {
+        case 0:
+            if (!ReadVarInt(data, end, value)) {
+                return false;
+            }
+            if (key >> 3 == 2) {
+                playbackTicks = value;
+                hasTicks = true;
+            }
+            break;
+        case 1:
+            if (end - data < 8) {
+                return false;
+            }
+            data += 8;
+            break;
+        case 2:
+            if (!ReadVarInt(data, end, value) || value > (uint64_t)(end - data)) {
+                return false;
+            }
+            data += value;
+            break;
+        case 5:
+            if (end - data < 4) {
+                return false;
+            }
+            if (key >> 3 == 1) {
+                memcpy(&playbackTime, data, 4);
+                hasTime = true;
+            }
+            data += 4;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return hasTime && hasTicks;
+}
+
+double GetDemoTickInterval(const string& demoPath)
+{
+    std::ifstream file(demoPath, std::ios::binary);
+    char magic[8];
+    int32_t fileInfoOffset;
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, SOURCE2_DEMO_MAGIC, sizeof(magic)) != 0
+        || !file.read((char*)&fileInfoOffset, sizeof(fileInfoOffset)) || fileInfoOffset <= 16) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    uint64_t command;
+    uint64_t tick;
+    uint64_t size;
+    file.seekg(fileInfoOffset);
+    if (!ReadVarInt(file, command) || !ReadVarInt(file, tick) || !ReadVarInt(file, size) || size > MAX_FILE_INFO_SIZE) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    // Snappy compressed messages are not supported, the file info message is not compressed in practice.
+    if ((command & DEM_IS_COMPRESSED) != 0 || command != DEM_FILE_INFO) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    std::vector<uint8_t> message(size);
+    if (!file.read((char*)message.data(), size)) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    float playbackTime = 0;
+    uint64_t playbackTicks = 0;
+    if (!ParseFileInfo(message.data(), message.data() + message.size(), playbackTime, playbackTicks) || playbackTicks == 0) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    double tickInterval = playbackTime / playbackTicks;
+    if (tickInterval < MIN_TICK_INTERVAL || tickInterval > MAX_TICK_INTERVAL) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    return tickInterval;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+// CS2 demos are recorded at 64 ticks per second, the SDK DEFAULT_TICK_INTERVAL is 1/60.
+#define CSDM_DEFAULT_TICK_INTERVAL (1.0 / 64)
+
+// Returns the duration of a tick of the demo in seconds, computed from the playback time and ticks of the CDemoFileInfo
+// message located at the offset stored in the demo header.
+// Returns CSDM_DEFAULT_TICK_INTERVAL if the demo can't be read, e.g. incomplete demos don't have a file info message.
+double GetDemoTickInterval(const std::string& demoPath);
@@ -0,0 +1,499 @@
+// Microbenchmarks of the plugin hot paths, results are printed as JSON so they can be compared between releases.
+//
+// Usage: bench [--filter substring] [--label name] [--output path]
+//
+// - actions_file/*: loading the actions file with the JSON DOM (LoadSequencesFile), a SAX handler and a compact binary
+//   encoding of the same sequences.
+// - dispatch/*: one PlaybackFrame call on a new tick, with 10/100/1000 actions in the current sequence.
+// - ws_client/*: the WebSocket client of the plugin (easywsclient) sending a text message to an echo server over the
+//   loopback and dispatching the reply, which includes its own frame encoding, masking and decoding.
+// - ws_harness/*: frame encoding, decoding and masking of the harness WebSocket server (ws_protocol.cpp), not of the
+//   plugin.
+// - log/*: cost of a Log call, the console output is formatted by the tier0 stub then discarded.
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+#include <easywsclient.hpp>
+#include "playback.h"
+#include "actions_watcher.h"
+#include "utils.h"
+#include "fake_engine.h"
+#include "ws_protocol.h"
+
+using nlohmann::json;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult {
+    string name;
+    double nsPerOp;
+    // Bytes processed by one operation, 0 if not relevant.
+    double bytesPerOp;
+};
+
+static std::vector<BenchResult> results;
+static string filter;
+static string tempDirectory = "/tmp";
+
+void UnhideCommandsAndCvars()
+{
+}
+
+// Runs fn in batches until minSeconds elapsed, repeated 5 times. Returns the median duration of one call in ns.
+template <typename Fn>
+static double MeasureNsPerOp(Fn fn, double minSeconds = 0.1)
+{
+    fn();
+
+    std::vector<double> samples;
+    for (int run = 0; run < 5; run++) {
+        uint64_t iterations = 0;
+        uint64_t batchSize = 1;
+        auto start = Clock::now();
+        double elapsed = 0;
+        while (elapsed < minSeconds) {
+            for (uint64_t i = 0; i < batchSize; i++) {
+                fn();
+            }
+            iterations += batchSize;
+            batchSize *= 2;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        samples.push_back(elapsed * 1e9 / iterations);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    return samples[samples.size() / 2];
+}
+
+template <typename Fn>
+static void Bench(const string& name, double bytesPerOp, Fn fn)
+{
+    if (!filter.empty() && name.find(filter) == string::npos) {
+        return;
+    }
+
+    double nsPerOp = MeasureNsPerOp(fn);
+    results.push_back({ name, nsPerOp, bytesPerOp });
+    fprintf(stderr, "%-40s %12.1f ns/op\n", name.c_str(), nsPerOp);
+}
+
+static bool IsEnabled(const string& prefix)
+{
+    return filter.empty() || prefix.find(filter) != string::npos || filter.find(prefix) != string::npos;
+}
+
+// Sequences of console commands spaced by 8 ticks, like the spec lock and camera commands of generated actions files.
+static json GenerateActionsJson(int sequenceCount, int actionsPerSequence)
+{
+    json jsonSequences = json::array();
+    for (int i = 0; i < sequenceCount; i++) {
+        json actions = json::array();
+        int startTick = 1000 + i * 5000;
+        for (int j = 0; j < actionsPerSequence; j++) {
+            json action;
+            action["tick"] = startTick + j * 8;
+            action["cmd"] = j % 2 == 0 ? "spec_lock_to_accountid 76561198000000000" : "demo_timescale 1";
+            actions.push_back(action);
+        }
+        json sequence;
+        sequence["actions"] = actions;
+        jsonSequences.push_back(sequence);
+    }
+
+    return jsonSequences;
+}
+
+// SAX handler building the sequences without an intermediate DOM.
+class SequencesSaxHandler : public nlohmann::json_sax<json>
+{
+public:
+    std::vector<Sequence> sequences;
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t value) override { return SetTick((int)value); }
+    bool number_unsigned(number_unsigned_t value) override { return SetTick((int)value); }
+    bool number_float(number_float_t value, const string_t&) override { return SetTick((int)value); }
+    bool binary(binary_t&) override { return true; }
+    bool string(string_t& value) override
+    {
+        if (depth == 4 && currentKey == "cmd") {
+            action.cmd = std::move(value);
+        }
+        return true;
+    }
+    bool start_object(std::size_t) override
+    {
+        depth++;
+        if (depth == 2) {
+            sequences.emplace_back();
+        }
+        else if (depth == 4) {
+            action = Action();
+        }
+        return true;
+    }
+    bool end_object() override
+    {
+        if (depth == 4 && !sequences.empty()) {
+            sequences.back().actions.push_back(std::move(action));
+        }
+        depth--;
+        return true;
+    }
+    bool start_array(std::size_t) override { depth++; return true; }
+    bool end_array() override { depth--; return true; }
+    bool key(string_t& value) override { currentKey = value; return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override { return false; }
+
+private:
+    int depth = 0;
+    std::string currentKey;
+    Action action;
+
+    bool SetTick(int value)
+    {
+        if (depth == 4 && currentKey == "tick") {
+            action.tick = value;
+        }
+        return true;
+    }
+};
+
+// Binary encoding: u32 sequence count, then for each sequence a u32 action count and for each action an i32 tick, a
+// u16 command length and the command.
+static string EncodeSequencesBinary(const json& jsonSequences)
+{
+    string data;
+    auto writeU32 = [&data](uint32_t value) { data.append((const char*)&value, 4); };
+    writeU32(jsonSequences.size());
+    for (const auto& jsonSequence : jsonSequences) {
+        writeU32(jsonSequence["actions"].size());
+        for (const auto& jsonAction : jsonSequence["actions"]) {
+            int32_t tick = jsonAction["tick"];
+            string cmd = jsonAction["cmd"];
+            uint16_t length = cmd.size();
+            data.append((const char*)&tick, 4);
+            data.append((const char*)&length, 2);
+            data += cmd;
+        }
+    }
+
+    return data;
+}
+
+static std::vector<Sequence> DecodeSequencesBinary(const string& data)
+{
+    std::vector<Sequence> decodedSequences;
+    size_t offset = 0;
+    auto readU32 = [&]() { uint32_t value; memcpy(&value, &data[offset], 4); offset += 4; return value; };
+    uint32_t sequenceCount = readU32();
+    decodedSequences.resize(sequenceCount);
+    for (auto& sequence : decodedSequences) {
+        uint32_t actionCount = readU32();
+        sequence.actions.resize(actionCount);
+        for (auto& action : sequence.actions) {
+            memcpy(&action.tick, &data[offset], 4);
+            uint16_t length;
+            memcpy(&length, &data[offset + 4], 2);
+            action.cmd.assign(&data[offset + 6], length);
+            offset += 6 + length;
+        }
+    }
+
+    return decodedSequences;
+}
+
+static string ReadFile(const string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void BenchActionsFile()
+{
+    if (!IsEnabled("actions_file/")) {
+        return;
+    }
+
+    struct Size { const char* name; int sequenceCount; int actionsPerSequence; };
+    for (Size size : { Size{ "small", 10, 8 }, Size{ "large", 500, 40 } }) {
+        json jsonSequences = GenerateActionsJson(size.sequenceCount, size.actionsPerSequence);
+        string demoPath = tempDirectory + "/csdm_bench_" + size.name + ".dem";
+        string jsonPath = demoPath + ".json";
+        string binaryPath = demoPath + ".bin";
+        std::ofstream(jsonPath, std::ios::trunc) << jsonSequences.dump();
+        std::ofstream(binaryPath, std::ios::binary | std::ios::trunc) << EncodeSequencesBinary(jsonSequences);
+        double jsonSize = ReadFile(jsonPath).size();
+        double binarySize = ReadFile(binaryPath).size();
+
+        Bench(string("actions_file/dom/") + size.name, jsonSize, [&]() {
+            LoadSequencesFile(demoPath);
+        });
+        Bench(string("actions_file/sax/") + size.name, jsonSize, [&]() {
+            std::ifstream file(jsonPath);
+            SequencesSaxHandler handler;
+            json::sax_parse(file, &handler);
+        });
+        Bench(string("actions_file/binary/") + size.name, binarySize, [&]() {
+            DecodeSequencesBinary(ReadFile(binaryPath));
+        });
+
+        remove(jsonPath.c_str());
+        remove(binaryPath.c_str());
+    }
+
+    sequences = {};
+}
+
+static void BenchDispatch()
+{
+    if (!IsEnabled("dispatch/")) {
+        return;
+    }
+
+    for (int actionCount : { 10, 100, 1000 }) {
+        Sequence sequence;
+        for (int i = 0; i < actionCount; i++) {
+            sequence.actions.push_back({ 1000 + i * 8, "spec_lock_to_accountid 76561198000000000" });
+        }
+
+        FakeEngine engine;
+        engine.demo.isPlaying = true;
+        int firstTick = 1000;
+        int lastTick = 1000 + actionCount * 8;
+        PlaybackFrame(&engine);
+
+        // Most ticks don't have any action, 1 tick out of 8 executes one.
+        sequences = {};
+        sequences.push(sequence);
+        engine.demo.tick = firstTick;
+        Bench("dispatch/" + std::to_string(actionCount), 0, [&]() {
+            engine.demo.tick++;
+            if (engine.demo.tick >= lastTick) {
+                engine.demo.tick = firstTick;
+                engine.commands.clear();
+            }
+            PlaybackFrame(&engine);
+        });
+    }
+
+    sequences = {};
+}
+
+static void BenchHarnessWsFrames()
+{
+    if (!IsEnabled("ws_harness/")) {
+        return;
+    }
+
+    for (size_t size : { 32, 1024, 65536, 1048576 }) {
+        string payload(size, 'x');
+        string suffix = "/" + std::to_string(size);
+
+        string encoded;
+        Bench("ws_harness/encode_masked" + suffix, size, [&]() {
+            encoded.clear();
+            EncodeWsFrame(encoded, WS_OPCODE_TEXT, payload, true, 0x12345678);
+        });
+
+        WsFrame frame;
+        Bench("ws_harness/decode_masked" + suffix, size, [&]() {
+            DecodeWsFrame(encoded, frame);
+        });
+
+        Bench("ws_harness/mask" + suffix, size, [&]() {
+            ApplyWsMask(&payload[0], payload.size(), 0x12345678);
+        });
+    }
+}
+
+// Echo server for the ws_client benchmarks.
+static void RunEchoServer(int listenFd, std::atomic<bool>& isStopping)
+{
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    string buffer;
+    char chunk[65536];
+    bool isHandshakeDone = false;
+    while (!isStopping) {
+        ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+        if (count <= 0) {
+            break;
+        }
+        buffer.append(chunk, count);
+
+        if (!isHandshakeDone) {
+            size_t end = buffer.find("\r\n\r\n");
+            if (end == string::npos) {
+                continue;
+            }
+            string path;
+            string response = GetHandshakeResponse(buffer.substr(0, end + 4), path);
+            send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+            buffer.erase(0, end + 4);
+            isHandshakeDone = true;
+        }
+
+        WsFrame frame;
+        size_t frameSize;
+        while ((frameSize = DecodeWsFrame(buffer, frame)) > 0) {
+            buffer.erase(0, frameSize);
+            if (frame.opcode == WS_OPCODE_CLOSE) {
+                isStopping = true;
+                break;
+            }
+            string reply;
+            EncodeWsFrame(reply, frame.opcode, frame.payload, false);
+            size_t sent = 0;
+            while (sent < reply.size()) {
+                ssize_t written = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    break;
+                }
+                sent += written;
+            }
+        }
+    }
+
+    close(fd);
+}
+
+static void BenchWsClient()
+{
+    if (!IsEnabled("ws_client/")) {
+        return;
+    }
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 1) != 0) {
+        close(listenFd);
+        return;
+    }
+    getsockname(listenFd, (sockaddr*)&address, &addressLength);
+
+    std::atomic<bool> isStopping(false);
+    std::thread server(RunEchoServer, listenFd, std::ref(isStopping));
+    string url = "ws://localhost:" + std::to_string(ntohs(address.sin_port)) + "/";
+    easywsclient::WebSocket::pointer ws = easywsclient::WebSocket::from_url(url);
+    if (ws != NULL) {
+        for (size_t size : { 32, 1024, 65536, 1048576 }) {
+            string payload(size, 'x');
+            Bench("ws_client/round_trip/" + std::to_string(size), size, [&]() {
+                bool isReceived = false;
+                ws->send(payload);
+                while (!isReceived && ws->getReadyState() != easywsclient::WebSocket::CLOSED) {
+                    ws->poll();
+                    ws->dispatch([&](const string& message) { isReceived = true; });
+                }
+            });
+        }
+
+        ws->close();
+        ws->poll();
+        delete ws;
+    }
+
+    isStopping = true;
+    shutdown(listenFd, SHUT_RDWR);
+    server.join();
+    close(listenFd);
+}
+
+static void BenchLog()
+{
+    if (!IsEnabled("log/")) {
+        return;
+    }
+
+    string logPath = tempDirectory + "/csdm_bench.log";
+    SetLogFilePath(logPath);
+    Bench("log/file", 0, []() {
+        Log("Executing: %s", "spec_lock_to_accountid 76561198000000000");
+    });
+    DeleteLogFile();
+
+    SetLogFilePath("/dev/null");
+    Bench("log/dev_null", 0, []() {
+        Log("Executing: %s", "spec_lock_to_accountid 76561198000000000");
+    });
+}
+
+int main(int argc, char** argv)
+{
+    string outputPath;
+    string label;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (arg == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: bench [--filter substring] [--label name] [--output path]\n");
+            return 2;
+        }
+    }
+
+    // The dispatch logs every executed action, it shouldn't measure the disk.
+    SetLogFilePath("/dev/null");
+    timelineFilePath = "/dev/null";
+    // actions_file/dom measures the parsing of LoadSequencesFile, not the setup of the hot reload watch.
+    SetActionsWatcherEnabled(false);
+
+    BenchActionsFile();
+    BenchDispatch();
+    BenchWsClient();
+    BenchHarnessWsFrames();
+    BenchLog();
+
+    json jsonResults = json::array();
+    for (const auto& result : results) {
+        json jsonResult;
+        jsonResult["name"] = result.name;
+        jsonResult["nsPerOp"] = result.nsPerOp;
+        jsonResult["opsPerSecond"] = 1e9 / result.nsPerOp;
+        if (result.bytesPerOp > 0) {
+            jsonResult["megabytesPerSecond"] = result.bytesPerOp / result.nsPerOp * 1e9 / (1024 * 1024);
+        }
+        jsonResults.push_back(jsonResult);
+    }
+
+    json output;
+    output["label"] = label;
+    output["compiler"] = __VERSION__;
+    output["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    output["results"] = jsonResults;
+
+    if (outputPath.empty()) {
+        printf("%s\n", output.dump(2).c_str());
+    }
+    else {
+        std::ofstream(outputPath, std::ios::trunc) << output.dump(2);
+    }
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "cdll_interfaces.h"
+
+// Fake implementations of the engine interfaces used by the playback core.
+// The tick progression is scripted by the harness, commands executed by the plugin are recorded and the ones that
+// control the playback (playdemo, demo_gototick, demo_pause, demo_resume, quit) are applied to the fake demo.
+
+struct ExecutedCommand {
+    int frame;
+    // Virtual time in seconds.
+    double time;
+    // Demo tick when the command was executed.
+    int tick;
+    std::string cmd;
+};
+
+class FakeDemoFile : public IDemoFile
+{
+public:
+    int tick = 0;
+    bool isPlaying = false;
+    bool isPaused = false;
+
+    void _Unknown_000(void) override {}
+    void _Unknown_001(void) override {}
+    int GetDemoStartTick(void) override { return 0; }
+#if defined _WIN32
+    int _Unknown_003(void) override { return 0; }
+    int GetDemoTick(void) override { return tick; }
+    void _Unknown_005(void) override {}
+    void _Unknown_006(void) override {}
+#else
+    void _Unknown_003(void) override {}
+    void _Unknown_004(void) override {}
+    void _Unknown_005(void) override {}
+    int GetDemoTick(void) override { return tick; }
+#endif
+    int _Unknown_007(void) override { return 0; }
+    int _Unknown_008(void) override { return 0; }
+    int _Unknown_009(void) override { return 0; }
+    int _Unknown_010(void) override { return 0; }
+    int _Unknown_011(void) override { return 0; }
+    bool IsPlayingDemo(void) override { return isPlaying; }
+    bool IsDemoPaused(void) override { return isPaused; }
+    int _Unknown_014(void) override { return 0; }
+    int _Unknown_015(void) override { return 0; }
+};
+
+class FakeEngine : public ISource2EngineToClient
+{
+public:
+    FakeDemoFile demo;
+    std::vector<ExecutedCommand> commands;
+    // Frame and virtual time of the current playback loop iteration, set by the harness.
+    int frame = 0;
+    double time = 0;
+    // Number of frames spent "loading" the demo after a playdemo command, IsPlayingDemo returns false meanwhile.
+    int loadingFrames = 0;
+    int remainingLoadingFrames = -1;
+    bool isQuitRequested = false;
+    // Set when a demo_gototick command is executed, the target tick is then visible on the next frame.
+    bool hasSeeked = false;
+
+    void ExecuteClientCmd(int iUnk0MaybeSplitScreenSlotSetTo0, const char* pszCommands, bool bUnk2SetToTrue) override
+    {
+        std::string cmd = pszCommands;
+        commands.push_back({ frame, time, demo.tick, cmd });
+
+        if (cmd.rfind("playdemo", 0) == 0) {
+            demo.isPlaying = false;
+            demo.isPaused = false;
+            demo.tick = 0;
+            remainingLoadingFrames = loadingFrames;
+        }
+        else if (cmd.rfind("demo_gototick ", 0) == 0) {
+            demo.tick = atoi(cmd.c_str() + strlen("demo_gototick "));
+            hasSeeked = true;
+        }
+        else if (cmd == "demo_pause") {
+            demo.isPaused = true;
+        }
+        else if (cmd == "demo_resume") {
+            demo.isPaused = false;
+        }
+        else if (cmd == "quit") {
+            isQuitRequested = true;
+        }
+    }
+
+    // Called once per frame, ends the loading when the loading frames elapsed.
+    void UpdateLoading()
+    {
+        if (remainingLoadingFrames < 0) {
+            return;
+        }
+
+        if (remainingLoadingFrames == 0) {
+            demo.isPlaying = true;
+        }
+        remainingLoadingFrames--;
+    }
+
+    bool IsPlayingDemo(void) override { return demo.isPlaying; }
+    IDemoFile* GetDemoFile(void) override { return demo.isPlaying ? &demo : NULL; }
+    char const* GetLevelName(void) override { return "maps/de_dust2.vpk"; }
+    char const* GetLevelNameShort(void) override { return "de_dust2"; }
+
+    void _Unknown_000(void) override {}
+    void _Unknown_001(void) override {}
+    void _Unknown_002(void) override {}
+    void _Unknown_003(void) override {}
+    void _Unknown_004(void) override {}
+    void _Unknown_005(void) override {}
+    void _Unknown_006(void) override {}
+    void _Unknown_007(void) override {}
+    void _Unknown_008(void) override {}
+    void _Unknown_009(void) override {}
+    void _Unknown_010(void) override {}
+    void _Unknown_011(void) override {}
+    void _Unknown_012(void) override {}
+    void _Unknown_013(void) override {}
+    void _Unknown_014(void) override {}
+    void _Unknown_015(void) override {}
+    void _Unknown_016(void) override {}
+    void _Unknown_017(void) override {}
+    void _Unknown_018(void) override {}
+    void _Unknown_019(void) override {}
+    void _Unknown_020(void) override {}
+    void _Unknown_021(void) override {}
+    void _Unknown_022(void) override {}
+    void _Unknown_023(void) override {}
+    void _Unknown_024(void) override {}
+    void _Unknown_025(void) override {}
+    void _Unknown_026(void) override {}
+    void _Unknown_027(void) override {}
+    void _Unknown_028(void) override {}
+    void _Unknown_029(void) override {}
+    void _Unknown_030(void) override {}
+    void _Unknown_031(void) override {}
+    void _Unknown_032(void) override {}
+    void _Unknown_033(void) override {}
+    void _Unknown_034(void) override {}
+    void _Unknown_035(void) override {}
+    void _Unknown_036(void) override {}
+    void _Unknown_037(void) override {}
+    void _Unknown_038(void) override {}
+    void _Unknown_039(void) override {}
+    void _Unknown_041(void) override {}
+    void _Unknown_042(void) override {}
+    void _Unknown_043(void) override {}
+    void _Unknown_044(void) override {}
+    void _Unknown_045(void) override {}
+    void _Unknown_046(void) override {}
+    void _Unknown_047(void) override {}
+    void _Unknown_049(void) override {}
+    void _Unknown_050(void) override {}
+    void _Unknown_051(void) override {}
+    void _Unknown_052(void) override {}
+    void _Unknown_053(void) override {}
+    void _Unknown_054(void) override {}
+    void _Unknown_055(void) override {}
+    void _Unknown_056(void) override {}
+    void _Unknown_057(void) override {}
+    void _Unknown_058(void) override {}
+    void _Unknown_059(void) override {}
+    void _Unknown_060(void) override {}
+    void _Unknown_063(void) override {}
+    void _Unknown_064(void) override {}
+    void _Unknown_065(void) override {}
+};
@@ -0,0 +1,445 @@
+// Runs the playback core against a fake engine with a scripted tick progression and reports the executed commands,
+// the dispatch latency and the actions that were never executed.
+//
+// Usage: harness <demo path> [--scenario normal|skip|seek|stall] [--max-frames N] [--frame-rate N]
+//                [--loading-frames N] [--stall-frames N] [--ws-url url] [--ws-duration seconds] [--output path]
+//                [--trace path] [--launch-option] [--check] [--verbose]
+//
+// Actions are read from <demo path>.json like the plugin does, the demo itself doesn't have to exist.
+// The playback runs on a copy of the actions file in a temporary folder so that the progress journal, the timing and
+// the startup timeline written next to the demo don't touch the files of the caller.
+// By default the harness starts the playback of the demo itself. With --ws-url, it connects to a WebSocket server
+// (e.g. ws-server) like the plugin does and waits for its playdemo messages during --ws-duration seconds of real time,
+// quit commands then only stop the current playback. With --launch-option, the demo is started like with the +playdemo
+// launch option of the game instead of a playdemo message.
+// With --check, the exit code is 1 when an action hasn't been executed or when the job timing hasn't been reported.
+// With --trace, the session is traced like the plugin does with -csdm_trace, see replay.cpp to replay it.
+
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <nlohmann/json.hpp>
+#include "playback.h"
+#include "websocket.h"
+#include "watchdog.h"
+#include "session_trace.h"
+#include "demo_header.h"
+#include "utils.h"
+#include "fake_engine.h"
+#include "harness.h"
+
+using nlohmann::json;
+using std::string;
+
+struct Scenario {
+    const char* name;
+    // Ticks advanced on each frame, the pattern is repeated.
+    std::vector<int> tickSteps;
+    // Every seekInterval frames the tick jumps by the next delta, e.g. when the engine catches up. 0 disables seeks.
+    int seekInterval;
+    std::vector<int> seekDeltas;
+    // Every stallInterval frames the tick doesn't advance during stallFrames frames. 0 disables stalls.
+    int stallInterval;
+    int stallFrames;
+};
+
+static const Scenario scenarios[] = {
+    { "normal", { 1 }, 0, {}, 0, 0 },
+    { "skip", { 1, 2, 1, 3 }, 0, {}, 0, 0 },
+    { "seek", { 1 }, 700, { -40, 40, 200, -200 }, 0, 0 },
+    { "stall", { 1 }, 0, {}, 500, 40 },
+};
+
+static FakeEngine engine;
+static int unhideCount = 0;
+
+void UnhideCommandsAndCvars()
+{
+    unhideCount++;
+}
+
+static bool IsInternalCommand(const string& cmd)
+{
+    return cmd == "pause_playback" || cmd == "go_to_next_sequence";
+}
+
+// Returns the actions of the file that should reach the engine, in execution order.
+// The plugin doesn't execute any action of an invalid actions file.
+static std::vector<Action> GetExpectedActions(const string& demoPath, const string& actionsFilePath)
+{
+    std::vector<Action> actions;
+    double tickInterval = GetDemoTickInterval(demoPath);
+    std::ifstream file(actionsFilePath);
+    json jsonSequences = json::parse(file, nullptr, false);
+    if (!jsonSequences.is_array()) {
+        return {};
+    }
+
+    for (auto& jsonSequence : jsonSequences) {
+        if (!jsonSequence.is_object() || !jsonSequence.contains("actions") || !jsonSequence["actions"].is_array()) {
+            return {};
+        }
+
+        std::vector<Action> sequenceActions;
+        for (auto& jsonAction : jsonSequence["actions"]) {
+            bool hasAnchorTick = jsonAction.contains("anchorTick") && jsonAction["anchorTick"].is_number();
+            bool hasTick = jsonAction.contains("tick") && jsonAction["tick"].is_number();
+            if (!jsonAction.contains("cmd") || !jsonAction["cmd"].is_string() || (!hasAnchorTick && !hasTick)) {
+                return {};
+            }
+
+            string cmd = jsonAction["cmd"];
+            if (IsInternalCommand(cmd)) {
+                continue;
+            }
+
+            int tick = hasAnchorTick
+                ? ResolveActionTick(jsonAction["anchorTick"], jsonAction.value("offsetMs", 0.0), tickInterval)
+                : jsonAction["tick"].get<int>();
+            sequenceActions.push_back({ tick, cmd });
+        }
+        std::stable_sort(sequenceActions.begin(), sequenceActions.end(), [](const Action& a, const Action& b) {
+            return a.tick < b.tick;
+        });
+        actions.insert(actions.end(), sequenceActions.begin(), sequenceActions.end());
+    }
+
+    return actions;
+}
+
+static int GetLastActionTick(const std::vector<Action>& actions)
+{
+    int lastTick = 0;
+    for (const auto& action : actions) {
+        lastTick = std::max(lastTick, action.tick);
+    }
+
+    return lastTick;
+}
+
+static json GetLatencyJson(std::vector<double>& samples)
+{
+    json latency;
+    latency["count"] = samples.size();
+    if (samples.empty()) {
+        return latency;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+
+    latency["avgUs"] = total / samples.size();
+    latency["p50Us"] = samples[samples.size() / 2];
+    latency["p99Us"] = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    latency["maxUs"] = samples.back();
+
+    return latency;
+}
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: harness <demo path> [--scenario normal|skip|seek|stall] [--max-frames N] [--frame-rate N] "
+        "[--loading-frames N] [--stall-frames N] [--ws-url url] [--ws-duration seconds] [--output path] [--trace path] "
+        "[--launch-option] [--check] [--verbose]\n");
+
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        return PrintUsage();
+    }
+
+    string demoPath = argv[1];
+    string outputPath;
+    string traceFilePath;
+    const Scenario* scenarioTemplate = &scenarios[0];
+    int maxFrames = 1000000;
+    double frameRate = 64;
+    int stallFrames = -1;
+    bool check = false;
+    bool isLaunchOption = false;
+    string serverUrl;
+    double serverDuration = 30;
+    engine.loadingFrames = 100;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scenario" && hasValue) {
+            string name = argv[++i];
+            scenarioTemplate = NULL;
+            for (const auto& scenario : scenarios) {
+                if (name == scenario.name) {
+                    scenarioTemplate = &scenario;
+                }
+            }
+            if (scenarioTemplate == NULL) {
+                fprintf(stderr, "Unknown scenario %s\n", name.c_str());
+                return 2;
+            }
+        }
+        else if (arg == "--max-frames" && hasValue) {
+            maxFrames = atoi(argv[++i]);
+        }
+        else if (arg == "--frame-rate" && hasValue) {
+            frameRate = atof(argv[++i]);
+        }
+        else if (arg == "--loading-frames" && hasValue) {
+            engine.loadingFrames = atoi(argv[++i]);
+        }
+        else if (arg == "--stall-frames" && hasValue) {
+            stallFrames = atoi(argv[++i]);
+        }
+        else if (arg == "--ws-url" && hasValue) {
+            serverUrl = argv[++i];
+        }
+        else if (arg == "--ws-duration" && hasValue) {
+            serverDuration = atof(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--trace" && hasValue) {
+            traceFilePath = argv[++i];
+        }
+        else if (arg == "--launch-option") {
+            isLaunchOption = true;
+        }
+        else if (arg == "--check") {
+            check = true;
+        }
+        else if (arg == "--verbose") {
+            SetHarnessVerbose(true);
+        }
+        else {
+            return PrintUsage();
+        }
+    }
+
+    Scenario scenario = *scenarioTemplate;
+    if (stallFrames >= 0) {
+        scenario.stallFrames = stallFrames;
+        scenario.stallInterval = scenario.stallInterval > 0 ? scenario.stallInterval : 500;
+    }
+
+    string actionsFilePath = demoPath + ".json";
+    if (!FileExists(actionsFilePath)) {
+        fprintf(stderr, "Actions file not found: %s\n", actionsFilePath.c_str());
+        return 2;
+    }
+
+    // A new folder for each run, a journal left by a previous run would make the playback resume from it.
+    std::error_code error;
+    std::filesystem::path runFolderPath = std::filesystem::temp_directory_path(error)
+        / ("csdm-harness-" + std::to_string(std::random_device()()));
+    std::filesystem::path runDemoPath = runFolderPath / std::filesystem::path(demoPath).filename();
+    std::filesystem::create_directories(runFolderPath, error);
+    std::filesystem::copy_file(actionsFilePath, runDemoPath.string() + ".json", error);
+    if (error) {
+        fprintf(stderr, "Failed to copy the actions file to %s: %s\n", runFolderPath.string().c_str(), error.message().c_str());
+        return 2;
+    }
+    // The demo header is read to resolve the actions with an anchor tick.
+    if (FileExists(demoPath)) {
+        std::filesystem::create_symlink(std::filesystem::absolute(demoPath), runDemoPath, error);
+        if (error) {
+            std::filesystem::copy_file(demoPath, runDemoPath, error);
+        }
+    }
+    demoPath = runDemoPath.string();
+    actionsFilePath = demoPath + ".json";
+    timelineFilePath = demoPath + ".startup.json";
+
+    std::vector<Action> expectedActions = GetExpectedActions(demoPath, actionsFilePath);
+    int lastDemoTick = GetLastActionTick(expectedActions) + 128;
+    double frameDuration = 1 / frameRate;
+
+    if (!traceFilePath.empty() && !OpenTraceFile(traceFilePath, 0)) {
+        fprintf(stderr, "Failed to open trace file %s\n", traceFilePath.c_str());
+        return 2;
+    }
+
+    std::thread* wsConnectionThread = NULL;
+    if (isLaunchOption) {
+        // The plugin loads the sequences when it is loaded, the game then executes the playdemo command itself.
+        LoadDemoJob(demoPath);
+        engine.ExecuteClientCmd(0, ("playdemo \"" + demoPath + "\"").c_str(), true);
+    }
+    if (!serverUrl.empty()) {
+        wsUrl = BuildWebSocketUrl(serverUrl, "");
+        wsConnectionThread = new std::thread(ConnectToWebsocketServerLoop);
+    }
+    else if (!isLaunchOption) {
+        json playdemo;
+        playdemo["name"] = "playdemo";
+        playdemo["payload"] = demoPath;
+        HandleWebSocketMessage(playdemo.dump());
+    }
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<json> messages;
+    std::vector<double> frameLatencies;
+    std::vector<double> dispatchLatencies;
+    size_t tickStepIndex = 0;
+    size_t seekDeltaIndex = 0;
+    int remainingStallFrames = 0;
+    int frame = 0;
+    int quitCount = 0;
+    for (; frame < maxFrames; frame++) {
+        // The server may start other demos, the quit command only stops the current playback in this case.
+        if (engine.isQuitRequested) {
+            quitCount++;
+            engine.isQuitRequested = false;
+            engine.demo.isPlaying = false;
+            if (wsConnectionThread == NULL) {
+                break;
+            }
+        }
+
+        double time = frame * frameDuration;
+        SetHarnessTime(time);
+        engine.frame = frame;
+        engine.time = time;
+        engine.UpdateLoading();
+
+        engine.hasSeeked = false;
+        size_t commandCount = engine.commands.size();
+        auto start = std::chrono::steady_clock::now();
+        PlaybackFrame(&engine);
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        frameLatencies.push_back(elapsed);
+        if (engine.commands.size() != commandCount) {
+            dispatchLatencies.push_back(elapsed);
+        }
+
+        FakeDemoFile& demo = engine.demo;
+        if (wsConnectionThread == NULL) {
+            string message;
+            while (PopQueuedWebSocketMessage(message)) {
+                messages.push_back(json::parse(message));
+            }
+
+            // The demo ended and no more actions are expected.
+            if (!demo.isPlaying && engine.remainingLoadingFrames < 0 && frame > 0) {
+                break;
+            }
+        }
+        else {
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() > serverDuration) {
+                break;
+            }
+
+            // Waiting for a playdemo message.
+            if (!demo.isPlaying && engine.remainingLoadingFrames < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        if (!demo.isPlaying) {
+            continue;
+        }
+
+        if (demo.isPaused || engine.hasSeeked) {
+            continue;
+        }
+
+        if (scenario.stallInterval > 0 && frame % scenario.stallInterval == 0) {
+            remainingStallFrames = scenario.stallFrames;
+        }
+        if (remainingStallFrames > 0) {
+            remainingStallFrames--;
+            continue;
+        }
+
+        demo.tick += scenario.tickSteps[tickStepIndex++ % scenario.tickSteps.size()];
+        if (scenario.seekInterval > 0 && frame % scenario.seekInterval == 0) {
+            demo.tick = std::max(0, demo.tick + scenario.seekDeltas[seekDeltaIndex++ % scenario.seekDeltas.size()]);
+        }
+
+        if (demo.tick > lastDemoTick) {
+            demo.isPlaying = false;
+        }
+    }
+
+    if (wsConnectionThread != NULL) {
+        isQuitting = true;
+        wsConnectionThread->join();
+        delete wsConnectionThread;
+    }
+    CloseTraceFile();
+
+    // Actions missed by the playback, matched in order against the executed commands.
+    json missingActions = json::array();
+    size_t commandIndex = 0;
+    for (const auto& action : expectedActions) {
+        size_t index = commandIndex;
+        while (index < engine.commands.size() && engine.commands[index].cmd != action.cmd) {
+            index++;
+        }
+
+        if (index == engine.commands.size()) {
+            missingActions.push_back({ { "tick", action.tick }, { "cmd", action.cmd } });
+        }
+        else {
+            commandIndex = index + 1;
+        }
+    }
+
+    json commands = json::array();
+    for (const auto& command : engine.commands) {
+        commands.push_back({ { "frame", command.frame }, { "time", command.time }, { "tick", command.tick }, { "cmd", command.cmd } });
+    }
+
+    json result;
+    result["scenario"] = scenario.name;
+    result["frames"] = frame;
+    result["duration"] = frame * frameDuration;
+    result["quitCount"] = quitCount;
+    result["remainingSequences"] = sequences.size();
+    result["unhideCount"] = unhideCount;
+    result["frameLatency"] = GetLatencyJson(frameLatencies);
+    result["dispatchLatency"] = GetLatencyJson(dispatchLatencies);
+    result["expectedActionCount"] = expectedActions.size();
+    result["missingActions"] = missingActions;
+    result["watchdog"] = GetWatchdogStatsJson();
+    result["messages"] = messages;
+    result["commands"] = commands;
+
+    if (outputPath.empty()) {
+        printf("%s\n", result.dump(2).c_str());
+    }
+    else {
+        std::ofstream output(outputPath, std::ios::trunc);
+        output << result.dump(2);
+    }
+
+    // The journal, the job timing and the timeline are part of the messages or not needed after the run.
+    std::filesystem::remove_all(runFolderPath, error);
+
+    if (check && !missingActions.empty()) {
+        fprintf(stderr, "%zu action(s) not executed\n", missingActions.size());
+        return 1;
+    }
+
+    // The job is timed whichever way the demo has been started.
+    bool hasJobTiming = std::any_of(messages.begin(), messages.end(), [](const json& message) {
+        return message["name"] == "job_timing";
+    });
+    if (check && serverUrl.empty() && !hasJobTiming) {
+        fprintf(stderr, "Job timing not reported\n");
+        return 1;
+    }
+
+    return 0;
+}
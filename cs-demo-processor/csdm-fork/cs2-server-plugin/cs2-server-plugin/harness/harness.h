@@ -0,0 +1,8 @@
+#pragma once
+
+// The harness replaces utils.cpp (it depends on tier0) with harness_utils.cpp.
+// GetTime() returns a virtual clock driven by the harness so that runs are deterministic.
+
+void SetHarnessTime(double time);
+// Log messages are printed to stderr when verbose, they are discarded otherwise.
+void SetHarnessVerbose(bool verbose);
@@ -0,0 +1,88 @@
+#include "utils.h"
+#include "harness.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <fstream>
+#include <dlfcn.h>
+
+using std::string;
+
+static double harnessTime = 0;
+static bool isVerbose = false;
+
+void SetHarnessTime(double time)
+{
+    harnessTime = time;
+}
+
+void SetHarnessVerbose(bool verbose)
+{
+    isVerbose = verbose;
+}
+
+void Log(const char* msg, ...)
+{
+    if (!isVerbose) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, msg);
+    char buf[1024] = {};
+    vsnprintf(buf, sizeof(buf), msg, args);
+    va_end(args);
+    fprintf(stderr, "[%10.4f] CSDM: %s\n", harnessTime, buf);
+}
+
+void PluginError(const char* msg, ...)
+{
+    va_list args;
+    va_start(args, msg);
+    char buf[1024] = {};
+    vsnprintf(buf, sizeof(buf), msg, args);
+    va_end(args);
+    fprintf(stderr, "Plugin error: %s\n", buf);
+    exit(1);
+}
+
+void SetLogFilePath(const string& path)
+{
+}
+
+void DeleteLogFile()
+{
+}
+
+bool FileExists(const std::string& name) {
+    std::ifstream f(name.c_str());
+
+    return f.good();
+}
+
+double GetTime()
+{
+    return harnessTime;
+}
+
+string GetLaunchParameter(const char* name, const char* envName, const string& defaultValue)
+{
+    const char* envValue = getenv(envName);
+    if (envValue != NULL && envValue[0] != '\0') {
+        return string(envValue);
+    }
+
+    return defaultValue;
+}
+
+void* GetLibAddress(void* lib, const char* name) {
+    return dlsym(lib, name);
+}
+
+char* GetLastErrorString() {
+    return dlerror();
+}
+
+void* LoadLib(const char* path) {
+    return dlopen(path, RTLD_NOW);
+}
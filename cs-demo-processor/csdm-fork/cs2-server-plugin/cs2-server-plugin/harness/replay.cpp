@@ -0,0 +1,320 @@
+// Replays a trace written by the plugin (-csdm_trace) or by the harness (--trace) through the playback core with the
+// fake engine, then diffs the executed commands and their timing against the traced ones.
+//
+// Usage: replay <trace path> [--real-time] [--speed N] [--frame-rate N] [--output path] [--verbose]
+//
+// By default the trace is replayed at full speed, the playback loop only runs at the traced timestamps. With
+// --real-time, the playback loop runs at --frame-rate frames per second of real time like in the game, the trace
+// timestamps being scaled by --speed.
+// The demo state (playing, paused, tick) is taken from the trace, the actions file content is embedded in the trace so
+// the replay doesn't depend on the files of the traced machine.
+// playdemo commands are ignored by the diff since the actions are loaded from a temporary copy.
+
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+#include "playback.h"
+#include "websocket.h"
+#include "session_trace.h"
+#include "journal.h"
+#include "actions_watcher.h"
+#include "fake_engine.h"
+#include "harness.h"
+
+using nlohmann::json;
+using std::string;
+
+// Above this number of LCS cells, commands are compared by position.
+#define MAX_DIFF_CELLS (32 * 1024 * 1024)
+// Maximum number of mismatches written to the report.
+#define MAX_REPORTED_MISMATCHES 100
+
+struct TracedCommand {
+    double time;
+    string cmd;
+};
+
+static FakeEngine engine;
+// Last traced demo state, the fake engine reacts to the replayed commands (e.g. demo_gototick) but the replay must only
+// see the demo state that the game reported.
+static TraceRecord lastSample = {};
+
+void UnhideCommandsAndCvars()
+{
+}
+
+static bool IsComparedCommand(const string& cmd)
+{
+    return cmd.rfind("playdemo", 0) != 0;
+}
+
+static void RunFrame(double time)
+{
+    engine.demo.isPlaying = lastSample.isPlaying;
+    engine.demo.isPaused = lastSample.isPaused;
+    if (lastSample.isPlaying) {
+        engine.demo.tick = lastSample.tick;
+    }
+
+    SetHarnessTime(time);
+    engine.frame++;
+    engine.time = time;
+    PlaybackFrame(&engine);
+
+    string message;
+    while (PopQueuedWebSocketMessage(message)) {
+    }
+}
+
+// Matches the replayed commands against the traced ones, unmatched commands of both sides are reported as mismatches.
+static json DiffCommands(const std::vector<TracedCommand>& traced, const std::vector<TracedCommand>& replayed)
+{
+    size_t n = traced.size();
+    size_t m = replayed.size();
+    std::vector<std::pair<size_t, size_t>> matches;
+    string method;
+
+    if ((double)(n + 1) * (m + 1) <= MAX_DIFF_CELLS) {
+        method = "lcs";
+        std::vector<uint32_t> lengths((n + 1) * (m + 1), 0);
+        auto at = [&](size_t i, size_t j) -> uint32_t& { return lengths[i * (m + 1) + j]; };
+        for (size_t i = n; i-- > 0;) {
+            for (size_t j = m; j-- > 0;) {
+                at(i, j) = traced[i].cmd == replayed[j].cmd ? at(i + 1, j + 1) + 1 : std::max(at(i + 1, j), at(i, j + 1));
+            }
+        }
+
+        size_t i = 0;
+        size_t j = 0;
+        while (i < n && j < m) {
+            if (traced[i].cmd == replayed[j].cmd) {
+                matches.push_back({ i++, j++ });
+            }
+            else if (at(i + 1, j) >= at(i, j + 1)) {
+                i++;
+            }
+            else {
+                j++;
+            }
+        }
+    }
+    else {
+        method = "positional";
+        for (size_t i = 0; i < std::min(n, m); i++) {
+            if (traced[i].cmd == replayed[i].cmd) {
+                matches.push_back({ i, i });
+            }
+        }
+    }
+
+    json mismatches = json::array();
+    size_t mismatchCount = 0;
+    auto addMismatches = [&](const char* type, const std::vector<TracedCommand>& commands, std::vector<bool>& isMatched) {
+        for (size_t i = 0; i < commands.size(); i++) {
+            if (isMatched[i]) {
+                continue;
+            }
+            mismatchCount++;
+            if (mismatches.size() < MAX_REPORTED_MISMATCHES) {
+                mismatches.push_back({ { "type", type }, { "index", i }, { "time", commands[i].time }, { "cmd", commands[i].cmd } });
+            }
+        }
+    };
+
+    std::vector<bool> isTracedMatched(n, false);
+    std::vector<bool> isReplayedMatched(m, false);
+    double totalDelta = 0;
+    double maxDelta = 0;
+    for (const auto& match : matches) {
+        isTracedMatched[match.first] = true;
+        isReplayedMatched[match.second] = true;
+        double delta = std::abs(replayed[match.second].time - traced[match.first].time) * 1000;
+        totalDelta += delta;
+        maxDelta = std::max(maxDelta, delta);
+    }
+    // Commands missing from the replay, then commands only executed by the replay.
+    addMismatches("missing", traced, isTracedMatched);
+    addMismatches("unexpected", replayed, isReplayedMatched);
+
+    json diff;
+    diff["method"] = method;
+    diff["tracedCount"] = n;
+    diff["replayedCount"] = m;
+    diff["matchedCount"] = matches.size();
+    diff["mismatchCount"] = mismatchCount;
+    diff["mismatches"] = mismatches;
+    diff["timing"] = {
+        { "avgDeltaMs", matches.empty() ? 0 : totalDelta / matches.size() },
+        { "maxDeltaMs", maxDelta },
+    };
+
+    return diff;
+}
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: replay <trace path> [--real-time] [--speed N] [--frame-rate N] [--output path] [--verbose]\n");
+
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        return PrintUsage();
+    }
+
+    string traceFilePath = argv[1];
+    string outputPath;
+    bool isRealTime = false;
+    double speed = 1;
+    double frameRate = 64;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--real-time") {
+            isRealTime = true;
+        }
+        else if (arg == "--speed" && hasValue) {
+            speed = atof(argv[++i]);
+        }
+        else if (arg == "--frame-rate" && hasValue) {
+            frameRate = atof(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--verbose") {
+            SetHarnessVerbose(true);
+        }
+        else {
+            return PrintUsage();
+        }
+    }
+
+    if (speed <= 0 || frameRate <= 0) {
+        return PrintUsage();
+    }
+
+    std::vector<TraceRecord> records;
+    if (!ReadTraceFile(traceFilePath, records)) {
+        fprintf(stderr, "Invalid trace file: %s\n", traceFilePath.c_str());
+        return 2;
+    }
+
+    // Reloads are replayed from the trace.
+    SetActionsWatcherEnabled(false);
+
+    const char* tmpDirectory = getenv("TMPDIR");
+    string replayDemoPath = string(tmpDirectory != NULL ? tmpDirectory : "/tmp") + "/csdm_replay_" + std::to_string(getpid()) + ".dem";
+    string replayActionsFilePath = replayDemoPath + ".json";
+    timelineFilePath = replayDemoPath + ".startup.json";
+
+    std::vector<TracedCommand> tracedCommands;
+    int sampleCount = 0;
+    int demoCount = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    double lastFrameTime = 0;
+
+    for (const auto& record : records) {
+        if (isRealTime) {
+            // The playback loop keeps running between the traced records like in the game.
+            double frameDuration = 1 / frameRate;
+            while (true) {
+                double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() * speed;
+                if (now >= record.time) {
+                    break;
+                }
+                if (now - lastFrameTime >= frameDuration) {
+                    RunFrame(now);
+                    lastFrameTime = now;
+                }
+                std::this_thread::sleep_for(std::chrono::duration<double>(std::min(frameDuration, record.time - now) / speed));
+            }
+        }
+
+        if (record.type == TRACE_RECORD_DEMO) {
+            demoCount++;
+            remove((replayDemoPath + ".progress").c_str());
+            if (record.actions.empty()) {
+                remove(replayActionsFilePath.c_str());
+            }
+            else {
+                std::ofstream actionsFile(replayActionsFilePath, std::ios::trunc);
+                actionsFile << record.actions;
+            }
+
+            RequestDemoPlayback(replayDemoPath);
+            RunFrame(record.time);
+            // The sequences that were skipped by the progress journal of the traced session.
+            for (int i = 0; i < record.skippedSequenceCount && !sequences.empty(); i++) {
+                sequences.pop();
+                currentSequenceIndex++;
+            }
+        }
+        else if (record.type == TRACE_RECORD_RELOAD) {
+            std::ofstream actionsFile(replayActionsFilePath, std::ios::trunc);
+            actionsFile << record.actions;
+            actionsFile.close();
+            SetHarnessTime(record.time);
+            ReloadSequencesFile();
+        }
+        else if (record.type == TRACE_RECORD_SAMPLE) {
+            sampleCount++;
+            lastSample = record;
+            RunFrame(record.time);
+        }
+        else if (record.type == TRACE_RECORD_COMMAND) {
+            if (IsComparedCommand(record.text)) {
+                tracedCommands.push_back({ record.time, record.text });
+            }
+            // Time based commands (pause resume, watchdog) are executed by the frame matching the traced one.
+            RunFrame(record.time);
+        }
+        lastFrameTime = record.time;
+    }
+
+    std::vector<TracedCommand> replayedCommands;
+    for (const auto& command : engine.commands) {
+        if (IsComparedCommand(command.cmd)) {
+            replayedCommands.push_back({ command.time, command.cmd });
+        }
+    }
+
+    json result;
+    result["trace"] = traceFilePath;
+    result["mode"] = isRealTime ? "real-time" : "full-speed";
+    result["recordCount"] = records.size();
+    result["sampleCount"] = sampleCount;
+    result["demoCount"] = demoCount;
+    result["duration"] = records.empty() ? 0 : records.back().time;
+    result["replayDuration"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result["diff"] = DiffCommands(tracedCommands, replayedCommands);
+
+    if (outputPath.empty()) {
+        printf("%s\n", result.dump(2).c_str());
+    }
+    else {
+        std::ofstream output(outputPath, std::ios::trunc);
+        output << result.dump(2);
+    }
+
+    CloseProgressJournal();
+    remove(replayActionsFilePath.c_str());
+    remove((replayDemoPath + ".progress").c_str());
+    remove((replayDemoPath + ".timing.json").c_str());
+    remove(timelineFilePath.c_str());
+
+    if (result["diff"]["mismatchCount"] != 0) {
+        fprintf(stderr, "%zu command(s) differ from the trace\n", result["diff"]["mismatchCount"].get<size_t>());
+        return 1;
+    }
+
+    return 0;
+}
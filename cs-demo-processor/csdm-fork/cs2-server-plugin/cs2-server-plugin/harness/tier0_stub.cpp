@@ -0,0 +1,21 @@
+// The tier0 functions used by utils.cpp, so that benchmarks measure the plugin's utils without the game libraries.
+// The console output is formatted like the engine would do it, then discarded.
+
+#include <cstdio>
+#include <cstdarg>
+#include <dbg.h>
+#include <icommandline.h>
+
+void ConColorMsg(const Color& clr, const tchar* pMsg, ...)
+{
+    char buffer[2048];
+    va_list args;
+    va_start(args, pMsg);
+    vsnprintf(buffer, sizeof(buffer), pMsg, args);
+    va_end(args);
+}
+
+ICommandLine* CommandLine()
+{
+    return NULL;
+}
@@ -0,0 +1,253 @@
+#include "ws_protocol.h"
+#include <cstring>
+
+using std::string;
+
+static uint32_t RotateLeft(uint32_t value, int count)
+{
+    return (value << count) | (value >> (32 - count));
+}
+
+string Sha1(const string& data)
+{
+    uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+    string message = data;
+    uint64_t bitCount = (uint64_t)data.size() * 8;
+    message += (char)0x80;
+    while (message.size() % 64 != 56) {
+        message += (char)0;
+    }
+    for (int i = 7; i >= 0; i--) {
+        message += (char)(bitCount >> (i * 8));
+    }
+
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = (const unsigned char*)&message[chunk + i * 4];
+            w[i] = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            }
+            else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            }
+            else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+
+            uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = RotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    string digest;
+    for (int i = 0; i < 5; i++) {
+        for (int j = 3; j >= 0; j--) {
+            digest += (char)(h[i] >> (j * 8));
+        }
+    }
+
+    return digest;
+}
+
+string Base64Encode(const string& data)
+{
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string result;
+    size_t i = 0;
+    for (; i + 2 < data.size(); i += 3) {
+        uint32_t n = ((unsigned char)data[i] << 16) | ((unsigned char)data[i + 1] << 8) | (unsigned char)data[i + 2];
+        result += alphabet[(n >> 18) & 63];
+        result += alphabet[(n >> 12) & 63];
+        result += alphabet[(n >> 6) & 63];
+        result += alphabet[n & 63];
+    }
+
+    size_t remaining = data.size() - i;
+    if (remaining == 1) {
+        uint32_t n = (unsigned char)data[i] << 16;
+        result += alphabet[(n >> 18) & 63];
+        result += alphabet[(n >> 12) & 63];
+        result += "==";
+    }
+    else if (remaining == 2) {
+        uint32_t n = ((unsigned char)data[i] << 16) | ((unsigned char)data[i + 1] << 8);
+        result += alphabet[(n >> 18) & 63];
+        result += alphabet[(n >> 12) & 63];
+        result += alphabet[(n >> 6) & 63];
+        result += '=';
+    }
+
+    return result;
+}
+
+string GetWebSocketAcceptKey(const string& key)
+{
+    return Base64Encode(Sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+static string GetHeaderValue(const string& request, const char* name)
+{
+    size_t nameLength = strlen(name);
+    size_t lineStart = request.find("\r\n");
+    while (lineStart != string::npos) {
+        lineStart += 2;
+        size_t lineEnd = request.find("\r\n", lineStart);
+        if (lineEnd == string::npos) {
+            break;
+        }
+
+        string line = request.substr(lineStart, lineEnd - lineStart);
+        if (line.size() > nameLength && strncasecmp(line.c_str(), name, nameLength) == 0 && line[nameLength] == ':') {
+            size_t valueStart = line.find_first_not_of(' ', nameLength + 1);
+            return valueStart == string::npos ? "" : line.substr(valueStart);
+        }
+        lineStart = lineEnd;
+    }
+
+    return "";
+}
+
+string GetHandshakeResponse(const string& request, string& path)
+{
+    if (request.rfind("GET ", 0) != 0) {
+        return "";
+    }
+
+    size_t pathEnd = request.find(' ', 4);
+    if (pathEnd == string::npos) {
+        return "";
+    }
+    path = request.substr(4, pathEnd - 4);
+
+    string key = GetHeaderValue(request, "Sec-WebSocket-Key");
+    if (key.empty()) {
+        return "";
+    }
+
+    return "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: " + GetWebSocketAcceptKey(key) + "\r\n\r\n";
+}
+
+void ApplyWsMask(char* data, size_t size, uint32_t maskingKey)
+{
+    unsigned char key[4] = {
+        (unsigned char)(maskingKey >> 24), (unsigned char)(maskingKey >> 16),
+        (unsigned char)(maskingKey >> 8), (unsigned char)maskingKey,
+    };
+    for (size_t i = 0; i < size; i++) {
+        data[i] ^= key[i & 3];
+    }
+}
+
+void EncodeWsFrame(string& buffer, WsOpcode opcode, const string& payload, bool mask, uint32_t maskingKey)
+{
+    unsigned char maskBit = mask ? 0x80 : 0;
+    buffer += (char)(0x80 | opcode);
+    if (payload.size() < 126) {
+        buffer += (char)(maskBit | payload.size());
+    }
+    else if (payload.size() < 65536) {
+        buffer += (char)(maskBit | 126);
+        buffer += (char)(payload.size() >> 8);
+        buffer += (char)payload.size();
+    }
+    else {
+        buffer += (char)(maskBit | 127);
+        for (int i = 7; i >= 0; i--) {
+            buffer += (char)((uint64_t)payload.size() >> (i * 8));
+        }
+    }
+
+    if (!mask) {
+        buffer += payload;
+        return;
+    }
+
+    for (int i = 3; i >= 0; i--) {
+        buffer += (char)(maskingKey >> (i * 8));
+    }
+    size_t payloadStart = buffer.size();
+    buffer += payload;
+    ApplyWsMask(&buffer[payloadStart], payload.size(), maskingKey);
+}
+
+size_t DecodeWsFrame(const string& buffer, WsFrame& frame)
+{
+    if (buffer.size() < 2) {
+        return 0;
+    }
+
+    const unsigned char* data = (const unsigned char*)buffer.data();
+    frame.fin = (data[0] & 0x80) != 0;
+    frame.opcode = (WsOpcode)(data[0] & 0x0f);
+    bool isMasked = (data[1] & 0x80) != 0;
+    uint64_t payloadSize = data[1] & 0x7f;
+    size_t headerSize = 2;
+    if (payloadSize == 126) {
+        headerSize += 2;
+        if (buffer.size() < headerSize) {
+            return 0;
+        }
+        payloadSize = (data[2] << 8) | data[3];
+    }
+    else if (payloadSize == 127) {
+        headerSize += 8;
+        if (buffer.size() < headerSize) {
+            return 0;
+        }
+        payloadSize = 0;
+        for (int i = 0; i < 8; i++) {
+            payloadSize = (payloadSize << 8) | data[2 + i];
+        }
+    }
+
+    uint32_t maskingKey = 0;
+    if (isMasked) {
+        if (buffer.size() < headerSize + 4) {
+            return 0;
+        }
+        maskingKey = (data[headerSize] << 24) | (data[headerSize + 1] << 16) | (data[headerSize + 2] << 8) | data[headerSize + 3];
+        headerSize += 4;
+    }
+
+    if (buffer.size() < headerSize + payloadSize) {
+        return 0;
+    }
+
+    frame.payload.assign(buffer, headerSize, payloadSize);
+    if (isMasked) {
+        ApplyWsMask(&frame.payload[0], frame.payload.size(), maskingKey);
+    }
+
+    return headerSize + payloadSize;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Minimal server side of the WebSocket protocol (RFC 6455), enough to talk to easywsclient.
+
+enum WsOpcode {
+    WS_OPCODE_CONTINUATION = 0x0,
+    WS_OPCODE_TEXT = 0x1,
+    WS_OPCODE_BINARY = 0x2,
+    WS_OPCODE_CLOSE = 0x8,
+    WS_OPCODE_PING = 0x9,
+    WS_OPCODE_PONG = 0xa,
+};
+
+struct WsFrame {
+    bool fin;
+    WsOpcode opcode;
+    std::string payload;
+};
+
+std::string Sha1(const std::string& data);
+std::string Base64Encode(const std::string& data);
+// Value of the Sec-WebSocket-Accept header for the Sec-WebSocket-Key sent by the client.
+std::string GetWebSocketAcceptKey(const std::string& key);
+// Returns the handshake response for a complete HTTP upgrade request, or an empty string if the request is invalid.
+// path receives the request path including the query.
+std::string GetHandshakeResponse(const std::string& request, std::string& path);
+// Appends a frame to buffer. Frames sent by clients must be masked with a random key, server frames must not.
+void EncodeWsFrame(std::string& buffer, WsOpcode opcode, const std::string& payload, bool mask, uint32_t maskingKey = 0);
+// Decodes the frame at the start of buffer and unmasks its payload. Returns the frame size, 0 if the buffer doesn't
+// contain a complete frame yet.
+size_t DecodeWsFrame(const std::string& buffer, WsFrame& frame);
+void ApplyWsMask(char* data, size_t size, uint32_t maskingKey);
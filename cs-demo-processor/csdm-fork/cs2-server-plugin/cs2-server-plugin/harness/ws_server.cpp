@@ -0,0 +1,564 @@
+// Stand-in for the CS:DM WebSocket server (src/server/server.ts) that speaks the game protocol.
+// It sends playdemo messages to the game process (the plugin or the harness started with --ws-url) and either replays
+// a recorded message trace or generates synthetic load, then reports throughput and latency figures as JSON.
+//
+// Usage: ws-server [--port N] [--demo path] [--replay trace.jsonl] [--speed factor] [--record trace.jsonl]
+//                  [--bursts N] [--burst-size N] [--payload-size bytes] [--slow-reader-ms N] [--disconnect-every N]
+//                  [--timeout-ms N] [--output path]
+//
+// Load mode (default): each burst sends --burst-size messages with a --payload-size payload, followed by a playdemo
+// probe. The burst is done when the status reply of the probe is received. With --slow-reader-ms, the server reads
+// small chunks and sleeps between reads. With --disconnect-every, the connection is reset without a close frame every N
+// bursts and the server waits for the game to reconnect.
+//
+// Trace format, one JSON object per line, time in ms relative to the connection:
+// {"time": 0, "direction": "out", "message": {"name": "playdemo", "payload": "..."}}
+// {"time": 12, "direction": "in", "message": {"name": "status", "payload": "ok"}}
+// {"time": 500, "event": "disconnect"}
+// Replay sends the "out" messages at their time divided by --speed (0 sends them as fast as possible) and compares the
+// names of the "in" messages with the received ones. --record writes a session in the same format.
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+#include "ws_protocol.h"
+
+using nlohmann::json;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+struct Connection {
+    int fd = -1;
+    string rxbuf;
+    string path;
+    Clock::time_point connectedAt;
+};
+
+struct ReceivedMessage {
+    double time;
+    json message;
+};
+
+static int slowReaderDelay = 0;
+static std::ofstream recordFile;
+static int totalReceivedMessages = 0;
+static uint64_t totalReceivedBytes = 0;
+static uint64_t totalSentBytes = 0;
+
+static double GetElapsedMs(Clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+static void Record(const Connection& connection, const char* direction, const json& message)
+{
+    if (!recordFile.is_open()) {
+        return;
+    }
+
+    json line;
+    line["time"] = GetElapsedMs(connection.connectedAt);
+    line["direction"] = direction;
+    line["message"] = message;
+    recordFile << line.dump() << "\n";
+}
+
+static int Listen(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 4) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool SendAll(int fd, const string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0) {
+            return false;
+        }
+        sent += count;
+    }
+
+    return true;
+}
+
+// Accepts connections until the game process connects, other processes are disconnected.
+static bool AcceptGameConnection(int listenFd, Connection& connection, int timeoutMs)
+{
+    auto start = Clock::now();
+    while (GetElapsedMs(start) < timeoutMs) {
+        pollfd pfd = { listenFd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == string::npos && GetElapsedMs(start) < timeoutMs) {
+            pollfd clientPfd = { fd, POLLIN, 0 };
+            if (poll(&clientPfd, 1, 100) <= 0) {
+                continue;
+            }
+            ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+            if (count <= 0) {
+                break;
+            }
+            request.append(buffer, count);
+        }
+
+        string path;
+        string response = GetHandshakeResponse(request, path);
+        if (response.empty() || path.find("process=game") == string::npos || !SendAll(fd, response)) {
+            close(fd);
+            continue;
+        }
+
+        connection.fd = fd;
+        connection.path = path;
+        connection.rxbuf = request.substr(request.find("\r\n\r\n") + 4);
+        connection.connectedAt = Clock::now();
+
+        return true;
+    }
+
+    return false;
+}
+
+static bool SendMessage(Connection& connection, const json& message)
+{
+    string frame;
+    EncodeWsFrame(frame, WS_OPCODE_TEXT, message.dump(), false);
+    totalSentBytes += frame.size();
+    Record(connection, "out", message);
+
+    return SendAll(connection.fd, frame);
+}
+
+// Resets the connection without a close frame.
+static void Disconnect(Connection& connection)
+{
+    linger lingerOption = { 1, 0 };
+    setsockopt(connection.fd, SOL_SOCKET, SO_LINGER, &lingerOption, sizeof(lingerOption));
+    close(connection.fd);
+    connection.fd = -1;
+    connection.rxbuf.clear();
+}
+
+// Reads the messages received during timeoutMs at most, returns false if the connection has been closed.
+static bool ReceiveMessages(Connection& connection, std::vector<ReceivedMessage>& messages, int timeoutMs)
+{
+    pollfd pfd = { connection.fd, POLLIN, 0 };
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+        return true;
+    }
+
+    if (slowReaderDelay > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(slowReaderDelay));
+    }
+
+    char buffer[65536];
+    size_t readSize = slowReaderDelay > 0 ? 512 : sizeof(buffer);
+    ssize_t count = recv(connection.fd, buffer, readSize, 0);
+    if (count <= 0) {
+        return false;
+    }
+    connection.rxbuf.append(buffer, count);
+    totalReceivedBytes += count;
+
+    WsFrame frame;
+    size_t frameSize;
+    while ((frameSize = DecodeWsFrame(connection.rxbuf, frame)) > 0) {
+        connection.rxbuf.erase(0, frameSize);
+        if (frame.opcode == WS_OPCODE_TEXT || frame.opcode == WS_OPCODE_BINARY) {
+            json message = json::parse(frame.payload, nullptr, false);
+            if (message.is_discarded()) {
+                message = frame.payload;
+            }
+            Record(connection, "in", message);
+            messages.push_back({ GetElapsedMs(connection.connectedAt), message });
+            totalReceivedMessages++;
+        }
+        else if (frame.opcode == WS_OPCODE_PING) {
+            string pong;
+            EncodeWsFrame(pong, WS_OPCODE_PONG, frame.payload, false);
+            SendAll(connection.fd, pong);
+        }
+        else if (frame.opcode == WS_OPCODE_CLOSE) {
+            string closeFrame;
+            EncodeWsFrame(closeFrame, WS_OPCODE_CLOSE, "", false);
+            SendAll(connection.fd, closeFrame);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static string GetMessageName(const json& message)
+{
+    if (message.is_object() && message.contains("name") && message["name"].is_string()) {
+        return message["name"];
+    }
+
+    return "";
+}
+
+// Reads messages until one with the given name is received, returns its reception time or a negative value.
+static double WaitForMessage(Connection& connection, const string& name, std::vector<ReceivedMessage>& messages, int timeoutMs)
+{
+    auto start = Clock::now();
+    size_t checkedCount = messages.size();
+    while (GetElapsedMs(start) < timeoutMs) {
+        if (!ReceiveMessages(connection, messages, 10)) {
+            return -1;
+        }
+
+        for (; checkedCount < messages.size(); checkedCount++) {
+            if (GetMessageName(messages[checkedCount].message) == name) {
+                return messages[checkedCount].time;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static json GetStatsJson(std::vector<double> samples)
+{
+    json stats;
+    stats["count"] = samples.size();
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+    stats["avgMs"] = total / samples.size();
+    stats["p50Ms"] = samples[samples.size() / 2];
+    stats["p99Ms"] = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    stats["maxMs"] = samples.back();
+
+    return stats;
+}
+
+static json RunLoad(int listenFd, Connection& connection, const string& demoPath, int burstCount, int burstSize,
+    int payloadSize, int disconnectEvery, int timeoutMs)
+{
+    json bursts = json::array();
+    std::vector<double> latencies;
+    std::vector<double> reconnectDurations;
+    std::vector<ReceivedMessage> messages;
+    double totalDuration = 0;
+    uint64_t totalBytes = 0;
+    int totalMessages = 0;
+    int failedBursts = 0;
+
+    json loadMessage;
+    loadMessage["name"] = "load";
+    loadMessage["payload"] = string(payloadSize, 'x');
+    json probe;
+    probe["name"] = "playdemo";
+    probe["payload"] = demoPath;
+
+    for (int i = 0; i < burstCount; i++) {
+        if (connection.fd < 0) {
+            auto disconnectedAt = Clock::now();
+            if (!AcceptGameConnection(listenFd, connection, timeoutMs)) {
+                fprintf(stderr, "The game didn't reconnect\n");
+                break;
+            }
+            reconnectDurations.push_back(GetElapsedMs(disconnectedAt));
+        }
+
+        auto start = Clock::now();
+        uint64_t bytesBefore = totalSentBytes;
+        bool isConnected = true;
+        for (int j = 0; j < burstSize && isConnected; j++) {
+            isConnected = SendMessage(connection, loadMessage);
+        }
+
+        double probeSentAt = GetElapsedMs(connection.connectedAt);
+        isConnected = isConnected && SendMessage(connection, probe);
+        double statusReceivedAt = isConnected ? WaitForMessage(connection, "status", messages, timeoutMs) : -1;
+        double duration = GetElapsedMs(start);
+
+        json burst;
+        burst["index"] = i;
+        burst["messages"] = burstSize + 1;
+        burst["bytes"] = totalSentBytes - bytesBefore;
+        burst["durationMs"] = duration;
+        if (statusReceivedAt >= 0) {
+            burst["latencyMs"] = statusReceivedAt - probeSentAt;
+            latencies.push_back(statusReceivedAt - probeSentAt);
+            totalDuration += duration;
+            totalBytes += totalSentBytes - bytesBefore;
+            totalMessages += burstSize + 1;
+        }
+        else {
+            burst["error"] = "no status received";
+            failedBursts++;
+        }
+        bursts.push_back(burst);
+
+        if (statusReceivedAt < 0 || (disconnectEvery > 0 && (i + 1) % disconnectEvery == 0 && i + 1 < burstCount)) {
+            Disconnect(connection);
+        }
+    }
+
+    json result;
+    result["mode"] = "load";
+    result["burstSize"] = burstSize;
+    result["payloadSize"] = payloadSize;
+    result["slowReaderMs"] = slowReaderDelay;
+    result["failedBursts"] = failedBursts;
+    result["messagesPerSecond"] = totalDuration > 0 ? totalMessages / (totalDuration / 1000) : 0;
+    result["megabytesPerSecond"] = totalDuration > 0 ? totalBytes / (totalDuration / 1000) / (1024 * 1024) : 0;
+    result["latency"] = GetStatsJson(latencies);
+    result["reconnect"] = GetStatsJson(reconnectDurations);
+    result["bursts"] = bursts;
+
+    return result;
+}
+
+static json RunReplay(int listenFd, Connection& connection, const string& tracePath, double speed, int timeoutMs)
+{
+    std::ifstream traceFile(tracePath);
+    std::vector<json> trace;
+    string line;
+    while (std::getline(traceFile, line)) {
+        if (!line.empty()) {
+            trace.push_back(json::parse(line));
+        }
+    }
+
+    std::vector<string> expectedNames;
+    std::vector<ReceivedMessage> messages;
+    std::vector<double> reconnectDurations;
+    int sentCount = 0;
+    auto start = Clock::now();
+    for (const auto& entry : trace) {
+        double time = entry.value("time", 0.0);
+        if (speed > 0) {
+            double target = time / speed;
+            while (GetElapsedMs(start) < target) {
+                if (connection.fd >= 0 && !ReceiveMessages(connection, messages, 1)) {
+                    Disconnect(connection);
+                }
+            }
+        }
+
+        if (connection.fd < 0) {
+            auto disconnectedAt = Clock::now();
+            if (!AcceptGameConnection(listenFd, connection, timeoutMs)) {
+                fprintf(stderr, "The game didn't reconnect\n");
+                break;
+            }
+            reconnectDurations.push_back(GetElapsedMs(disconnectedAt));
+            // The trace continues from the current entry on the new connection.
+            start = Clock::now() - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(speed > 0 ? time / speed : 0));
+        }
+
+        if (entry.value("event", "") == "disconnect") {
+            Disconnect(connection);
+        }
+        else if (entry.value("direction", "") == "out") {
+            SendMessage(connection, entry["message"]);
+            sentCount++;
+        }
+        else if (entry.value("direction", "") == "in") {
+            expectedNames.push_back(GetMessageName(entry["message"]));
+        }
+    }
+
+    // Messages still in flight.
+    auto lingerStart = Clock::now();
+    while (connection.fd >= 0 && GetElapsedMs(lingerStart) < std::min(timeoutMs, 2000)) {
+        if (!ReceiveMessages(connection, messages, 10)) {
+            Disconnect(connection);
+        }
+    }
+
+    std::vector<string> receivedNames;
+    for (const auto& message : messages) {
+        receivedNames.push_back(GetMessageName(message.message));
+    }
+
+    json mismatches = json::array();
+    for (size_t i = 0; i < std::max(expectedNames.size(), receivedNames.size()); i++) {
+        string expected = i < expectedNames.size() ? expectedNames[i] : "";
+        string received = i < receivedNames.size() ? receivedNames[i] : "";
+        if (expected != received) {
+            mismatches.push_back({ { "index", i }, { "expected", expected }, { "received", received } });
+        }
+    }
+
+    json result;
+    result["mode"] = "replay";
+    result["trace"] = tracePath;
+    result["sentMessages"] = sentCount;
+    result["expectedMessages"] = expectedNames.size();
+    result["receivedMessages"] = receivedNames.size();
+    result["mismatches"] = mismatches;
+    result["reconnect"] = GetStatsJson(reconnectDurations);
+
+    return result;
+}
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: ws-server [--port N] [--demo path] [--replay trace.jsonl] [--speed factor] [--record trace.jsonl] "
+        "[--bursts N] [--burst-size N] [--payload-size bytes] [--slow-reader-ms N] [--disconnect-every N] [--timeout-ms N] "
+        "[--output path]\n");
+
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    int port = 4574;
+    string demoPath = "demo.dem";
+    string replayPath;
+    string recordPath;
+    string outputPath;
+    double speed = 1;
+    int burstCount = 10;
+    int burstSize = 100;
+    int payloadSize = 1024;
+    int disconnectEvery = 0;
+    int timeoutMs = 10000;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            return PrintUsage();
+        }
+
+        const char* value = argv[++i];
+        if (arg == "--port") {
+            port = atoi(value);
+        }
+        else if (arg == "--demo") {
+            demoPath = value;
+        }
+        else if (arg == "--replay") {
+            replayPath = value;
+        }
+        else if (arg == "--speed") {
+            speed = atof(value);
+        }
+        else if (arg == "--record") {
+            recordPath = value;
+        }
+        else if (arg == "--bursts") {
+            burstCount = atoi(value);
+        }
+        else if (arg == "--burst-size") {
+            burstSize = atoi(value);
+        }
+        else if (arg == "--payload-size") {
+            payloadSize = atoi(value);
+        }
+        else if (arg == "--slow-reader-ms") {
+            slowReaderDelay = atoi(value);
+        }
+        else if (arg == "--disconnect-every") {
+            disconnectEvery = atoi(value);
+        }
+        else if (arg == "--timeout-ms") {
+            timeoutMs = atoi(value);
+        }
+        else if (arg == "--output") {
+            outputPath = value;
+        }
+        else {
+            return PrintUsage();
+        }
+    }
+
+    int listenFd = Listen(port);
+    if (listenFd < 0) {
+        fprintf(stderr, "Failed to listen on port %d: %s\n", port, strerror(errno));
+        return 1;
+    }
+
+    if (!recordPath.empty()) {
+        recordFile.open(recordPath, std::ios::trunc);
+    }
+
+    Connection connection;
+    if (!AcceptGameConnection(listenFd, connection, timeoutMs)) {
+        fprintf(stderr, "The game didn't connect\n");
+        close(listenFd);
+        return 1;
+    }
+
+    auto start = Clock::now();
+    json result;
+    if (replayPath.empty()) {
+        result = RunLoad(listenFd, connection, demoPath, burstCount, burstSize, payloadSize, disconnectEvery, timeoutMs);
+    }
+    else {
+        result = RunReplay(listenFd, connection, replayPath, speed, timeoutMs);
+    }
+
+    if (connection.fd >= 0) {
+        string closeFrame;
+        EncodeWsFrame(closeFrame, WS_OPCODE_CLOSE, "", false);
+        SendAll(connection.fd, closeFrame);
+        close(connection.fd);
+    }
+    close(listenFd);
+
+    result["durationMs"] = GetElapsedMs(start);
+    result["sentBytes"] = totalSentBytes;
+    result["receivedBytes"] = totalReceivedBytes;
+    result["receivedMessageCount"] = totalReceivedMessages;
+
+    if (outputPath.empty()) {
+        printf("%s\n", result.dump(2).c_str());
+    }
+    else {
+        std::ofstream output(outputPath, std::ios::trunc);
+        output << result.dump(2);
+    }
+
+    bool failed = result.value("failedBursts", 0) > 0 || (result.contains("mismatches") && !result["mismatches"].empty());
+
+    return failed ? 1 : 0;
+}
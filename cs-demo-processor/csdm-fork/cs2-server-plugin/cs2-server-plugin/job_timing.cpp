@@ -0,0 +1,156 @@
+#include "job_timing.h"
+#include <fstream>
+#include <vector>
+
+using nlohmann::json;
+using std::string;
+
+struct SequenceTiming {
+    int index;
+    double durations[JOB_PHASE_COUNT];
+    // Demo tick when the phase was entered for the first time, -1 if it wasn't.
+    int startTicks[JOB_PHASE_COUNT];
+};
+
+static const char* phaseNames[JOB_PHASE_COUNT] = {
+    "loading",
+    "setupSeek",
+    "pause",
+    "preRoll",
+    "recording",
+    "postRoll",
+};
+
+// Only used from the playback thread.
+static bool isActive = false;
+static string jobDemoPath;
+static double jobStartTime = 0;
+static double jobEndTime = 0;
+static double loadingDuration = 0;
+static JobPhase currentPhase = JOB_PHASE_LOADING;
+static double phaseStartTime = 0;
+static std::vector<SequenceTiming> sequenceTimings;
+
+const char* GetJobPhaseName(JobPhase phase)
+{
+    return phase < JOB_PHASE_COUNT ? phaseNames[phase] : "unknown";
+}
+
+static void StartSequence(int sequenceIndex)
+{
+    SequenceTiming timing = {};
+    timing.index = sequenceIndex;
+    for (int i = 0; i < JOB_PHASE_COUNT; i++) {
+        timing.startTicks[i] = -1;
+    }
+    sequenceTimings.push_back(timing);
+}
+
+// Adds the time spent in the current phase.
+static void ClosePhase(double now)
+{
+    double duration = now - phaseStartTime;
+    if (currentPhase == JOB_PHASE_LOADING) {
+        loadingDuration += duration;
+    }
+    else if (!sequenceTimings.empty()) {
+        sequenceTimings.back().durations[currentPhase] += duration;
+    }
+    phaseStartTime = now;
+}
+
+void JobTimingBegin(const string& demoPath, int sequenceIndex, double now)
+{
+    isActive = true;
+    jobDemoPath = demoPath;
+    jobStartTime = now;
+    jobEndTime = now;
+    loadingDuration = 0;
+    currentPhase = JOB_PHASE_LOADING;
+    phaseStartTime = now;
+    sequenceTimings.clear();
+    StartSequence(sequenceIndex);
+}
+
+bool IsJobTimingActive()
+{
+    return isActive;
+}
+
+void JobTimingEnterPhase(JobPhase phase, int tick, double now)
+{
+    if (!isActive || phase == currentPhase) {
+        return;
+    }
+
+    ClosePhase(now);
+    currentPhase = phase;
+    if (phase != JOB_PHASE_LOADING && sequenceTimings.back().startTicks[phase] < 0) {
+        sequenceTimings.back().startTicks[phase] = tick;
+    }
+}
+
+void JobTimingNextSequence(int sequenceIndex, int tick, double now)
+{
+    if (!isActive) {
+        return;
+    }
+
+    ClosePhase(now);
+    StartSequence(sequenceIndex);
+    currentPhase = JOB_PHASE_SETUP_SEEK;
+    sequenceTimings.back().startTicks[JOB_PHASE_SETUP_SEEK] = tick;
+}
+
+void JobTimingEnd(double now)
+{
+    if (!isActive) {
+        return;
+    }
+
+    ClosePhase(now);
+    jobEndTime = now;
+    isActive = false;
+}
+
+json GetJobTimingJson()
+{
+    double now = isActive ? phaseStartTime : jobEndTime;
+    double totals[JOB_PHASE_COUNT] = {};
+    totals[JOB_PHASE_LOADING] = loadingDuration;
+
+    json jsonSequences = json::array();
+    for (const auto& timing : sequenceTimings) {
+        json jsonSequence;
+        jsonSequence["index"] = timing.index;
+        double total = 0;
+        for (int i = JOB_PHASE_SETUP_SEEK; i < JOB_PHASE_COUNT; i++) {
+            jsonSequence["durations"][phaseNames[i]] = timing.durations[i];
+            jsonSequence["startTicks"][phaseNames[i]] = timing.startTicks[i];
+            totals[i] += timing.durations[i];
+            total += timing.durations[i];
+        }
+        jsonSequence["total"] = total;
+        jsonSequences.push_back(jsonSequence);
+    }
+
+    json timing;
+    timing["demoPath"] = jobDemoPath;
+    timing["total"] = now - jobStartTime;
+    for (int i = 0; i < JOB_PHASE_COUNT; i++) {
+        timing["phases"][phaseNames[i]] = totals[i];
+    }
+    timing["sequences"] = jsonSequences;
+
+    return timing;
+}
+
+void WriteJobTimingFile(const string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.good()) {
+        return;
+    }
+
+    file << GetJobTimingJson().dump(2);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <nlohmann/json.hpp>
+
+// Accounts the wall-clock time of a demo playback job per sequence and per phase, so that the margins of the actions
+// file generator (setup tick, pause tick, ticks after the end of the recording) can be tuned from real data.
+// The phases of a sequence follow the actions of a recording sequence:
+// setupSeek (skip ahead to the setup tick, setup commands) -> pause (pause_playback) -> preRoll -> recording
+// (startmovie/mirv_streams record start) -> postRoll (endmovie/mirv_streams record end until the next sequence).
+// Phases that a sequence doesn't have, e.g. pause and recording when watching highlights, stay at 0.
+
+enum JobPhase {
+    // From the playdemo command to the playback start.
+    JOB_PHASE_LOADING,
+    JOB_PHASE_SETUP_SEEK,
+    JOB_PHASE_PAUSE,
+    JOB_PHASE_PRE_ROLL,
+    JOB_PHASE_RECORDING,
+    JOB_PHASE_POST_ROLL,
+    JOB_PHASE_COUNT,
+};
+
+const char* GetJobPhaseName(JobPhase phase);
+// Starts the accounting of a new job, sequenceIndex is the index of the first sequence played (resumed recordings).
+void JobTimingBegin(const std::string& demoPath, int sequenceIndex, double now);
+bool IsJobTimingActive();
+void JobTimingEnterPhase(JobPhase phase, int tick, double now);
+// Ends the current sequence and starts the next one in the setupSeek phase.
+void JobTimingNextSequence(int sequenceIndex, int tick, double now);
+// Ends the job, the summary is available with GetJobTimingJson until the next JobTimingBegin.
+void JobTimingEnd(double now);
+nlohmann::json GetJobTimingJson();
+void WriteJobTimingFile(const std::string& path);
@@ -0,0 +1,223 @@
+#include "journal.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include "utils.h"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using std::string;
+
+#define JOURNAL_VERSION 1
+// Demos are big, the checksum is based on the file size and its first bytes which contain the header.
+#define DEMO_CHECKSUM_BYTE_COUNT 65536
+
+static std::mutex journalMutex;
+static FILE* journalFile = NULL;
+static string journalPath;
+static int journalSequenceCount = 0;
+
+// FNV-1a 64 bits.
+static uint64_t HashFile(const string& path, size_t maxByteCount, uint64_t* fileSize)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) {
+        return 0;
+    }
+
+    std::vector<char> buffer(8192);
+    size_t totalRead = 0;
+    while (file && totalRead < maxByteCount) {
+        file.read(buffer.data(), std::min(buffer.size(), maxByteCount - totalRead));
+        std::streamsize readCount = file.gcount();
+        for (std::streamsize i = 0; i < readCount; i++) {
+            hash ^= (unsigned char)buffer[i];
+            hash *= 1099511628211ULL;
+        }
+        totalRead += readCount;
+    }
+
+    if (fileSize != NULL) {
+        file.clear();
+        file.seekg(0, std::ios::end);
+        *fileSize = (uint64_t)file.tellg();
+    }
+
+    return hash;
+}
+
+static string GetChecksumString(uint64_t value)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)value);
+
+    return string(buf);
+}
+
+static void SyncJournalFile()
+{
+    fflush(journalFile);
+#ifdef _WIN32
+    _commit(_fileno(journalFile));
+#else
+    fsync(fileno(journalFile));
+#endif
+}
+
+// Returns the number of consecutive completed sequences from the first one.
+static int ReadCompletedSequenceCount(const string& path, const string& header)
+{
+    std::ifstream file(path);
+    if (!file.good()) {
+        return 0;
+    }
+
+    string line;
+    if (!std::getline(file, line) || line != header) {
+        return 0;
+    }
+
+    std::vector<bool> completed;
+    while (std::getline(file, line)) {
+        std::istringstream record(line);
+        string type;
+        int sequenceIndex = -1;
+        record >> type >> sequenceIndex;
+        if (type == "done" && sequenceIndex >= 0) {
+            if ((size_t)sequenceIndex >= completed.size()) {
+                completed.resize(sequenceIndex + 1, false);
+            }
+            completed[sequenceIndex] = true;
+        }
+    }
+
+    int count = 0;
+    while ((size_t)count < completed.size() && completed[count]) {
+        count++;
+    }
+
+    return count;
+}
+
+static string GetJournalHeader(const string& demoPath, const string& actionsFilePath)
+{
+    uint64_t demoSize = 0;
+    uint64_t demoChecksum = HashFile(demoPath, DEMO_CHECKSUM_BYTE_COUNT, &demoSize) ^ demoSize;
+    uint64_t actionsChecksum = HashFile(actionsFilePath, SIZE_MAX, NULL);
+
+    return "csdm_progress " + std::to_string(JOURNAL_VERSION) + " " + GetChecksumString(demoChecksum) + " " + GetChecksumString(actionsChecksum);
+}
+
+int OpenProgressJournal(const string& demoPath, const string& actionsFilePath, int sequenceCount)
+{
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (journalFile != NULL) {
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+
+    string header = GetJournalHeader(demoPath, actionsFilePath);
+    journalPath = demoPath + ".progress";
+    journalSequenceCount = sequenceCount;
+    int completedCount = ReadCompletedSequenceCount(journalPath, header);
+    if (completedCount >= sequenceCount) {
+        completedCount = 0;
+    }
+
+    if (completedCount > 0) {
+        journalFile = fopen(journalPath.c_str(), "a");
+    }
+    else {
+        journalFile = fopen(journalPath.c_str(), "w");
+        if (journalFile != NULL) {
+            fprintf(journalFile, "%s\n", header.c_str());
+            SyncJournalFile();
+        }
+    }
+
+    if (journalFile == NULL) {
+        Log("Failed to open progress journal %s", journalPath.c_str());
+    }
+
+    return completedCount;
+}
+
+void ReopenProgressJournal(const string& demoPath, const string& actionsFilePath, int sequenceCount, int completedCount)
+{
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (journalFile != NULL) {
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+
+    journalPath = demoPath + ".progress";
+    journalSequenceCount = sequenceCount;
+    journalFile = fopen(journalPath.c_str(), "w");
+    if (journalFile == NULL) {
+        Log("Failed to open progress journal %s", journalPath.c_str());
+        return;
+    }
+
+    fprintf(journalFile, "%s\n", GetJournalHeader(demoPath, actionsFilePath).c_str());
+    for (int i = 0; i < std::min(completedCount, sequenceCount); i++) {
+        fprintf(journalFile, "done %d\n", i);
+    }
+    SyncJournalFile();
+}
+
+void JournalRecordingStarted(int sequenceIndex, const string& cmd)
+{
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (journalFile == NULL) {
+        return;
+    }
+
+    fprintf(journalFile, "start %d %s\n", sequenceIndex, cmd.c_str());
+    fflush(journalFile);
+}
+
+void JournalRecordingEnded(int sequenceIndex, int tick)
+{
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (journalFile == NULL) {
+        return;
+    }
+
+    fprintf(journalFile, "end %d %d\n", sequenceIndex, tick);
+    fflush(journalFile);
+}
+
+void JournalSequenceCompleted(int sequenceIndex)
+{
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (journalFile == NULL) {
+        return;
+    }
+
+    if (sequenceIndex >= journalSequenceCount - 1) {
+        fclose(journalFile);
+        journalFile = NULL;
+        remove(journalPath.c_str());
+        return;
+    }
+
+    fprintf(journalFile, "done %d\n", sequenceIndex);
+    SyncJournalFile();
+}
+
+void CloseProgressJournal()
+{
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if (journalFile != NULL) {
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+// Crash-safe journal of the recording progress of a demo, stored next to the demo as <demo>.progress.
+// If the game crashes or is killed during a recording, the next playback of the same demo with the same actions file
+// skips the sequences that have already been recorded.
+//
+// Format, one record per line:
+// csdm_progress 1 <demo checksum> <actions file checksum>
+// start <sequence index> <recording command>
+// end <sequence index> <tick>
+// done <sequence index>
+
+// Opens the journal of the demo and returns the number of sequences already completed, 0 if the journal doesn't exist
+// or belongs to another demo/actions file. In this case a new journal is created.
+int OpenProgressJournal(const std::string& demoPath, const std::string& actionsFilePath, int sequenceCount);
+// Replaces the journal when the actions file changed during the playback, the first completedCount sequences are
+// recorded as completed with the checksum of the new actions file.
+void ReopenProgressJournal(const std::string& demoPath, const std::string& actionsFilePath, int sequenceCount, int completedCount);
+void JournalRecordingStarted(int sequenceIndex, const std::string& cmd);
+void JournalRecordingEnded(int sequenceIndex, int tick);
+// The journal is flushed to the disk at sequence boundaries, it's deleted once the last sequence is completed.
+void JournalSequenceCompleted(int sequenceIndex);
+void CloseProgressJournal();
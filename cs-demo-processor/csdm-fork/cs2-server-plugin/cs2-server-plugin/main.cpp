@@ -1,65 +1,31 @@
 #include <thread>
 #include <fstream>
-#include <queue>
-#include <nlohmann/json.hpp>
-#include <easywsclient.hpp>
 #include "icvar.h"
 #include "cdll_interfaces.h"
+#include "playback.h"
+#include "websocket.h"
+#include "timeline.h"
+#include "utils.h"
+#include "journal.h"
+#include "watchdog.h"
+#include "session_trace.h"
+#include "actions_watcher.h"
 #ifdef _WIN32
 #define SERVER_LIB_PATH "\\csgo\\bin\\win64\\server.dll"
 #else
-#include <dlfcn.h>
 #include <sys/mman.h>
 #define SERVER_LIB_PATH "/csgo/bin/linuxsteamrt64/libserver.so"
 #define PAGESIZE 4096
 #endif
+#define DEFAULT_WS_URL "ws://localhost:4574"
 
 // IDKW registering a cmd on Linux makes the game process exit with a non zero code (Segmentation fault)
 #ifdef _WIN32
 #define CON_COMMAND_ENABLED 1
 #endif
 
-using easywsclient::WebSocket;
-using nlohmann::json;
 using std::string;
 
-void* GetLibAddress(void* lib, const char* name) {
-#if defined _WIN32
-	return GetProcAddress((HMODULE)lib, name);
-#else
-	return dlsym(lib, name);
-#endif
-}
-
-char* GetLastErrorString() {
-#ifdef _WIN32
-    DWORD error = GetLastError();
-    static char s[_MAX_U64TOSTR_BASE2_COUNT];
-    sprintf(s, "%lu", error);
-
-	return s;
-#else
-	return dlerror();
-#endif
-}
-
-void* LoadLib(const char* path) {
-#ifdef _WIN32
-    return LoadLibrary(path);
-#else
-	return dlopen(path, RTLD_NOW);
-#endif
-}
-
-struct Action {
-    int tick;
-    string cmd;
-};
-
-struct Sequence {
-    std::vector<Action> actions;
-};
-
 typedef bool (*AppSystemConnectFn)(IAppSystem* appSystem, CreateInterfaceFn factory);
 typedef void (*AppSystemShutdownFn)();
 
@@ -71,86 +37,86 @@ ISource2EngineToClient* engineToClient = NULL;
 ICvar* g_pCVar = NULL;
 std::thread* wsConnectionThread = NULL;
 std::thread* demoPlaybackThread = NULL;
-WebSocket::pointer ws;
 string gameInfoPath;
 string gameInfoBackupPath;
 const char* demoPath = NULL;
-bool isPlayingDemo = false;
-int currentTick = -1;
-bool isQuitting = false;
-bool initialized = false;
-std::queue<Sequence> sequences;
-
-void LogToFile(const char* pMsg) {
-    FILE* pFile = fopen("csdm.log", "a");
-    if (pFile == NULL)
+// Several game instances may run on the same machine, each one has its own WebSocket server URL, log file and
+// startup timeline file. They are read from launch parameters or environment variables.
+string instanceId;
+
+// Access indexes of the commands and cvars that were hidden when they have been scanned.
+// Commands and cvars registered later usually get higher access indexes, so only the ones registered since the previous
+// scan have to be scanned when the playback of another demo starts. An entry registered into a slot freed by an
+// unregistration (e.g. a plugin reload) gets a lower index, the registered counts then don't match the scanned ones and
+// everything is scanned again.
+std::vector<uint16> hiddenConCommandIndexes;
+std::vector<uint16> hiddenConVarIndexes;
+uint16 nextConCommandIndexToScan = 0;
+uint16 nextConVarIndexToScan = 0;
+int scannedConCommandCount = 0;
+int scannedConVarCount = 0;
+
+static int ScanHiddenCommandsAndCvars(uint64 flagsToRemove)
+{
+    int scannedCount = 0;
+    ConCommandData* data = g_pCVar->GetConCommandData(ConCommandRef());
+    for (ConCommandRef concmd = ConCommandRef(nextConCommandIndexToScan); concmd.GetRawData() != data; concmd = ConCommandRef(concmd.GetAccessIndex() + 1))
     {
-        return;
+        if (concmd.GetFlags() & flagsToRemove)
+        {
+            hiddenConCommandIndexes.push_back(concmd.GetAccessIndex());
+        }
+        nextConCommandIndexToScan = concmd.GetAccessIndex() + 1;
+        scannedConCommandCount++;
+        scannedCount++;
     }
 
-    fprintf(pFile, "%s\n", pMsg);
-    fclose(pFile);
-}
-
-void DeleteLogFile()
-{
-    remove("csdm.log");
-}
-
-void Log(const char *msg, ...)
-{
-	va_list args;
-	va_start(args, msg);
-	char buf[1024] = {};
-	vsnprintf(buf, sizeof(buf), msg, args);
-	ConColorMsg(Color(227, 0, 255, 255), "CSDM: %s\n", buf);
-	va_end(args);
-    LogToFile(buf);
-}
-
-void PluginError(const char* msg, ...)
-{
-    va_list args;
-    va_start(args, msg);
-    char buf[1024] = {};
-    vsnprintf(buf, sizeof(buf), msg, args);
-    va_end(args);
-
-    // Since the "Armory" update, calling Plat_FatalErrorFunc crashes the game on Windows.
-    #ifdef _WIN32
-        Plat_MessageBox("Error", buf);
-        Plat_ExitProcess(1);
-    #else
-        Plat_FatalErrorFunc("%s", buf);
-    #endif
-}
-
-inline bool FileExists(const std::string& name) {
-    std::ifstream f(name.c_str());
+    for (ConVarRefAbstract ref{ ConVarRef(nextConVarIndexToScan) }; ref.IsValidRef(); ref = ConVarRefAbstract(ConVarRef(ref.GetAccessIndex() + 1)))
+    {
+        if (ref.GetFlags() & flagsToRemove)
+        {
+            hiddenConVarIndexes.push_back(ref.GetAccessIndex());
+        }
+        nextConVarIndexToScan = ref.GetAccessIndex() + 1;
+        scannedConVarCount++;
+        scannedCount++;
+    }
 
-    return f.good();
+    return scannedCount;
 }
 
-static void UnhideCommandsAndCvars()
+void UnhideCommandsAndCvars()
 {
+    auto start = std::chrono::steady_clock::now();
     uint64 flagsToRemove = (FCVAR_HIDDEN | FCVAR_DEVELOPMENTONLY);
 
-    ConCommandData* data = g_pCVar->GetConCommandData(ConCommandRef());
-    for (ConCommandRef concmd = ConCommandRef((uint16)0); concmd.GetRawData() != data; concmd = ConCommandRef(concmd.GetAccessIndex() + 1))
+    int scannedCount = ScanHiddenCommandsAndCvars(flagsToRemove);
+    CCvar* cvar = static_cast<CCvar*>(g_pCVar);
+    bool isFullScan = cvar->m_ConCommandCount != scannedConCommandCount || cvar->m_ConVarCount != scannedConVarCount;
+    if (isFullScan)
     {
-        if (concmd.GetFlags() & flagsToRemove)
-        {
-            concmd.RemoveFlags(flagsToRemove);
-        }
+        hiddenConCommandIndexes.clear();
+        hiddenConVarIndexes.clear();
+        nextConCommandIndexToScan = 0;
+        nextConVarIndexToScan = 0;
+        scannedConCommandCount = 0;
+        scannedConVarCount = 0;
+        scannedCount += ScanHiddenCommandsAndCvars(flagsToRemove);
     }
 
-    for (ConVarRefAbstract ref(ConVarRef((uint16)0)); ref.IsValidRef(); ref = ConVarRefAbstract(ConVarRef(ref.GetAccessIndex() + 1)))
+    // Flags are removed again from all the cached entries in case the game restored them.
+    for (uint16 index : hiddenConCommandIndexes)
     {
-        if (ref.GetFlags() & flagsToRemove)
-        {
-            ref.RemoveFlags(flagsToRemove);
-        }
+        ConCommandRef(index).RemoveFlags(flagsToRemove);
+    }
+
+    for (uint16 index : hiddenConVarIndexes)
+    {
+        ConVarRefAbstract(ConVarRef(index)).RemoveFlags(flagsToRemove);
     }
+
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    Log("Unhid %d commands and %d cvars in %.3f ms (%d entries scanned%s)", hiddenConCommandIndexes.size(), hiddenConVarIndexes.size(), elapsed, scannedCount, isFullScan ? ", full scan" : "");
 }
 
 ISource2EngineToClient* GetEngine()
@@ -168,13 +134,6 @@ ISource2EngineToClient* GetEngine()
     return engineToClient;
 }
 
-void SendStatusOk() {
-    json msg;
-    msg["name"] = "status";
-    msg["payload"] = "ok";
-    ws->send(msg.dump());
-}
-
 void RestoreGameinfoFile() {
     std::ifstream filebackupFile(gameInfoBackupPath);
     if (!filebackupFile.good()) {
@@ -199,36 +158,6 @@ void RestoreGameinfoFile() {
     }
 }
 
-void LoadSequencesFile(string demoPath) {
-    sequences = {};
-
-    string demoJsonPath = demoPath + ".json";
-    if (FileExists(demoJsonPath)) {
-        std::ifstream jsonFile(demoJsonPath);
-        json jsonSequences = json::parse(jsonFile);
-        if (jsonSequences.size() == 0) {
-            Log("No sequences found in JSON file");
-            return;
-        }
-
-        for (auto jsonSequence : jsonSequences) {
-            Sequence sequence;
-            for (auto jsonAction : jsonSequence["actions"]) {
-                Action action;
-                action.tick = jsonAction["tick"];
-                action.cmd = jsonAction["cmd"];
-                sequence.actions.push_back(action);
-            }
-            sequences.push(sequence);
-        }
-
-        Log("JSON sequences file loaded: %s", demoJsonPath.c_str());
-    }
-    else {
-        Log("JSON sequences file not found at %s", demoJsonPath.c_str());
-    }
-}
-
 void PlaybackLoop() {
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
 
@@ -242,131 +171,13 @@ void PlaybackLoop() {
             continue;
         }
 
-        if (!initialized) {
-            // Since the 23/05/2024 CS2 update, the demo playback UI is displayed by default.
-			// We have to set the demo_ui_mode convar to 0 before starting the playback prevent the UI from being displayed.
-            engine->ExecuteClientCmd(0, "demo_ui_mode 0", true);
-            initialized = true;
-        }
-
-        bool newIsPlayingDemo = engine->IsPlayingDemo();
-        if (newIsPlayingDemo && !isPlayingDemo) {
-            Log("Demo playback started %d", currentTick);
-            currentTick = -1;
-
-            // Required to make the spec_lock_to_accountid command working since the 25/04/2024 update - it looks like the command has been hidden.
-            // Also required to use the startmovie command.
-            UnhideCommandsAndCvars();
-        }
-        else if (!newIsPlayingDemo && isPlayingDemo) {
-            Log("Demo playback stopped %d", currentTick);
-            currentTick = -1;
-        }
-
-        isPlayingDemo = newIsPlayingDemo;
-        if (!isPlayingDemo) {
-            continue;
-        }
-
-        auto demo = engine->GetDemoFile();
-        if (demo == NULL) {
-            continue;
-        }
-
-        int newTick = demo->GetDemoTick();
-        if (newTick != currentTick) {
-            // Log("Tick: %d", newTick);
-
-            Sequence currentSequence = sequences.front();
-            for (auto action : currentSequence.actions) {
-                if (action.tick == newTick) {
-                    if (action.cmd == "pause_playback") {
-                        Log("Pausing demo playback");
-                        engine->ExecuteClientCmd(0, "demo_pause", true);
-                        std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-                        Log("Resuming demo playback");
-                        engine->ExecuteClientCmd(0, "demo_resume", true);
-                    } else if (action.cmd == "go_to_next_sequence") {
-                        Log("Going to next sequence, remaining sequences: %d", sequences.size() - 1);
-                        sequences.pop();
-                        engine->ExecuteClientCmd(0, "demo_gototick 0", true);
-                        currentTick = -1;
-                    } else {
-                        Log("Executing: %s", action.cmd.c_str());
-                        engine->ExecuteClientCmd(0, action.cmd.c_str(), true);
-                    }
-                }
-            }
-        }
-
-        currentTick = newTick;
-    }
-}
-
-void HandleWebSocketMessage(const std::string& message)
-{
-    Log("Message received: %s", message.c_str());
-
-    json msg = json::parse(message.c_str());
-    if (!msg.contains("name")) {
-        return;
-    }
-
-    if (msg["name"] == "playdemo" && msg.contains("payload") && msg["payload"].is_string()) {
-        SendStatusOk();
-
-        string demoPath = msg["payload"];
-
-        LoadSequencesFile(demoPath);
-
-        string cmd = "playdemo \"" + demoPath + "\"";
-        Log("Starting demo: %s", cmd.c_str());
-        auto engine = GetEngine();
-        engine->ExecuteClientCmd(0, cmd.c_str(), true);
-    }
-}
-
-void ConnectToWebsocketServer() {
-    Log("Connecting to WebSocket server...");
-    ws = WebSocket::from_url("ws://localhost:4574?process=game");
-    if (ws == NULL)
-    {
-        Log("Failed to connect to WebSocket server.");
-        return;
-    }
-    
-    Log("Connected to WebSocket server.");
-    while (ws->getReadyState() != WebSocket::CLOSED && !isQuitting) {
-        ws->poll();
-        ws->dispatch(HandleWebSocketMessage);
-    }
-
-    Log("Disconnected from WebSocket server.");
-    delete ws;
-    ws = NULL;
-}
-
-void ConnectToWebsocketServerLoop() {
-    while (true) {
-        if (isQuitting) {
-            break;
-        }
-
-        if (ws != NULL) {
-            continue;
-        }
-
-        ConnectToWebsocketServer();
-
-        if (ws == NULL) {
-            Log("Retrying in 2s...");
-            std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-        }
+        PlaybackFrame(engine);
     }
 }
 
 bool Connect(IAppSystem* appSystem, CreateInterfaceFn factoryFn)
 {
+    TimelineMark("connect");
     factory = factoryFn;
     bool result = serverConfigConnect(appSystem, factory);
 
@@ -378,7 +189,9 @@ bool Connect(IAppSystem* appSystem, CreateInterfaceFn factoryFn)
     wsConnectionThread = new std::thread(ConnectToWebsocketServerLoop);
     demoPlaybackThread = new std::thread(PlaybackLoop);
 
+    TimelineBegin("restore_gameinfo_file");
     RestoreGameinfoFile();
+    TimelineEnd("restore_gameinfo_file");
 
     return result;
 }
@@ -396,9 +209,7 @@ void Shutdown()
         ConVar_Unregister();
     #endif
 
-    if (ws != NULL) {
-        ws->close();
-    }
+    CloseWebSocket();
 
     if (wsConnectionThread != NULL) {
         wsConnectionThread->join();
@@ -409,6 +220,49 @@ void Shutdown()
         demoPlaybackThread->join();
         demoPlaybackThread = NULL;
     }
+
+    CloseProgressJournal();
+    CloseTraceFile();
+    StopWatchingActionsFile();
+}
+
+void LoadInstanceConfig() {
+    instanceId = GetLaunchParameter("-csdm_instance", "CSDM_INSTANCE", "");
+    string defaultLogFilePath = "csdm.log";
+    if (!instanceId.empty()) {
+        defaultLogFilePath = "csdm_" + instanceId + ".log";
+        timelineFilePath = "csdm_startup_" + instanceId + ".json";
+    }
+
+    SetLogFilePath(GetLaunchParameter("-csdm_log", "CSDM_LOG", defaultLogFilePath));
+    wsUrl = BuildWebSocketUrl(GetLaunchParameter("-csdm_ws_url", "CSDM_WS_URL", DEFAULT_WS_URL), instanceId);
+    // Changes of the actions file are applied during the playback unless disabled with -csdm_hot_reload 0.
+    SetActionsWatcherEnabled(GetLaunchParameter("-csdm_hot_reload", "CSDM_HOT_RELOAD", "1") != "0");
+}
+
+void LoadWatchdogConfig() {
+    WatchdogConfig config;
+    config.stallTimeout = atof(GetLaunchParameter("-csdm_watchdog_timeout", "CSDM_WATCHDOG_TIMEOUT", std::to_string(config.stallTimeout)).c_str());
+    config.loadingTimeout = atof(GetLaunchParameter("-csdm_watchdog_loading_timeout", "CSDM_WATCHDOG_LOADING_TIMEOUT", std::to_string(config.loadingTimeout)).c_str());
+    string steps = GetLaunchParameter("-csdm_watchdog_steps", "CSDM_WATCHDOG_STEPS", "");
+    if (!steps.empty()) {
+        config.steps = ParseWatchdogSteps(steps);
+    }
+    SetWatchdogConfig(config);
+}
+
+void LoadTraceConfig() {
+    string traceFilePath = GetLaunchParameter("-csdm_trace", "CSDM_TRACE", "");
+    if (traceFilePath.empty()) {
+        return;
+    }
+
+    if (OpenTraceFile(traceFilePath, GetTime())) {
+        Log("Tracing playback to %s", traceFilePath.c_str());
+    }
+    else {
+        Log("Failed to open trace file %s", traceFilePath.c_str());
+    }
 }
 
 void AssertInsecureParameterIsPresent()
@@ -435,15 +289,25 @@ EXPORT void* CreateInterface(const char* pName, int* pReturnCode)
 {
     if (serverCreateInterface == NULL)
     {
+        TimelineMark("dll_load");
+        LoadInstanceConfig();
+        TimelineBegin("delete_log_file");
         DeleteLogFile();
+        TimelineEnd("delete_log_file");
+        LoadWatchdogConfig();
+        LoadTraceConfig();
+        TimelineBegin("assert_insecure_parameter");
         AssertInsecureParameterIsPresent();
+        TimelineEnd("assert_insecure_parameter");
 
         const char* gameDirectory = Plat_GetGameDirectory();
         gameInfoPath = string(gameDirectory) + "/csgo/gameinfo.gi";
         gameInfoBackupPath = string(gameDirectory) + "/csgo/gameinfo.gi.backup";
         string libPath = string(gameDirectory) + SERVER_LIB_PATH;
 
+        TimelineBegin("load_server_lib");
         void* serverModule = LoadLib(libPath.c_str());
+        TimelineEnd("load_server_lib");
         if (serverModule == NULL)
         {
             PluginError("Could not load server lib %s : %s", libPath.c_str(), GetLastErrorString());
@@ -459,6 +323,7 @@ EXPORT void* CreateInterface(const char* pName, int* pReturnCode)
     void* original = serverCreateInterface(pName, pReturnCode);
     if (strcmp(pName, "Source2ServerConfig001") == 0)
     {
+        TimelinePhase phase("patch_vtable");
         auto vtable = *(void***)original;
 
 #if defined _WIN32
@@ -503,7 +368,9 @@ EXPORT void* CreateInterface(const char* pName, int* pReturnCode)
             const char* param = CommandLine()->GetParm(i);
             if (strcmp(param, "+playdemo") == 0 && i + 1 < paramCount) {
                 demoPath = CommandLine()->GetParm(i + 1);
-                LoadSequencesFile(string(demoPath));
+                TimelineBegin("load_sequences_file");
+                LoadDemoJob(string(demoPath));
+                TimelineEnd("load_sequences_file");
                 break;
             }
         }
@@ -515,10 +382,13 @@ EXPORT void* CreateInterface(const char* pName, int* pReturnCode)
 #ifdef CON_COMMAND_ENABLED
 CON_COMMAND(csdm_info, "Prints CS:DM plugin info")
 {
+    if (!instanceId.empty()) {
+        Log("Instance: %s", instanceId.c_str());
+    }
     Log("Tick: %d", currentTick);
     Log("Is playing demo: %d", isPlayingDemo);
 
-    if (ws != NULL) {
+    if (IsWebSocketConnected()) {
         Log("WebSocket connected");
     }
     else {
@@ -526,5 +396,6 @@ CON_COMMAND(csdm_info, "Prints CS:DM plugin info")
     }
 
     Log("Sequence count: %d", sequences.size());
+    Log("Watchdog: %s", GetWatchdogStatsJson().dump().c_str());
 }
 #endif
\ No newline at end of file
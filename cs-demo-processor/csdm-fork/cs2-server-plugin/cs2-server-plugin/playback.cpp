@@ -0,0 +1,436 @@
+#include "playback.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include "timeline.h"
+#include "utils.h"
+#include "journal.h"
+#include "watchdog.h"
+#include "websocket.h"
+#include "session_trace.h"
+#include "job_timing.h"
+#include "demo_header.h"
+#include "actions_watcher.h"
+
+using nlohmann::json;
+using std::string;
+
+bool isPlayingDemo = false;
+int currentTick = -1;
+int currentSequenceIndex = 0;
+bool isRecordingJob = false;
+bool isQuitting = false;
+bool initialized = false;
+std::queue<Sequence> sequences;
+string timelineFilePath = "csdm_startup.json";
+// Time at which the playback paused by a pause_playback action has to be resumed, 0 when not paused.
+// The playback thread is not blocked during the pause.
+double pauseEndTime = 0;
+string pendingDemoPath;
+std::mutex pendingDemoPathMutex;
+// Demo of the loaded sequences, its actions file is watched for changes.
+string currentDemoPath;
+// Set when the sequences of a demo are loaded until its first tick, the watchdog detects a loading screen hanging.
+static bool isDemoLoading = false;
+
+static void ExecuteCommand(ISource2EngineToClient* engine, const string& cmd) {
+    TraceCommand(GetTime(), cmd);
+    engine->ExecuteClientCmd(0, cmd.c_str(), true);
+}
+
+void ReportStartupTimeline() {
+    json timeline = GetTimelineJson();
+    WriteTimelineFile(timelineFilePath);
+
+    json msg;
+    msg["name"] = "startup_timeline";
+    msg["payload"] = timeline;
+    QueueWebSocketMessage(msg);
+}
+
+// Writes the timing summary of the current job next to its actions file and sends it to the WebSocket server.
+static void ReportJobTiming() {
+    if (!IsJobTimingActive()) {
+        return;
+    }
+
+    JobTimingEnd(GetTime());
+    json timing = GetJobTimingJson();
+    string demoPath = timing["demoPath"];
+    WriteJobTimingFile(demoPath + ".timing.json");
+
+    json msg;
+    msg["name"] = "job_timing";
+    msg["payload"] = timing;
+    QueueWebSocketMessage(msg);
+}
+
+bool IsStartRecordingCommand(const string& cmd) {
+    return cmd.rfind("startmovie", 0) == 0 || cmd.rfind("mirv_streams record start", 0) == 0;
+}
+
+bool IsEndRecordingCommand(const string& cmd) {
+    return cmd == "endmovie" || cmd.rfind("mirv_streams record end", 0) == 0;
+}
+
+int ResolveActionTick(int anchorTick, double offsetMs, double tickInterval) {
+    long tick = anchorTick + lround(offsetMs / 1000 / tickInterval);
+
+    return (int)std::max(1L, tick);
+}
+
+// Returns false if an action is invalid, the sequences are then incomplete.
+static bool ParseSequences(const string& demoPath, const json& jsonSequences, std::queue<Sequence>& parsedSequences, bool& hasRecording) {
+    if (!jsonSequences.is_array()) {
+        return false;
+    }
+
+    // Only read from the demo when an action needs it.
+    double tickInterval = 0;
+    for (const auto& jsonSequence : jsonSequences) {
+        if (!jsonSequence.is_object() || !jsonSequence.contains("actions") || !jsonSequence["actions"].is_array()) {
+            return false;
+        }
+
+        Sequence sequence;
+        for (const auto& jsonAction : jsonSequence["actions"]) {
+            if (!jsonAction.is_object() || !jsonAction.contains("cmd") || !jsonAction["cmd"].is_string()) {
+                return false;
+            }
+
+            Action action;
+            if (jsonAction.contains("anchorTick") && jsonAction["anchorTick"].is_number()) {
+                if (tickInterval == 0) {
+                    tickInterval = GetDemoTickInterval(demoPath);
+                    Log("Demo tick interval: %.6fs", tickInterval);
+                }
+                double offsetMs = jsonAction.contains("offsetMs") && jsonAction["offsetMs"].is_number() ? jsonAction["offsetMs"].get<double>() : 0;
+                action.tick = ResolveActionTick(jsonAction["anchorTick"], offsetMs, tickInterval);
+            }
+            else if (jsonAction.contains("tick") && jsonAction["tick"].is_number()) {
+                action.tick = jsonAction["tick"];
+            }
+            else {
+                return false;
+            }
+            action.cmd = jsonAction["cmd"];
+            sequence.actions.push_back(action);
+            hasRecording = hasRecording || IsStartRecordingCommand(action.cmd);
+        }
+        parsedSequences.push(sequence);
+    }
+
+    return true;
+}
+
+void LoadSequencesFile(string demoPath) {
+    sequences = {};
+    currentSequenceIndex = 0;
+    isRecordingJob = false;
+    pauseEndTime = 0;
+    // The playdemo command follows, from the launch options or from a playdemo message.
+    isDemoLoading = true;
+    WatchdogReset(GetTime());
+    WatchdogSetSafeTick(0);
+
+    string demoJsonPath = demoPath + ".json";
+    currentDemoPath = demoPath;
+    WatchActionsFile(demoJsonPath, GetTime());
+    if (FileExists(demoJsonPath)) {
+        std::ifstream jsonFile(demoJsonPath);
+        string content((std::istreambuf_iterator<char>(jsonFile)), std::istreambuf_iterator<char>());
+        json jsonSequences = json::parse(content, nullptr, false);
+        if (jsonSequences.is_discarded()) {
+            Log("Invalid JSON sequences file %s, no actions will be executed", demoJsonPath.c_str());
+            CloseProgressJournal();
+            TraceDemoLoaded(GetTime(), demoPath, content, 0);
+            return;
+        }
+
+        if (jsonSequences.size() == 0) {
+            Log("No sequences found in JSON file");
+            TraceDemoLoaded(GetTime(), demoPath, content, 0);
+            return;
+        }
+
+        // A partial job would record the wrong sequences and its journal would have the wrong sequence count.
+        if (!ParseSequences(demoPath, jsonSequences, sequences, isRecordingJob)) {
+            Log("Invalid action found in JSON file %s, no actions will be executed", demoJsonPath.c_str());
+            sequences = {};
+            isRecordingJob = false;
+            CloseProgressJournal();
+            TraceDemoLoaded(GetTime(), demoPath, content, 0);
+            return;
+        }
+
+        Log("JSON sequences file loaded: %s", demoJsonPath.c_str());
+
+        // Only recordings are resumed, watching highlights/lowlights again should start from the beginning.
+        if (isRecordingJob) {
+            int completedCount = OpenProgressJournal(demoPath, demoJsonPath, sequences.size());
+            if (completedCount > 0) {
+                Log("Resuming recording, skipping %d already recorded sequence(s)", completedCount);
+                for (int i = 0; i < completedCount; i++) {
+                    sequences.pop();
+                }
+                currentSequenceIndex = completedCount;
+            }
+        }
+        else {
+            CloseProgressJournal();
+        }
+
+        TraceDemoLoaded(GetTime(), demoPath, content, currentSequenceIndex);
+    }
+    else {
+        Log("JSON sequences file not found at %s", demoJsonPath.c_str());
+        TraceDemoLoaded(GetTime(), demoPath, "", 0);
+    }
+}
+
+void ReloadSequencesFile() {
+    if (currentDemoPath.empty()) {
+        return;
+    }
+
+    string demoJsonPath = currentDemoPath + ".json";
+    std::ifstream jsonFile(demoJsonPath);
+    string content((std::istreambuf_iterator<char>(jsonFile)), std::istreambuf_iterator<char>());
+    json jsonSequences = json::parse(content, nullptr, false);
+    std::queue<Sequence> newSequences;
+    bool hasRecording = false;
+    if (jsonSequences.is_discarded() || !ParseSequences(currentDemoPath, jsonSequences, newSequences, hasRecording)) {
+        Log("Invalid JSON sequences file %s, keeping the current actions", demoJsonPath.c_str());
+        return;
+    }
+
+    // The journal of the previous actions file would be ignored by the next attempt, the completed sequences are kept.
+    isRecordingJob = hasRecording;
+    if (isRecordingJob) {
+        ReopenProgressJournal(currentDemoPath, demoJsonPath, newSequences.size(), currentSequenceIndex);
+    }
+    else {
+        CloseProgressJournal();
+    }
+
+    // The sequences already played are skipped, the current one restarts from the current tick with its new actions.
+    for (int i = 0; i < currentSequenceIndex && !newSequences.empty(); i++) {
+        newSequences.pop();
+    }
+    sequences.swap(newSequences);
+    Log("JSON sequences file reloaded: %s, remaining sequences: %d", demoJsonPath.c_str(), sequences.size());
+    TraceActionsReloaded(GetTime(), content);
+}
+
+void LoadDemoJob(const string& demoPath) {
+    // The previous job has been interrupted by a new playdemo message.
+    ReportJobTiming();
+    LoadSequencesFile(demoPath);
+    JobTimingBegin(demoPath, currentSequenceIndex, GetTime());
+}
+
+void RequestDemoPlayback(const string& demoPath) {
+    std::lock_guard<std::mutex> lock(pendingDemoPathMutex);
+    pendingDemoPath = demoPath;
+}
+
+static void StartPendingDemoPlayback(ISource2EngineToClient* engine) {
+    string demoPath;
+    {
+        std::lock_guard<std::mutex> lock(pendingDemoPathMutex);
+        if (pendingDemoPath.empty()) {
+            return;
+        }
+        demoPath.swap(pendingDemoPath);
+    }
+
+    LoadDemoJob(demoPath);
+
+    string cmd = "playdemo \"" + demoPath + "\"";
+    Log("Starting demo: %s", cmd.c_str());
+    ExecuteCommand(engine, cmd);
+}
+
+static void ExecuteWatchdogStep(ISource2EngineToClient* engine, WatchdogStep step, int tick) {
+    Log("Watchdog: executing step %s", GetWatchdogStepName(step));
+    switch (step) {
+    case WATCHDOG_STEP_RESUME:
+        ExecuteCommand(engine, "demo_resume");
+        break;
+    case WATCHDOG_STEP_RESEEK: {
+        string cmd = "demo_gototick " + std::to_string(std::max(GetWatchdogSafeTick(), 0));
+        ExecuteCommand(engine, cmd);
+        break;
+    }
+    case WATCHDOG_STEP_REPORT: {
+        json payload;
+        payload["tick"] = tick;
+        payload["stalledSeconds"] = GetWatchdogStalledSeconds(GetTime());
+        payload["sequenceIndex"] = currentSequenceIndex;
+        payload["stats"] = GetWatchdogStatsJson();
+        json msg;
+        msg["name"] = "playback_stalled";
+        msg["payload"] = payload;
+        QueueWebSocketMessage(msg);
+        break;
+    }
+    case WATCHDOG_STEP_QUIT:
+        // The progress journal is kept so the next attempt resumes from the current sequence.
+        ExecuteCommand(engine, "quit");
+        break;
+    default:
+        break;
+    }
+}
+
+// The tick progress isn't known until the demo is loaded, only the loading timeout applies.
+static void UpdateLoadingWatchdog(ISource2EngineToClient* engine) {
+    if (!isDemoLoading || !isRecordingJob) {
+        return;
+    }
+
+    WatchdogStep step = WatchdogUpdate(-1, GetTime());
+    if (step != WATCHDOG_STEP_NONE) {
+        ExecuteWatchdogStep(engine, step, -1);
+    }
+}
+
+void PlaybackFrame(ISource2EngineToClient* engine) {
+    if (!initialized) {
+        // Since the 23/05/2024 CS2 update, the demo playback UI is displayed by default.
+        // We have to set the demo_ui_mode convar to 0 before starting the playback prevent the UI from being displayed.
+        TimelineBegin("demo_ui_mode");
+        ExecuteCommand(engine, "demo_ui_mode 0");
+        TimelineEnd("demo_ui_mode");
+        initialized = true;
+    }
+
+    StartPendingDemoPlayback(engine);
+
+    bool newIsPlayingDemo = engine->IsPlayingDemo();
+    if (newIsPlayingDemo && !isPlayingDemo) {
+        Log("Demo playback started %d", currentTick);
+        currentTick = -1;
+        pauseEndTime = 0;
+        TimelineMark("playback_started");
+        WatchdogReset(GetTime());
+        JobTimingEnterPhase(JOB_PHASE_SETUP_SEEK, 0, GetTime());
+
+        // Required to make the spec_lock_to_accountid command working since the 25/04/2024 update - it looks like the command has been hidden.
+        // Also required to use the startmovie command.
+        TimelineBegin("unhide_commands_and_cvars");
+        UnhideCommandsAndCvars();
+        TimelineEnd("unhide_commands_and_cvars");
+    }
+    else if (!newIsPlayingDemo && isPlayingDemo) {
+        Log("Demo playback stopped %d", currentTick);
+        ReportJobTiming();
+        currentTick = -1;
+    }
+
+    isPlayingDemo = newIsPlayingDemo;
+    if (!isPlayingDemo) {
+        TraceSample(GetTime(), -1, false, false);
+        UpdateLoadingWatchdog(engine);
+        return;
+    }
+
+    auto demo = engine->GetDemoFile();
+    if (demo != NULL && IsTracing()) {
+        TraceSample(GetTime(), demo->GetDemoTick(), true, demo->IsDemoPaused());
+    }
+
+    if (pauseEndTime > 0) {
+        if (GetTime() < pauseEndTime) {
+            return;
+        }
+
+        Log("Resuming demo playback");
+        ExecuteCommand(engine, "demo_resume");
+        pauseEndTime = 0;
+        WatchdogReset(GetTime());
+        JobTimingEnterPhase(JOB_PHASE_PRE_ROLL, currentTick, GetTime());
+    }
+
+    if (demo == NULL) {
+        UpdateLoadingWatchdog(engine);
+        return;
+    }
+
+    isDemoLoading = false;
+    int newTick = demo->GetDemoTick();
+    if (!TimelineHas("first_demo_tick")) {
+        TimelineMark("first_demo_tick");
+        ReportStartupTimeline();
+    }
+
+    if (isRecordingJob) {
+        WatchdogStep step = WatchdogUpdate(newTick, GetTime());
+        if (step != WATCHDOG_STEP_NONE) {
+            ExecuteWatchdogStep(engine, step, newTick);
+        }
+    }
+
+    // Between 2 ticks and outside of a pause, the swap doesn't interrupt a pause_playback or go_to_next_sequence action.
+    if (HasActionsFileChanged(GetTime())) {
+        ReloadSequencesFile();
+    }
+
+    if (newTick != currentTick && !sequences.empty()) {
+        // Log("Tick: %d", newTick);
+
+        // Actions are copied because go_to_next_sequence pops the sequence they belong to.
+        std::vector<Action> actions = sequences.front().actions;
+        for (const auto& action : actions) {
+            if (action.tick != newTick) {
+                continue;
+            }
+
+            if (action.cmd == "pause_playback") {
+                Log("Pausing demo playback");
+                ExecuteCommand(engine, "demo_pause");
+                pauseEndTime = GetTime() + PAUSE_PLAYBACK_DURATION;
+                JobTimingEnterPhase(JOB_PHASE_PAUSE, newTick, GetTime());
+            } else if (action.cmd == "go_to_next_sequence") {
+                Log("Going to next sequence, remaining sequences: %d", sequences.size() - 1);
+                JournalSequenceCompleted(currentSequenceIndex);
+                currentSequenceIndex++;
+                sequences.pop();
+                ExecuteCommand(engine, "demo_gototick 0");
+                currentTick = -1;
+                WatchdogReset(GetTime());
+                WatchdogSetSafeTick(0);
+                JobTimingNextSequence(currentSequenceIndex, newTick, GetTime());
+            } else {
+                if (action.cmd == "quit") {
+                    JournalSequenceCompleted(currentSequenceIndex);
+                    ReportJobTiming();
+                }
+
+                Log("Executing: %s", action.cmd.c_str());
+                ExecuteCommand(engine, action.cmd);
+                if (action.cmd.rfind("demo_gototick ", 0) == 0) {
+                    WatchdogSetSafeTick(atoi(action.cmd.c_str() + strlen("demo_gototick ")));
+                }
+                if (IsStartRecordingCommand(action.cmd)) {
+                    JournalRecordingStarted(currentSequenceIndex, action.cmd);
+                    JobTimingEnterPhase(JOB_PHASE_RECORDING, newTick, GetTime());
+                    if (!TimelineHas("first_startmovie")) {
+                        TimelineMark("first_startmovie");
+                        ReportStartupTimeline();
+                    }
+                }
+                else if (IsEndRecordingCommand(action.cmd)) {
+                    JournalRecordingEnded(currentSequenceIndex, newTick);
+                    JobTimingEnterPhase(JOB_PHASE_POST_ROLL, newTick, GetTime());
+                }
+            }
+        }
+    }
+
+    currentTick = newTick;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <queue>
+#include "cdll_interfaces.h"
+
+// Demo playback core: sequences loading and actions dispatch.
+// It only talks to the game through ISource2EngineToClient and IDemoFile, so it can be linked either in the plugin or
+// in the mock engine harness (see harness/).
+
+struct Action {
+    int tick;
+    std::string cmd;
+};
+
+struct Sequence {
+    std::vector<Action> actions;
+};
+
+// Duration of the pause executed by the pause_playback action.
+#define PAUSE_PLAYBACK_DURATION 2.0
+
+extern bool isPlayingDemo;
+extern int currentTick;
+// Index of the current sequence in the JSON file.
+extern int currentSequenceIndex;
+// True when the actions file records videos, the playback is then monitored by the watchdog.
+extern bool isRecordingJob;
+extern bool isQuitting;
+extern std::queue<Sequence> sequences;
+extern std::string timelineFilePath;
+
+// Implemented by the host, i.e. the plugin or the harness.
+void UnhideCommandsAndCvars();
+
+bool IsStartRecordingCommand(const std::string& cmd);
+bool IsEndRecordingCommand(const std::string& cmd);
+// Actions are located either with a "tick" or with an "anchorTick" and an "offsetMs" time offset relative to it, so that
+// margins expressed in milliseconds translate to the same wall-clock duration whatever the tick rate of the demo is.
+// Offsets are converted to ticks with the tick interval of the demo, the resulting tick is at least 1.
+int ResolveActionTick(int anchorTick, double offsetMs, double tickInterval);
+// Loads the sequences from the <demo>.json file.
+void LoadSequencesFile(std::string demoPath);
+// Replaces the sequences with the ones of the actions file of the current demo, e.g. when it has been modified during
+// the playback. The position in the sequences is kept and the current actions are kept if the file is invalid.
+void ReloadSequencesFile();
+// Loads the sequences of a demo and starts the timing of its job, right before the demo is played from a playdemo
+// message or with the +playdemo launch option.
+void LoadDemoJob(const std::string& demoPath);
+// Requests the playback of a demo from another thread, e.g. the WebSocket one. The sequences are loaded and the demo is
+// started by the playback thread on its next iteration, a newer request replaces a pending one.
+void RequestDemoPlayback(const std::string& demoPath);
+// Writes the startup timeline to a file and sends it to the WebSocket server.
+void ReportStartupTimeline();
+// Executes one iteration of the playback loop: detects playback start/stop, runs the watchdog and executes the actions
+// of the current tick.
+void PlaybackFrame(ISource2EngineToClient* engine);
@@ -0,0 +1,212 @@
+#include "session_trace.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using std::string;
+
+#define TRACE_MAGIC "CSDMTRC1"
+#define TRACE_BUFFER_SIZE (64 * 1024)
+// The trace is flushed at least every second so that a crash loses little.
+#define TRACE_FLUSH_INTERVAL 1.0
+
+static FILE* traceFile = NULL;
+static double lastRecordTime = 0;
+static double lastFlushTime = 0;
+static int lastTick = 0;
+static uint8_t lastFlags = 0xff;
+
+static void Write(const void* data, size_t size)
+{
+    fwrite(data, 1, size, traceFile);
+}
+
+static void WriteRecordHeader(TraceRecordType type, double now)
+{
+    double delay = (now - lastRecordTime) * 1e6;
+    uint32_t delayUs = delay <= 0 ? 0 : delay >= UINT32_MAX ? UINT32_MAX : (uint32_t)delay;
+    // Accumulate the truncated delays to not drift.
+    lastRecordTime += delayUs / 1e6;
+    Write(&type, 1);
+    Write(&delayUs, 4);
+}
+
+static void FlushIfNeeded(double now)
+{
+    if (now - lastFlushTime >= TRACE_FLUSH_INTERVAL) {
+        fflush(traceFile);
+        lastFlushTime = now;
+    }
+}
+
+bool OpenTraceFile(const string& path, double now)
+{
+    CloseTraceFile();
+
+    traceFile = fopen(path.c_str(), "wb");
+    if (traceFile == NULL) {
+        return false;
+    }
+
+    setvbuf(traceFile, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    Write(TRACE_MAGIC, 8);
+    lastRecordTime = now;
+    lastFlushTime = now;
+    lastFlags = 0xff;
+
+    return true;
+}
+
+void CloseTraceFile()
+{
+    if (traceFile != NULL) {
+        fclose(traceFile);
+        traceFile = NULL;
+    }
+}
+
+bool IsTracing()
+{
+    return traceFile != NULL;
+}
+
+void TraceSample(double now, int tick, bool isPlaying, bool isPaused)
+{
+    if (traceFile == NULL) {
+        return;
+    }
+
+    uint8_t flags = (isPlaying ? 1 : 0) | (isPaused ? 2 : 0);
+    if (flags == lastFlags && tick == lastTick) {
+        return;
+    }
+
+    lastFlags = flags;
+    lastTick = tick;
+    int32_t value = tick;
+    WriteRecordHeader(TRACE_RECORD_SAMPLE, now);
+    Write(&value, 4);
+    Write(&flags, 1);
+    FlushIfNeeded(now);
+}
+
+void TraceCommand(double now, const string& cmd)
+{
+    if (traceFile == NULL) {
+        return;
+    }
+
+    uint16_t length = cmd.size() > UINT16_MAX ? UINT16_MAX : (uint16_t)cmd.size();
+    WriteRecordHeader(TRACE_RECORD_COMMAND, now);
+    Write(&length, 2);
+    Write(cmd.data(), length);
+    FlushIfNeeded(now);
+}
+
+void TraceDemoLoaded(double now, const string& demoPath, const string& actions, int skippedSequenceCount)
+{
+    if (traceFile == NULL) {
+        return;
+    }
+
+    uint16_t pathLength = demoPath.size() > UINT16_MAX ? UINT16_MAX : (uint16_t)demoPath.size();
+    uint32_t actionsLength = actions.size();
+    uint16_t skippedCount = skippedSequenceCount;
+    WriteRecordHeader(TRACE_RECORD_DEMO, now);
+    Write(&pathLength, 2);
+    Write(demoPath.data(), pathLength);
+    Write(&actionsLength, 4);
+    Write(actions.data(), actionsLength);
+    Write(&skippedCount, 2);
+    fflush(traceFile);
+    lastFlushTime = now;
+}
+
+void TraceActionsReloaded(double now, const string& actions)
+{
+    if (traceFile == NULL) {
+        return;
+    }
+
+    uint32_t actionsLength = actions.size();
+    WriteRecordHeader(TRACE_RECORD_RELOAD, now);
+    Write(&actionsLength, 4);
+    Write(actions.data(), actionsLength);
+    fflush(traceFile);
+    lastFlushTime = now;
+}
+
+bool ReadTraceFile(const string& path, std::vector<TraceRecord>& records)
+{
+    std::ifstream file(path, std::ios::binary);
+    string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 8 || data.compare(0, 8, TRACE_MAGIC) != 0) {
+        return false;
+    }
+
+    size_t offset = 8;
+    double time = 0;
+    auto read = [&](void* value, size_t size) {
+        if (offset + size > data.size()) {
+            return false;
+        }
+        memcpy(value, &data[offset], size);
+        offset += size;
+        return true;
+    };
+    auto readString = [&](string& value, size_t size) {
+        if (offset + size > data.size()) {
+            return false;
+        }
+        value.assign(data, offset, size);
+        offset += size;
+        return true;
+    };
+
+    // A truncated last record is ignored, e.g. when the game crashed.
+    while (offset < data.size()) {
+        TraceRecord record = {};
+        uint32_t delayUs;
+        if (!read(&record.type, 1) || !read(&delayUs, 4)) {
+            break;
+        }
+        time += delayUs / 1e6;
+        record.time = time;
+
+        bool isComplete = false;
+        if (record.type == TRACE_RECORD_SAMPLE) {
+            int32_t tick;
+            uint8_t flags;
+            isComplete = read(&tick, 4) && read(&flags, 1);
+            record.tick = tick;
+            record.isPlaying = (flags & 1) != 0;
+            record.isPaused = (flags & 2) != 0;
+        }
+        else if (record.type == TRACE_RECORD_COMMAND) {
+            uint16_t length;
+            isComplete = read(&length, 2) && readString(record.text, length);
+        }
+        else if (record.type == TRACE_RECORD_DEMO) {
+            uint16_t pathLength;
+            uint32_t actionsLength;
+            uint16_t skippedCount = 0;
+            isComplete = read(&pathLength, 2) && readString(record.text, pathLength) && read(&actionsLength, 4)
+                && readString(record.actions, actionsLength) && read(&skippedCount, 2);
+            record.skippedSequenceCount = skippedCount;
+        }
+        else if (record.type == TRACE_RECORD_RELOAD) {
+            uint32_t actionsLength;
+            isComplete = read(&actionsLength, 4) && readString(record.actions, actionsLength);
+        }
+        else {
+            return false;
+        }
+
+        if (!isComplete) {
+            break;
+        }
+        records.push_back(record);
+    }
+
+    return true;
+}
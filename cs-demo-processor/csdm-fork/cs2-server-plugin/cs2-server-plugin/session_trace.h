@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Compact binary trace of a playback session, enabled with the -csdm_trace <path> launch parameter.
+// It records the playback state observed by the playback loop and the commands executed by the plugin so that the
+// session can be replayed through the dispatcher with the mock engine (harness/replay.cpp).
+//
+// Format: the "CSDMTRC1" magic followed by records, each one starts with a u8 type and a u32 delay in microseconds
+// since the previous record.
+// - sample: i32 tick, u8 flags (1 = playing, 2 = paused). Only written when the tick or a flag changed.
+// - command: u16 length, command.
+// - demo: u16 length, demo path, u32 length, actions file content, u16 number of sequences skipped by the progress
+//   journal.
+// - reload: u32 length, actions file content, when the actions file is reloaded during the playback.
+
+enum TraceRecordType : uint8_t {
+    TRACE_RECORD_SAMPLE = 1,
+    TRACE_RECORD_COMMAND = 2,
+    TRACE_RECORD_DEMO = 3,
+    TRACE_RECORD_RELOAD = 4,
+};
+
+struct TraceRecord {
+    TraceRecordType type;
+    // Seconds since the trace start.
+    double time;
+    int tick;
+    bool isPlaying;
+    bool isPaused;
+    // Command or demo path.
+    std::string text;
+    // Actions file content of demo and reload records.
+    std::string actions;
+    int skippedSequenceCount;
+};
+
+bool OpenTraceFile(const std::string& path, double now);
+void CloseTraceFile();
+bool IsTracing();
+void TraceSample(double now, int tick, bool isPlaying, bool isPaused);
+void TraceCommand(double now, const std::string& cmd);
+void TraceDemoLoaded(double now, const std::string& demoPath, const std::string& actions, int skippedSequenceCount);
+void TraceActionsReloaded(double now, const std::string& actions);
+bool ReadTraceFile(const std::string& path, std::vector<TraceRecord>& records);
@@ -0,0 +1,112 @@
+#include "timeline.h"
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+using nlohmann::json;
+using std::string;
+
+struct TimelineEntry {
+    string phase;
+    double start;
+    double end;
+};
+
+// Phases are recorded from the game main thread, the WebSocket thread and the playback thread.
+static std::mutex timelineMutex;
+static std::vector<TimelineEntry> timelineEntries;
+static std::chrono::steady_clock::time_point timelineOrigin;
+static bool isTimelineStarted = false;
+
+static double GetTimelineNow()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!isTimelineStarted) {
+        timelineOrigin = now;
+        isTimelineStarted = true;
+    }
+
+    return std::chrono::duration<double, std::milli>(now - timelineOrigin).count();
+}
+
+static TimelineEntry* FindTimelineEntry(const char* phase)
+{
+    for (auto& entry : timelineEntries) {
+        if (entry.phase == phase) {
+            return &entry;
+        }
+    }
+
+    return NULL;
+}
+
+void TimelineBegin(const char* phase)
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+    double now = GetTimelineNow();
+    if (FindTimelineEntry(phase) != NULL) {
+        return;
+    }
+
+    timelineEntries.push_back({ phase, now, -1 });
+}
+
+void TimelineEnd(const char* phase)
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+    double now = GetTimelineNow();
+    TimelineEntry* entry = FindTimelineEntry(phase);
+    if (entry != NULL && entry->end < 0) {
+        entry->end = now;
+    }
+}
+
+void TimelineMark(const char* phase)
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+    double now = GetTimelineNow();
+    if (FindTimelineEntry(phase) != NULL) {
+        return;
+    }
+
+    timelineEntries.push_back({ phase, now, now });
+}
+
+bool TimelineHas(const char* phase)
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+
+    return FindTimelineEntry(phase) != NULL;
+}
+
+json GetTimelineJson()
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+    json phases = json::array();
+    for (auto& entry : timelineEntries) {
+        json phase;
+        phase["name"] = entry.phase;
+        phase["startMs"] = entry.start;
+        if (entry.end >= 0) {
+            phase["endMs"] = entry.end;
+            phase["durationMs"] = entry.end - entry.start;
+        }
+        phases.push_back(phase);
+    }
+
+    json timeline;
+    timeline["phases"] = phases;
+
+    return timeline;
+}
+
+void WriteTimelineFile(const string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.good()) {
+        return;
+    }
+
+    file << GetTimelineJson().dump(2);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <nlohmann/json.hpp>
+
+// Records monotonic timestamps of the plugin startup phases, from the DLL load to the first recorded frame.
+// Timestamps are in milliseconds relative to the first call of TimelineBegin/TimelineMark.
+// Only the first occurrence of a phase is kept, e.g. loading the sequences file again when a new demo is played from
+// the WebSocket server doesn't override the startup value.
+
+void TimelineBegin(const char* phase);
+void TimelineEnd(const char* phase);
+// Records an instant event, i.e. a phase that starts and ends at the same time.
+void TimelineMark(const char* phase);
+bool TimelineHas(const char* phase);
+nlohmann::json GetTimelineJson();
+void WriteTimelineFile(const std::string& path);
+
+// Records the phase duration for the lifetime of the object.
+class TimelinePhase
+{
+public:
+    TimelinePhase(const char* phase) : phase(phase) { TimelineBegin(phase); }
+    ~TimelinePhase() { TimelineEnd(phase); }
+
+private:
+    const char* phase;
+};
@@ -0,0 +1,120 @@
+#include "utils.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <icommandline.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using std::string;
+
+string logFilePath = "csdm.log";
+
+void SetLogFilePath(const string& path)
+{
+    logFilePath = path;
+}
+
+void LogToFile(const char* pMsg) {
+    FILE* pFile = fopen(logFilePath.c_str(), "a");
+    if (pFile == NULL)
+    {
+        return;
+    }
+
+    fprintf(pFile, "%s\n", pMsg);
+    fclose(pFile);
+}
+
+void DeleteLogFile()
+{
+    remove(logFilePath.c_str());
+}
+
+void Log(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	char buf[1024] = {};
+	vsnprintf(buf, sizeof(buf), msg, args);
+	ConColorMsg(Color(227, 0, 255, 255), "CSDM: %s\n", buf);
+	va_end(args);
+    LogToFile(buf);
+}
+
+void PluginError(const char* msg, ...)
+{
+    va_list args;
+    va_start(args, msg);
+    char buf[1024] = {};
+    vsnprintf(buf, sizeof(buf), msg, args);
+    va_end(args);
+
+    // Since the "Armory" update, calling Plat_FatalErrorFunc crashes the game on Windows.
+    #ifdef _WIN32
+        Plat_MessageBox("Error", buf);
+        Plat_ExitProcess(1);
+    #else
+        Plat_FatalErrorFunc("%s", buf);
+    #endif
+}
+
+bool FileExists(const std::string& name) {
+    std::ifstream f(name.c_str());
+
+    return f.good();
+}
+
+double GetTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+string GetLaunchParameter(const char* name, const char* envName, const string& defaultValue)
+{
+    // Since the "Armory" update, calling CommandLine()->HasParm() crashes the game when the parameter is not present.
+    int paramCount = CommandLine()->ParmCount();
+    for (int i = 0; i < paramCount - 1; i++) {
+        if (strcmp(CommandLine()->GetParm(i), name) == 0) {
+            return string(CommandLine()->GetParm(i + 1));
+        }
+    }
+
+    const char* envValue = getenv(envName);
+    if (envValue != NULL && envValue[0] != '\0') {
+        return string(envValue);
+    }
+
+    return defaultValue;
+}
+
+void* GetLibAddress(void* lib, const char* name) {
+#if defined _WIN32
+	return GetProcAddress((HMODULE)lib, name);
+#else
+	return dlsym(lib, name);
+#endif
+}
+
+char* GetLastErrorString() {
+#ifdef _WIN32
+    DWORD error = GetLastError();
+    static char s[_MAX_U64TOSTR_BASE2_COUNT];
+    sprintf(s, "%lu", error);
+
+	return s;
+#else
+	return dlerror();
+#endif
+}
+
+void* LoadLib(const char* path) {
+#ifdef _WIN32
+    return LoadLibrary(path);
+#else
+	return dlopen(path, RTLD_NOW);
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <dbg.h>
+
+void Log(const char* msg, ...);
+void PluginError(const char* msg, ...);
+void SetLogFilePath(const std::string& path);
+void DeleteLogFile();
+bool FileExists(const std::string& name);
+// Monotonic time in seconds.
+double GetTime();
+// Returns the value of a launch parameter such as "-csdm_instance 2", or the value of the environment variable if the
+// parameter is not present, or the default value.
+std::string GetLaunchParameter(const char* name, const char* envName, const std::string& defaultValue);
+void* GetLibAddress(void* lib, const char* name);
+char* GetLastErrorString();
+void* LoadLib(const char* path);
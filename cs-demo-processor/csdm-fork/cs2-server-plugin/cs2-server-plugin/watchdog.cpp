@@ -0,0 +1,200 @@
+#include "watchdog.h"
+#include <algorithm>
+#include <sstream>
+#include "utils.h"
+
+using nlohmann::json;
+using std::string;
+
+// Number of average tick durations without progress before considering that the playback is stalled when the
+// playback is slower than the stall timeout, e.g. when recording with a high host_framerate.
+#define WATCHDOG_SLOW_PLAYBACK_FACTOR 20
+// Seconds a tick has to be followed by tick progress before it is used as the reseek target. The tick at which the
+// playback froze, or the ticks just before it, would most likely freeze again.
+#define WATCHDOG_SAFE_TICK_MARGIN 2
+
+static WatchdogConfig watchdogConfig;
+static int lastTick = -1;
+static int safeTick = -1;
+// Tick that becomes the safe tick once the playback advanced WATCHDOG_SAFE_TICK_MARGIN seconds past it.
+static int pendingSafeTick = -1;
+static double pendingSafeTickTime = 0;
+static bool hasTickAdvanced = false;
+static double lastProgressTime = 0;
+static double nextStepTime = 0;
+// Exponential moving average of the wall-clock seconds between 2 tick changes.
+static double averageTickDuration = 0;
+static size_t nextStepIndex = 0;
+static bool isStalled = false;
+
+static int stallCount = 0;
+static int recoveredCount = 0;
+static int exhaustedCount = 0;
+static std::vector<int> stepCounts(WATCHDOG_STEP_QUIT + 1, 0);
+
+std::vector<WatchdogStep> ParseWatchdogSteps(const string& value)
+{
+    std::vector<WatchdogStep> steps;
+    std::istringstream stream(value);
+    string name;
+    while (std::getline(stream, name, ',')) {
+        if (name == "resume") {
+            steps.push_back(WATCHDOG_STEP_RESUME);
+        }
+        else if (name == "reseek") {
+            steps.push_back(WATCHDOG_STEP_RESEEK);
+        }
+        else if (name == "report") {
+            steps.push_back(WATCHDOG_STEP_REPORT);
+        }
+        else if (name == "quit") {
+            steps.push_back(WATCHDOG_STEP_QUIT);
+        }
+        else if (name != "none") {
+            Log("Unknown watchdog step: %s", name.c_str());
+        }
+    }
+
+    return steps;
+}
+
+const char* GetWatchdogStepName(WatchdogStep step)
+{
+    switch (step) {
+    case WATCHDOG_STEP_RESUME:
+        return "resume";
+    case WATCHDOG_STEP_RESEEK:
+        return "reseek";
+    case WATCHDOG_STEP_REPORT:
+        return "report";
+    case WATCHDOG_STEP_QUIT:
+        return "quit";
+    default:
+        return "none";
+    }
+}
+
+void SetWatchdogConfig(const WatchdogConfig& config)
+{
+    watchdogConfig = config;
+}
+
+static double GetStallTimeout()
+{
+    if (!hasTickAdvanced) {
+        return watchdogConfig.loadingTimeout;
+    }
+
+    return std::max(watchdogConfig.stallTimeout, averageTickDuration * WATCHDOG_SLOW_PLAYBACK_FACTOR);
+}
+
+void WatchdogReset(double now)
+{
+    if (isStalled) {
+        Log("Watchdog reset while the playback was stalled");
+        isStalled = false;
+    }
+
+    lastTick = -1;
+    pendingSafeTick = -1;
+    hasTickAdvanced = false;
+    lastProgressTime = now;
+    nextStepIndex = 0;
+    nextStepTime = now + GetStallTimeout();
+}
+
+WatchdogStep WatchdogUpdate(int tick, double now)
+{
+    if (tick != lastTick) {
+        if (lastTick != -1) {
+            double tickDuration = now - lastProgressTime;
+            averageTickDuration = hasTickAdvanced ? averageTickDuration * 0.9 + tickDuration * 0.1 : tickDuration;
+            hasTickAdvanced = true;
+        }
+
+        if (isStalled) {
+            recoveredCount++;
+            const char* stepName = nextStepIndex > 0 ? GetWatchdogStepName(watchdogConfig.steps[nextStepIndex - 1]) : "none";
+            Log("Watchdog: playback recovered at tick %d after step %s", tick, stepName);
+            isStalled = false;
+        }
+
+        if (pendingSafeTick == -1) {
+            pendingSafeTick = tick;
+            pendingSafeTickTime = now;
+        }
+        else if (now - pendingSafeTickTime >= WATCHDOG_SAFE_TICK_MARGIN) {
+            safeTick = pendingSafeTick;
+            pendingSafeTick = tick;
+            pendingSafeTickTime = now;
+        }
+
+        lastTick = tick;
+        lastProgressTime = now;
+        nextStepIndex = 0;
+        nextStepTime = now + GetStallTimeout();
+
+        return WATCHDOG_STEP_NONE;
+    }
+
+    if (now < nextStepTime || watchdogConfig.steps.empty()) {
+        return WATCHDOG_STEP_NONE;
+    }
+
+    if (!isStalled) {
+        isStalled = true;
+        stallCount++;
+        Log("Watchdog: playback stalled at tick %d for %.1fs", tick, now - lastProgressTime);
+    }
+
+    // Resuming or seeking does nothing while the demo is loading, the next step is reached without waiting.
+    while (tick == -1 && nextStepIndex < watchdogConfig.steps.size()
+        && (watchdogConfig.steps[nextStepIndex] == WATCHDOG_STEP_RESUME || watchdogConfig.steps[nextStepIndex] == WATCHDOG_STEP_RESEEK)) {
+        nextStepIndex++;
+    }
+
+    if (nextStepIndex >= watchdogConfig.steps.size()) {
+        return WATCHDOG_STEP_NONE;
+    }
+
+    WatchdogStep step = watchdogConfig.steps[nextStepIndex++];
+    stepCounts[step]++;
+    nextStepTime = now + GetStallTimeout();
+    if (nextStepIndex == watchdogConfig.steps.size()) {
+        exhaustedCount++;
+    }
+
+    return step;
+}
+
+void WatchdogSetSafeTick(int tick)
+{
+    safeTick = tick;
+    pendingSafeTick = -1;
+}
+
+int GetWatchdogSafeTick()
+{
+    return safeTick;
+}
+
+double GetWatchdogStalledSeconds(double now)
+{
+    return now - lastProgressTime;
+}
+
+json GetWatchdogStatsJson()
+{
+    json stats;
+    stats["stalls"] = stallCount;
+    stats["recovered"] = recoveredCount;
+    // Number of stalls for which all the steps have been executed.
+    stats["exhausted"] = exhaustedCount;
+    json steps;
+    for (int step = WATCHDOG_STEP_RESUME; step <= WATCHDOG_STEP_QUIT; step++) {
+        steps[GetWatchdogStepName((WatchdogStep)step)] = stepCounts[step];
+    }
+    stats["steps"] = steps;
+
+    return stats;
+}
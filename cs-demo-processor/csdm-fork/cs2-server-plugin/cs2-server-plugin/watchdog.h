@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Detects when the demo playback doesn't advance anymore (loading screen hanging, demo paused and never resumed, frozen
+// tick...) and escalates through recovery steps, one step each time the stall timeout elapses without tick progress.
+
+enum WatchdogStep {
+    WATCHDOG_STEP_NONE,
+    // demo_resume
+    WATCHDOG_STEP_RESUME,
+    // demo_gototick to a tick reached a few seconds before the playback stalled
+    WATCHDOG_STEP_RESEEK,
+    // Send a playback_stalled message to the WebSocket server
+    WATCHDOG_STEP_REPORT,
+    // Close the game so that the recording pipeline doesn't wait for its own timeout
+    WATCHDOG_STEP_QUIT,
+};
+
+struct WatchdogConfig {
+    // Seconds without tick progress before the first step, the timeout increases if the playback is slower than that.
+    double stallTimeout = 5;
+    // Seconds without tick progress before the first step when the playback didn't reach its first tick yet (loading).
+    double loadingTimeout = 60;
+    std::vector<WatchdogStep> steps = { WATCHDOG_STEP_RESUME, WATCHDOG_STEP_RESEEK, WATCHDOG_STEP_REPORT, WATCHDOG_STEP_QUIT };
+};
+
+// Parses a comma separated list of steps such as "resume,reseek,report,quit", "none" disables the watchdog.
+std::vector<WatchdogStep> ParseWatchdogSteps(const std::string& value);
+const char* GetWatchdogStepName(WatchdogStep step);
+void SetWatchdogConfig(const WatchdogConfig& config);
+// Resets the stall detection, e.g. when the playback starts or after an intentional pause.
+void WatchdogReset(double now);
+// Called on each playback loop iteration with the current tick, or -1 while the demo is loading, returns the recovery
+// step to execute if any.
+WatchdogStep WatchdogUpdate(int tick, double now);
+// Sets the reseek target to a tick known to be reachable, e.g. the start of a sequence or the target of a seek.
+void WatchdogSetSafeTick(int tick);
+// Tick reached a few seconds before the last tick progress, or the last tick set with WatchdogSetSafeTick.
+int GetWatchdogSafeTick();
+double GetWatchdogStalledSeconds(double now);
+nlohmann::json GetWatchdogStatsJson();
@@ -0,0 +1,138 @@
+#include "websocket.h"
+#include <thread>
+#include <queue>
+#include <mutex>
+#include <easywsclient.hpp>
+#include "playback.h"
+#include "timeline.h"
+#include "utils.h"
+
+using easywsclient::WebSocket;
+using nlohmann::json;
+using std::string;
+
+WebSocket::pointer ws;
+string wsUrl;
+std::queue<string> outgoingMessages;
+std::mutex outgoingMessagesMutex;
+
+string BuildWebSocketUrl(const string& baseUrl, const string& instanceId) {
+    string query = "process=game";
+    if (!instanceId.empty()) {
+        query += "&instance=" + instanceId;
+    }
+
+    if (baseUrl.find('?') != string::npos) {
+        return baseUrl + "&" + query;
+    }
+
+    size_t hostStart = baseUrl.find("://");
+    hostStart = hostStart == string::npos ? 0 : hostStart + 3;
+    if (baseUrl.find('/', hostStart) != string::npos) {
+        return baseUrl + "?" + query;
+    }
+
+    return baseUrl + "/?" + query;
+}
+
+void QueueWebSocketMessage(const json& msg) {
+    std::lock_guard<std::mutex> lock(outgoingMessagesMutex);
+    outgoingMessages.push(msg.dump());
+}
+
+bool PopQueuedWebSocketMessage(string& message) {
+    std::lock_guard<std::mutex> lock(outgoingMessagesMutex);
+    if (outgoingMessages.empty()) {
+        return false;
+    }
+
+    message = std::move(outgoingMessages.front());
+    outgoingMessages.pop();
+
+    return true;
+}
+
+static void SendQueuedWebSocketMessages() {
+    string message;
+    while (PopQueuedWebSocketMessage(message)) {
+        ws->send(message);
+    }
+}
+
+static void SendStatusOk() {
+    json msg;
+    msg["name"] = "status";
+    msg["payload"] = "ok";
+    QueueWebSocketMessage(msg);
+}
+
+void HandleWebSocketMessage(const std::string& message)
+{
+    Log("Message received: %s", message.c_str());
+
+    json msg = json::parse(message, nullptr, false);
+    if (msg.is_discarded()) {
+        Log("Invalid message ignored");
+        return;
+    }
+
+    if (!msg.contains("name")) {
+        return;
+    }
+
+    if (msg["name"] == "playdemo" && msg.contains("payload") && msg["payload"].is_string()) {
+        SendStatusOk();
+        RequestDemoPlayback(msg["payload"]);
+    }
+}
+
+bool IsWebSocketConnected() {
+    return ws != NULL;
+}
+
+void CloseWebSocket() {
+    if (ws != NULL) {
+        ws->close();
+    }
+}
+
+static void ConnectToWebsocketServer() {
+    Log("Connecting to WebSocket server %s...", wsUrl.c_str());
+    ws = WebSocket::from_url(wsUrl);
+    if (ws == NULL)
+    {
+        Log("Failed to connect to WebSocket server.");
+        return;
+    }
+
+    Log("Connected to WebSocket server.");
+    TimelineMark("ws_connected");
+    while (ws->getReadyState() != WebSocket::CLOSED && !isQuitting) {
+        SendQueuedWebSocketMessages();
+        ws->poll();
+        ws->dispatch(HandleWebSocketMessage);
+    }
+
+    Log("Disconnected from WebSocket server.");
+    delete ws;
+    ws = NULL;
+}
+
+void ConnectToWebsocketServerLoop() {
+    while (true) {
+        if (isQuitting) {
+            break;
+        }
+
+        if (ws != NULL) {
+            continue;
+        }
+
+        ConnectToWebsocketServer();
+
+        if (ws == NULL) {
+            Log("Retrying in 2s...");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <nlohmann/json.hpp>
+
+// Connection to the CS:DM WebSocket server.
+
+extern std::string wsUrl;
+
+// Query parameters are appended to the URL path, easywsclient drops them if the URL doesn't contain a path.
+std::string BuildWebSocketUrl(const std::string& baseUrl, const std::string& instanceId);
+// easywsclient is not thread-safe, messages sent from other threads than the WebSocket one are queued and sent from the
+// WebSocket thread.
+void QueueWebSocketMessage(const nlohmann::json& msg);
+// Pops the oldest queued message, returns false if the queue is empty.
+bool PopQueuedWebSocketMessage(std::string& message);
+void HandleWebSocketMessage(const std::string& message);
+bool IsWebSocketConnected();
+void CloseWebSocket();
+// Connects to the server and reconnects when the connection is lost until isQuitting is set.
+void ConnectToWebsocketServerLoop();
@@ -2,7 +2,11 @@
 #include <fstream>
 #include <mutex>
 #include <queue>
+#include <algorithm>
+#include <cmath>
+#include <sys/stat.h>
 #include <tier1.h>
+#include <fasttimer.h>
 #include <easywsclient.hpp>
 #include <nlohmann/json.hpp>
 #ifdef _WIN32
@@ -28,14 +32,23 @@ using std::thread;
 using std::mutex;
 using std::chrono::milliseconds;
 
+// Delay in seconds before sending the initial playdemo command again if the engine didn't start loading the demo.
+#define INITIAL_PLAYDEMO_RETRY_DELAY 1.0
+#define INITIAL_PLAYDEMO_MAX_ATTEMPTS 10
+#define DEFAULT_WS_URL "ws://localhost:4574"
+// Seconds between 2 checks of the actions file modification time.
+#define ACTIONS_FILE_POLLING_INTERVAL 1.0
+
 struct Action {
     int tick;
     string cmd;
-    bool executed;
 };
 
 struct Sequence {
+    // Sorted by tick, actions sharing the same tick keep the order of the JSON file.
     std::vector<Action> actions;
+    // Index of the next action to execute, all actions before it have already been executed or skipped.
+    size_t nextActionIndex = 0;
 };
 
 #ifdef _WIN32
@@ -55,21 +68,55 @@ WebSocket::pointer ws;
 string demoPath;
 string vdfFilePath;
 bool isPlayingDemo = false;
-int mainMenuFrameCount = 0;
+CSGOGameUIState_t lastUiState = CSGO_GAME_UI_STATE_INVALID;
+int initialPlaydemoAttempts = 0;
+double lastInitialPlaydemoTime = 0;
+double pluginLoadTime = 0;
+bool isFirstDemoTickReached = false;
 int currentTick = -1;
+// Tick at which go_to_next_sequence started the current sequence, -1 once the demo_gototick 0 it executed is applied.
+// Until then the playback still reports the ticks of the previous sequence, they must not move the new cursor.
+int sequenceChangeTick = -1;
 bool isQuitting = false;
 std::queue<Sequence> sequences;
+// Index of the current sequence in the JSON file.
+int currentSequenceIndex = 0;
+// Changes of the actions file are applied during the playback unless disabled with -csdm_hot_reload 0.
+// The file is polled from the main thread, a stat call per second doesn't impact the framerate.
+bool isHotReloadEnabled = true;
+string actionsDemoPath;
+double nextActionsFileCheckTime = 0;
+time_t actionsFileModificationTime = 0;
+long actionsFileSize = -1;
+bool isActionsFileChangePending = false;
+// Several game instances may run on the same machine, each one has its own WebSocket server URL and log file.
+// They are read from launch parameters or environment variables.
+string instanceId;
+string wsUrl;
 // Unlike CS2, executing client commands from a different thread than the main game thread may crash the game.
 // As the WebSocket connection runs in a separate thread, we defer the possible command execution when we receive a
 // WS message to the next frame of the main game thread.
 // These variables are used to share the command to be executed between the WebSocket thread and the main game thread.
+// The actions file of a demo to play is loaded on the main thread too, the sequences and the hot reload state are only
+// used from there.
 string pendingCmd;
+string pendingDemoPath;
 mutex pendingCmdMutex;
+// Time spent in our FrameStageNotify hook, it runs on the main thread so it directly impacts the game framerate.
+CAverageCycleCounter frameHookCounter;
+
+void LoadSequencesFile(string demoPath);
 
 void ExecutePendingCommand()
 {
     if (pendingCmdMutex.try_lock())
     {
+        if (!pendingDemoPath.empty())
+        {
+            LoadSequencesFile(pendingDemoPath);
+            pendingDemoPath.clear();
+        }
+
         if (!pendingCmd.empty())
         {
             Log("Executing command: %s", pendingCmd.c_str());
@@ -91,28 +138,99 @@ void SendStatusOk() {
     ws->send(msg.dump());
 }
 
+// Actions are located either with a "tick" or with an "anchorTick" and an "offsetMs" time offset relative to it, so that
+// margins expressed in milliseconds translate to the same wall-clock duration on 64 and 128 tick demos.
+int ResolveActionTick(int anchorTick, double offsetMs, double tickInterval) {
+    long tick = anchorTick + lround(offsetMs / 1000 / tickInterval);
+
+    return (int)std::max(1L, tick);
+}
+
+// Returns false if an action is invalid, the sequences are then incomplete.
+bool ParseSequences(const string& demoPath, const json& jsonSequences, std::queue<Sequence>& parsedSequences) {
+    if (!jsonSequences.is_array()) {
+        return false;
+    }
+
+    // Only read from the demo when an action needs it.
+    double tickInterval = 0;
+    for (const auto& jsonSequence : jsonSequences) {
+        if (!jsonSequence.is_object() || !jsonSequence.contains("actions") || !jsonSequence["actions"].is_array()) {
+            return false;
+        }
+
+        Sequence sequence;
+        for (const auto& jsonAction : jsonSequence["actions"]) {
+            if (!jsonAction.is_object() || !jsonAction.contains("cmd") || !jsonAction["cmd"].is_string()) {
+                return false;
+            }
+
+            Action action;
+            if (jsonAction.contains("anchorTick") && jsonAction["anchorTick"].is_number()) {
+                if (tickInterval == 0) {
+                    tickInterval = GetDemoTickInterval(demoPath);
+                    Log("Demo tick interval: %.6fs", tickInterval);
+                }
+                double offsetMs = jsonAction.contains("offsetMs") && jsonAction["offsetMs"].is_number() ? jsonAction["offsetMs"].get<double>() : 0;
+                action.tick = ResolveActionTick(jsonAction["anchorTick"], offsetMs, tickInterval);
+            }
+            else if (jsonAction.contains("tick") && jsonAction["tick"].is_number()) {
+                action.tick = jsonAction["tick"];
+            }
+            else {
+                return false;
+            }
+            action.cmd = jsonAction["cmd"];
+            sequence.actions.push_back(action);
+        }
+        std::stable_sort(sequence.actions.begin(), sequence.actions.end(), [](const Action& a, const Action& b) {
+            return a.tick < b.tick;
+        });
+        parsedSequences.push(sequence);
+    }
+
+    return true;
+}
+
+void GetActionsFileState(const string& path, time_t& modificationTime, long& size) {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) == 0) {
+        modificationTime = fileStat.st_mtime;
+        size = (long)fileStat.st_size;
+    }
+    else {
+        modificationTime = 0;
+        size = -1;
+    }
+}
+
 void LoadSequencesFile(string demoPath) {
     sequences = {};
+    sequenceChangeTick = -1;
+    currentSequenceIndex = 0;
 
     string demoJsonPath = demoPath + ".json";
+    actionsDemoPath = demoPath;
+    isActionsFileChangePending = false;
+    GetActionsFileState(demoJsonPath, actionsFileModificationTime, actionsFileSize);
     if (FileExists(demoJsonPath)) {
         std::ifstream jsonFile(demoJsonPath);
-        json jsonSequences = json::parse(jsonFile);
+        json jsonSequences = json::parse(jsonFile, nullptr, false);
+        if (jsonSequences.is_discarded()) {
+            Log("Invalid JSON sequences file %s, no actions will be executed", demoJsonPath.c_str());
+            return;
+        }
+
         if (jsonSequences.size() == 0) {
             Log("No sequences found in JSON file");
             return;
         }
 
-        for (auto jsonSequence : jsonSequences) {
-            Sequence sequence;
-            for (auto jsonAction : jsonSequence["actions"]) {
-                Action action;
-                action.tick = jsonAction["tick"];
-                action.cmd = jsonAction["cmd"];
-                action.executed = false;
-                sequence.actions.push_back(action);
-            }
-            sequences.push(sequence);
+        // A partial job would record the wrong sequences.
+        if (!ParseSequences(demoPath, jsonSequences, sequences)) {
+            Log("Invalid action found in JSON file %s, no actions will be executed", demoJsonPath.c_str());
+            sequences = {};
+            return;
         }
 
         Log("JSON sequences file loaded: %s", demoJsonPath.c_str());
@@ -122,9 +240,63 @@ void LoadSequencesFile(string demoPath) {
     }
 }
 
+// Replaces the sequences with the ones of the actions file when it has been modified during the playback, so that
+// changes are applied without restarting the game. The position in the sequences is kept, actions of the current
+// sequence located up to the current tick are not executed, the current actions are kept if the file is invalid.
+void ReloadSequencesFileIfChanged(double now) {
+    if (!isHotReloadEnabled || actionsDemoPath.empty() || now < nextActionsFileCheckTime) {
+        return;
+    }
+
+    nextActionsFileCheckTime = now + ACTIONS_FILE_POLLING_INTERVAL;
+    string demoJsonPath = actionsDemoPath + ".json";
+    time_t modificationTime;
+    long size;
+    GetActionsFileState(demoJsonPath, modificationTime, size);
+    if (modificationTime != actionsFileModificationTime || size != actionsFileSize) {
+        // The file may still be being written, it's reloaded once it didn't change during a polling interval.
+        actionsFileModificationTime = modificationTime;
+        actionsFileSize = size;
+        isActionsFileChangePending = true;
+        return;
+    }
+
+    if (!isActionsFileChangePending) {
+        return;
+    }
+
+    isActionsFileChangePending = false;
+    std::ifstream jsonFile(demoJsonPath);
+    json jsonSequences = json::parse(jsonFile, nullptr, false);
+    std::queue<Sequence> newSequences;
+    if (jsonSequences.is_discarded() || !ParseSequences(actionsDemoPath, jsonSequences, newSequences)) {
+        Log("Invalid JSON sequences file %s, keeping the current actions", demoJsonPath.c_str());
+        return;
+    }
+
+    for (int i = 0; i < currentSequenceIndex && !newSequences.empty(); i++) {
+        newSequences.pop();
+    }
+    if (!newSequences.empty()) {
+        Sequence& currentSequence = newSequences.front();
+        auto it = std::upper_bound(currentSequence.actions.begin(), currentSequence.actions.end(), currentTick,
+            [](int value, const Action& action) {
+                return value < action.tick;
+            });
+        currentSequence.nextActionIndex = it - currentSequence.actions.begin();
+    }
+    sequences.swap(newSequences);
+    Log("JSON sequences file reloaded: %s, remaining sequences: %d", demoJsonPath.c_str(), sequences.size());
+}
+
 void HandleWebSocketMessage(const string& message)
 {
-    json msg = json::parse(message.c_str());
+    json msg = json::parse(message, nullptr, false);
+    if (msg.is_discarded()) {
+        Log("Invalid message ignored");
+        return;
+    }
+
     if (!msg.contains("name")) {
         return;
     }
@@ -134,32 +306,120 @@ void HandleWebSocketMessage(const string& message)
 
         string demoPath = msg["payload"];
 
-        LoadSequencesFile(demoPath);
-
         std::lock_guard<mutex> lock(pendingCmdMutex);
+        pendingDemoPath = demoPath;
         pendingCmd = "playdemo \"" + demoPath + "\"";
     }
 }
 
 void ExecuteInitialDemoPlayback() {
+    if (demoPath.empty()) {
+        return;
+    }
+
+    CSGOGameUIState_t uiState = gameUi->m_CSGOGameUIState;
+    if (uiState != lastUiState) {
+        Log("UI state changed from %d to %d", lastUiState, uiState);
+        lastUiState = uiState;
+    }
+
+    // The engine acknowledged the command once it starts loading the demo.
+    if (initialPlaydemoAttempts > 0 && (engine->IsPlayingDemo() || uiState == CSGO_GAME_UI_STATE_LOADINGSCREEN || uiState == CSGO_GAME_UI_STATE_INGAME)) {
+        Log("Initial playdemo command accepted after %d attempt(s), %.2fs after plugin load", initialPlaydemoAttempts, Plat_FloatTime() - pluginLoadTime);
+        demoPath.clear();
+        initialPlaydemoAttempts = 0;
+        return;
+    }
+
     // The popup "CSGO Legacy version" shown since the CS2 release prevents the demo playback to start when the game
     // starts and the +playdemo launch parameter is used.
-    // As a workaround we force the demo playback once the main menu is loaded.
+    // As a workaround we force the demo playback as soon as the main menu is loaded.
     // Another solution would be to add the +tv_relay launch parameter, but it spams the console with re-connection
     // messages. Thanks @dtugend for your hints on this one!
-    if (demoPath.empty() || gameUi->m_CSGOGameUIState != CSGO_GAME_UI_STATE_MAINMENU) {
+    if (uiState != CSGO_GAME_UI_STATE_MAINMENU) {
         return;
     }
 
-    // Wait some frames before executing the command otherwise it may be ignored.
-    if (++mainMenuFrameCount > 60)
-    {
-        string cmd = "playdemo \"" + demoPath + "\"";
-        Log("Executing initial playdemo command: %s", cmd.c_str());
-        engine->ExecuteClientCmd(cmd.c_str());
+    // The command may be ignored if the main menu is not fully ready yet, in this case the UI state doesn't change and
+    // we try again a bit later.
+    double now = Plat_FloatTime();
+    if (initialPlaydemoAttempts > 0 && now - lastInitialPlaydemoTime < INITIAL_PLAYDEMO_RETRY_DELAY) {
+        return;
+    }
+
+    if (initialPlaydemoAttempts >= INITIAL_PLAYDEMO_MAX_ATTEMPTS) {
+        Log("Initial playdemo command ignored %d times, giving up.", initialPlaydemoAttempts);
         demoPath.clear();
-        mainMenuFrameCount = 0;
+        initialPlaydemoAttempts = 0;
+        return;
     }
+
+    string cmd = "playdemo \"" + demoPath + "\"";
+    Log("Executing initial playdemo command: %s", cmd.c_str());
+    engine->ExecuteClientCmd(cmd.c_str());
+    lastInitialPlaydemoTime = now;
+    initialPlaydemoAttempts++;
+}
+
+void LogFrameHookTimings() {
+    Log("Frame hook: %u calls, avg %.4f ms, peak %.4f ms, total %.2f ms", frameHookCounter.GetIters(),
+        frameHookCounter.GetAverageMilliseconds(), frameHookCounter.GetPeakMilliseconds(),
+        frameHookCounter.GetTotalMilliseconds());
+}
+
+// Moves the cursor of the current sequence to the first action that has to be executed when the playback reaches the
+// given tick. Called when the playback jumps to another tick (demo_gototick) so that actions located after the new tick
+// are executed again when seeking backward, and actions located before it are not executed when seeking forward.
+void SeekSequenceActions(int tick) {
+    if (sequences.empty()) {
+        return;
+    }
+
+    Sequence& currentSequence = sequences.front();
+    auto it = std::lower_bound(currentSequence.actions.begin(), currentSequence.actions.end(), tick - 1,
+        [](const Action& action, int value) {
+            return action.tick < value;
+        });
+    currentSequence.nextActionIndex = it - currentSequence.actions.begin();
+}
+
+// Executes the actions of the current sequence up to the given tick.
+// Returns true if the sequence has been changed.
+bool ExecuteSequenceActions(int tick) {
+    if (sequences.empty()) {
+        return false;
+    }
+
+    Sequence& currentSequence = sequences.front();
+    while (currentSequence.nextActionIndex < currentSequence.actions.size()) {
+        const Action& action = currentSequence.actions[currentSequence.nextActionIndex];
+        if (action.tick > tick) {
+            break;
+        }
+
+        currentSequence.nextActionIndex++;
+
+        // Also accept minus 1 because some ticks may not be "seen" when fast-forwarding the playback during a few ticks.
+        // Example with demo_gototick 1000: 1001 -> 1003 -> 1005 -> 1007 -> 1008 -> 1009 -> 1010...
+        // Older actions have been skipped by a seek and are not executed.
+        if (action.tick < tick - 1) {
+            continue;
+        }
+
+        if (action.cmd == "go_to_next_sequence") {
+            Log("Going to next sequence, remaining sequences: %d", sequences.size() - 1);
+            sequences.pop();
+            currentSequenceIndex++;
+            engine->ExecuteClientCmd("demo_gototick 0");
+            sequenceChangeTick = tick;
+            return true;
+        }
+
+        Log("%d executing: %s", tick, action.cmd.c_str());
+        engine->ExecuteClientCmd(action.cmd.c_str());
+    }
+
+    return false;
 }
 
 void PlaybackFrame() {
@@ -172,9 +432,11 @@ void PlaybackFrame() {
     if (newIsPlayingDemo && !isPlayingDemo) {
         Log("Demo playback started %d", currentTick);
         currentTick = -1;
+        sequenceChangeTick = -1;
     }
     else if (!newIsPlayingDemo && isPlayingDemo) {
         Log("Demo playback stopped %d", currentTick);
+        LogFrameHookTimings();
         currentTick = -1;
     }
 
@@ -184,33 +446,38 @@ void PlaybackFrame() {
     }
 
     int newTick = engine->GetDemoPlaybackTick();
-    if (newTick != currentTick) {
-        Sequence& currentSequence = sequences.front();
-        for (auto& action : currentSequence.actions) {
-            // Also check for minus 1 because some ticks may not be "seen" when fast-forwarding the playback during a few ticks.
-            // Example with demo_gototick 1000: 1001 -> 1003 -> 1005 -> 1007 -> 1008 -> 1009 -> 1010...
-            if (!action.executed && (action.tick == newTick || action.tick == newTick - 1)) {
-                action.executed = true;
-                if (action.cmd == "go_to_next_sequence") {
-                    Log("Going to next sequence, remaining sequences: %d", sequences.size() - 1);
-                    sequences.pop();
-                    engine->ExecuteClientCmd("demo_gototick 0");
-                    currentTick = -1;
-                }
-                else {
-                    Log("%d executing: %s", newTick, action.cmd.c_str());
-                    engine->ExecuteClientCmd(action.cmd.c_str());
-                }
-            }
-        }
+    if (!isFirstDemoTickReached) {
+        Log("First demo tick %d reached %.2fs after plugin load", newTick, Plat_FloatTime() - pluginLoadTime);
+        isFirstDemoTickReached = true;
+    }
+
+    // A sequence changed at tick 0 or 1 already starts from the beginning of the demo.
+    if (sequenceChangeTick > 1 && newTick >= sequenceChangeTick) {
+        return;
+    }
+    sequenceChangeTick = -1;
+
+    if (currentTick != -1 && newTick < currentTick) {
+        Log("Playback moved backward from tick %d to %d", currentTick, newTick);
+        SeekSequenceActions(newTick);
+    }
+    else if (currentTick != -1 && newTick > currentTick + 2) {
+        SeekSequenceActions(newTick);
+    }
+
+    ReloadSequencesFileIfChanged(Plat_FloatTime());
+
+    if (newTick != currentTick && ExecuteSequenceActions(newTick)) {
+        currentTick = -1;
+        return;
     }
 
     currentTick = newTick;
 }
 
 void ConnectToWebsocketServer() {
-    Log("Connecting to WebSocket server...");
-    ws = WebSocket::from_url("ws://localhost:4574?process=game");
+    Log("Connecting to WebSocket server %s...", wsUrl.c_str());
+    ws = WebSocket::from_url(wsUrl);
     if (ws == NULL)
     {
         Log("Failed to connect to WebSocket server.");
@@ -247,6 +514,34 @@ void ConnectToWebsocketServerLoop() {
     }
 }
 
+// Query parameters are appended to the URL path, easywsclient drops them if the URL doesn't contain a path.
+string BuildWebSocketUrl(const string& baseUrl) {
+    string query = "process=game";
+    if (!instanceId.empty()) {
+        query += "&instance=" + instanceId;
+    }
+
+    if (baseUrl.find('?') != string::npos) {
+        return baseUrl + "&" + query;
+    }
+
+    size_t hostStart = baseUrl.find("://");
+    hostStart = hostStart == string::npos ? 0 : hostStart + 3;
+    if (baseUrl.find('/', hostStart) != string::npos) {
+        return baseUrl + "?" + query;
+    }
+
+    return baseUrl + "/?" + query;
+}
+
+void LoadInstanceConfig() {
+    instanceId = GetLaunchParameter("-csdm_instance", "CSDM_INSTANCE", "");
+    string defaultLogFilePath = instanceId.empty() ? "csdm.log" : "csdm_" + instanceId + ".log";
+    SetLogFilePath(GetLaunchParameter("-csdm_log", "CSDM_LOG", defaultLogFilePath));
+    wsUrl = BuildWebSocketUrl(GetLaunchParameter("-csdm_ws_url", "CSDM_WS_URL", DEFAULT_WS_URL));
+    isHotReloadEnabled = GetLaunchParameter("-csdm_hot_reload", "CSDM_HOT_RELOAD", "1") != "0";
+}
+
 CServerPlugin::CServerPlugin()
 {
 }
@@ -261,9 +556,18 @@ void __stdcall NewFrameStageNotify(CClientFrameStage stage)
 void NewFrameStageNotify(void* thisptr, CClientFrameStage stage)
 #endif
 {
-    ExecuteInitialDemoPlayback();
-    ExecutePendingCommand();
-    PlaybackFrame();
+    // The hook is called several times per frame, once per stage. FRAME_RENDER_START happens once per rendered frame
+    // after network updates have been processed, so the demo tick is up to date and commands are run before rendering.
+    if (stage == FRAME_RENDER_START)
+    {
+        CFastTimer timer;
+        timer.Start();
+        ExecuteInitialDemoPlayback();
+        ExecutePendingCommand();
+        PlaybackFrame();
+        timer.End();
+        frameHookCounter.MarkIter(timer.GetDuration());
+    }
 
 #ifdef _WIN32
     originalFrameStageNotify(stage);
@@ -275,6 +579,8 @@ void NewFrameStageNotify(void* thisptr, CClientFrameStage stage)
 // Called when the plugin is loaded ONLY if the -insecure launch parameter is set.
 bool CServerPlugin::Load(CreateInterfaceFn interfaceFactory, CreateInterfaceFn gameServerFactory)
 {
+    pluginLoadTime = Plat_FloatTime();
+    LoadInstanceConfig();
     DeleteLogFile();
 
     engine = (IVEngineClient14*)interfaceFactory("VEngineClient014", NULL);
@@ -403,6 +709,9 @@ const char *CServerPlugin::GetPluginDescription()
 }
 
 CON_COMMAND(csdm_info, "Show info"){
+    if (!instanceId.empty()) {
+        Log("Instance: %s", instanceId.c_str());
+    }
     if (!demoPath.empty()) {
         Log("Demo path: %s", demoPath.c_str());
     }
@@ -410,6 +719,7 @@ CON_COMMAND(csdm_info, "Show info"){
     Log("Is playing demo: %d", isPlayingDemo);
     Log("Sequences count: %d", sequences.size());
     Log("UI state: %d", gameUi->m_CSGOGameUIState);
+    LogFrameHookTimings();
 
     if (ws != NULL) {
         Log("WebSocket connected");
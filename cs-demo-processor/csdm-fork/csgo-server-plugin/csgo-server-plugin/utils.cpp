@@ -1,5 +1,8 @@
 #include "utils.h"
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <icommandline.h>
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -7,8 +10,14 @@
 #include <sys/mman.h>
 #endif
 
+std::string logFilePath = "csdm.log";
+
+void SetLogFilePath(const std::string& path) {
+    logFilePath = path;
+}
+
 void LogToFile(const char* pMsg) {
-    FILE* pFile = fopen("csdm.log", "a");
+    FILE* pFile = fopen(logFilePath.c_str(), "a");
     if (pFile == NULL)
     {
         return;
@@ -32,7 +41,7 @@ void Log(const char* msg, ...)
 
 void DeleteLogFile()
 {
-    remove("csdm.log");
+    remove(logFilePath.c_str());
 }
 
 bool FileExists(const std::string& name) {
@@ -41,6 +50,46 @@ bool FileExists(const std::string& name) {
     return f.good();
 }
 
+double GetDemoTickInterval(const std::string& demoPath) {
+    // See the demoheader_t struct, the playback time is located after the stamp, protocols and 4 MAX_OSPATH strings.
+    const int playbackTimeOffset = 8 + 4 + 4 + 260 * 4;
+    std::ifstream file(demoPath.c_str(), std::ios::binary);
+    char stamp[8];
+    float playbackTime;
+    int32_t playbackTicks;
+    if (!file.read(stamp, sizeof(stamp)) || memcmp(stamp, "HL2DEMO", sizeof(stamp)) != 0) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    file.seekg(playbackTimeOffset);
+    if (!file.read((char*)&playbackTime, sizeof(playbackTime)) || !file.read((char*)&playbackTicks, sizeof(playbackTicks))
+        || playbackTicks <= 0) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    // Tick rates outside of [16, 256] mean that the header is corrupted.
+    double tickInterval = playbackTime / playbackTicks;
+    if (!(tickInterval >= 1.0 / 256 && tickInterval <= 1.0 / 16)) {
+        return CSDM_DEFAULT_TICK_INTERVAL;
+    }
+
+    return tickInterval;
+}
+
+std::string GetLaunchParameter(const char* name, const char* envName, const std::string& defaultValue) {
+    const char* value = CommandLine()->ParmValue(name, (const char*)NULL);
+    if (value != NULL) {
+        return std::string(value);
+    }
+
+    const char* envValue = getenv(envName);
+    if (envValue != NULL && envValue[0] != '\0') {
+        return std::string(envValue);
+    }
+
+    return defaultValue;
+}
+
 void* GetLibAddress(void* lib, const char* name) {
 #if defined _WIN32
     return GetProcAddress((HMODULE)lib, name);
@@ -2,14 +2,24 @@
 #include <dbg.h>
 #include <cstdint>
 #include <fstream>
+
+// Used when the demo header can't be read, matchmaking demos are recorded at 64 ticks per second.
+#define CSDM_DEFAULT_TICK_INTERVAL (1.0 / 64)
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
 void LogToFile(const char* pMsg);
 void Log(const char* msg, ...);
+void SetLogFilePath(const std::string& path);
 void DeleteLogFile();
 bool FileExists(const std::string& name);
+// Returns the duration of a tick of the demo in seconds, computed from the playback time and ticks of its header.
+// Returns CSDM_DEFAULT_TICK_INTERVAL if the header can't be read or is incomplete, e.g. demos of interrupted matches.
+double GetDemoTickInterval(const std::string& demoPath);
+// Returns the value of a launch parameter such as "-csdm_instance 2", or the value of the environment variable if the
+// parameter is not present, or the default value.
+std::string GetLaunchParameter(const char* name, const char* envName, const std::string& defaultValue);
 void* GetLibAddress(void* lib, const char* name);
 char* GetLastErrorString();
 void* LoadLib(const char* path);
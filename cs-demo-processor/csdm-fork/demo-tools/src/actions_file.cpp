@@ -0,0 +1,133 @@
+#include "actions_file.h"
+#include <algorithm>
+#include <fstream>
+
+using nlohmann::ordered_json;
+using std::string;
+
+// Actions before this tick are not executed reliably by the plugins.
+#define MIN_ACTION_TICK 64
+
+static int32_t GetValidTick(int32_t tick)
+{
+    return std::max(MIN_ACTION_TICK, tick);
+}
+
+ActionsFileGenerator::ActionsFileGenerator(const string& demoPath, DemoSource source) : source(source)
+{
+    filePath = demoPath + ".json";
+    std::replace(filePath.begin(), filePath.end(), '\\', '/');
+}
+
+void ActionsFileGenerator::AddAction(int32_t tick, const string& cmd)
+{
+    ordered_json action;
+    action["cmd"] = cmd;
+    action["tick"] = GetValidTick(tick);
+    currentActions.push_back(action);
+}
+
+ActionsFileGenerator& ActionsFileGenerator::AddSkipAhead(int32_t startTick, int32_t toTick)
+{
+    AddAction(startTick, "demo_gototick " + std::to_string(GetValidTick(toTick)));
+
+    return *this;
+}
+
+ActionsFileGenerator& ActionsFileGenerator::AddSpecPlayer(int32_t tick, const string& playerId)
+{
+    if (source == DemoSource::SOURCE_1) {
+        // Locking the camera prevents losing the player when an observer was controlling it.
+        AddAction(tick, "spec_lock_to_accountid " + playerId);
+        AddAction(tick, "spec_player_by_accountid " + playerId);
+    }
+    else {
+        // The camera may be stuck in free mode with some demos.
+        AddAction(tick, "spec_player " + playerId);
+        AddAction(tick, "spec_mode 1");
+    }
+
+    return *this;
+}
+
+ActionsFileGenerator& ActionsFileGenerator::AddStopPlayback(int32_t tick)
+{
+    AddAction(tick, "disconnect");
+
+    return *this;
+}
+
+ActionsFileGenerator& ActionsFileGenerator::AddExecCommand(int32_t tick, const string& cmd)
+{
+    AddAction(tick, cmd);
+
+    return *this;
+}
+
+ActionsFileGenerator& ActionsFileGenerator::EnablePlayerVoices(int32_t tick)
+{
+    if (source == DemoSource::SOURCE_1) {
+        AddAction(tick, "voice_enable 1");
+    }
+    else {
+        AddAction(tick, "tv_listen_voice_indices -1");
+        AddAction(tick, "tv_listen_voice_indices_h -1");
+    }
+
+    return *this;
+}
+
+ActionsFileGenerator& ActionsFileGenerator::DisablePlayerVoices(int32_t tick)
+{
+    if (source == DemoSource::SOURCE_1) {
+        AddAction(tick, "voice_enable 0");
+    }
+    else {
+        AddAction(tick, "tv_listen_voice_indices 0");
+        AddAction(tick, "tv_listen_voice_indices_h 0");
+    }
+
+    return *this;
+}
+
+ActionsFileGenerator& ActionsFileGenerator::AddGoToNextSequence(int32_t tick)
+{
+    // Same key order as the app.
+    ordered_json action;
+    action["tick"] = GetValidTick(tick);
+    action["cmd"] = "go_to_next_sequence";
+    currentActions.push_back(action);
+
+    sequences.push_back({{"actions", currentActions}});
+    currentActions = ordered_json::array();
+
+    return *this;
+}
+
+ordered_json ActionsFileGenerator::GetSequences() const
+{
+    ordered_json result = sequences;
+    if (!currentActions.empty()) {
+        result.push_back({{"actions", currentActions}});
+    }
+
+    return result;
+}
+
+bool ActionsFileGenerator::Write(string& error) const
+{
+    ordered_json result = GetSequences();
+    if (result.empty()) {
+        return true;
+    }
+
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file.is_open()) {
+        error = "Failed to write " + filePath;
+        return false;
+    }
+    // Like JSON.stringify(sequences, null, 2), without trailing new line.
+    file << result.dump(2, ' ', false, ordered_json::error_handler_t::replace);
+
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "demo_header.h"
+
+// Port of the JSONActionsFileGenerator class of the app, it writes the <demo>.json actions file read by the server
+// plugins with the same commands and the same formatting.
+class ActionsFileGenerator
+{
+public:
+    ActionsFileGenerator(const std::string& demoPath, DemoSource source);
+
+    ActionsFileGenerator& AddSkipAhead(int32_t startTick, int32_t toTick);
+    // playerId is the SteamID64 for CSGO and the player slot for CS2.
+    ActionsFileGenerator& AddSpecPlayer(int32_t tick, const std::string& playerId);
+    ActionsFileGenerator& AddStopPlayback(int32_t tick);
+    ActionsFileGenerator& AddExecCommand(int32_t tick, const std::string& cmd);
+    ActionsFileGenerator& EnablePlayerVoices(int32_t tick = 1);
+    ActionsFileGenerator& DisablePlayerVoices(int32_t tick = 1);
+    // Internal plugin command that starts the next sequence.
+    ActionsFileGenerator& AddGoToNextSequence(int32_t tick);
+
+    const std::string& GetFilePath() const { return filePath; }
+    void SetFilePath(const std::string& path) { filePath = path; }
+    // Returns the JSON array of sequences, the current sequence included.
+    nlohmann::ordered_json GetSequences() const;
+    // Nothing is written if there are no actions.
+    bool Write(std::string& error) const;
+
+private:
+    void AddAction(int32_t tick, const std::string& cmd);
+
+    std::string filePath;
+    DemoSource source;
+    nlohmann::ordered_json sequences = nlohmann::ordered_json::array();
+    nlohmann::ordered_json currentActions = nlohmann::ordered_json::array();
+};
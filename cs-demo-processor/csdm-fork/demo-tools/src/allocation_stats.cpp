@@ -0,0 +1,46 @@
+#include "allocation_stats.h"
+#include <cstdlib>
+#include <new>
+
+// Counted per thread so that demos parsed in parallel are measured separately, without atomic operations.
+static thread_local uint64_t heapAllocationCount = 0;
+
+uint64_t GetThreadHeapAllocationCount()
+{
+    return heapAllocationCount;
+}
+
+// The array versions call these ones. The nothrow versions are replaced too because sanitizers intercept them
+// separately, their memory would be released by a different allocator.
+void* operator new(std::size_t size)
+{
+    heapAllocationCount++;
+    void* pointer = std::malloc(size > 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    heapAllocationCount++;
+
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
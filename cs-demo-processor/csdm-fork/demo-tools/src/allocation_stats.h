@@ -0,0 +1,6 @@
+#pragma once
+#include <cstdint>
+
+// Number of heap allocations (operator new) made by the calling thread since it started, to check that the parsing
+// loops don't allocate per message.
+uint64_t GetThreadHeapAllocationCount();
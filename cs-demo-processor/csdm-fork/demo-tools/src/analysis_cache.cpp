@@ -0,0 +1,326 @@
+#include "analysis_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <system_error>
+#include <vector>
+#include "checksum.h"
+#include "mapped_file.h"
+
+using std::string;
+
+// Cache file layout, all integers are little endian and every record is aligned on its size:
+// header: magic, demo file size (u64), demo checksum (u64), tickrate (f64), tick count (i32), round count (u32),
+//         kill count (u32), player count (u32), player kill count (u32), reserved (u32)
+// rounds: start offset (u64), start tick (i32), freeze end tick (i32), end tick (i32), reserved (u32)
+// kills sorted by tick: killer SteamID (u64), victim SteamID (u64), tick (i32), killer slot (i32), victim slot (i32),
+//         reserved (u32)
+// players sorted by SteamID: SteamID (u64), first player kill (u32), kill count (u32)
+// player kills: kill index (u32) of the kills of each player in tick order, suicides excluded
+#define CACHE_FILE_MAGIC "CSDMAC01"
+#define CACHE_FILE_MAGIC_SIZE 8
+#define CACHE_FILE_EXTENSION ".analysis"
+#define HEADER_SIZE 56
+#define ROUND_SIZE 24
+#define KILL_SIZE 32
+#define PLAYER_SIZE 16
+#define PLAYER_KILL_SIZE 4
+
+static void WriteUInt32(string& output, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        output += (char)(value >> (i * 8));
+    }
+}
+
+static void WriteUInt64(string& output, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        output += (char)(value >> (i * 8));
+    }
+}
+
+static uint32_t ReadUInt32(const uint8_t* data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t ReadUInt64(const uint8_t* data)
+{
+    return (uint64_t)ReadUInt32(data) | ((uint64_t)ReadUInt32(data + 4) << 32);
+}
+
+// Sections of a mapped cache file.
+struct CacheFileView
+{
+    MappedFile file;
+    double tickrate;
+    int32_t tickCount;
+    uint32_t roundCount;
+    uint32_t killCount;
+    uint32_t playerCount;
+    uint32_t playerKillCount;
+    const uint8_t* rounds;
+    const uint8_t* kills;
+    const uint8_t* players;
+    const uint8_t* playerKills;
+};
+
+static bool OpenCacheFile(const string& path, uint64_t demoFileSize, uint64_t demoChecksum, CacheFileView& view)
+{
+    string error;
+    if (!view.file.Open(path, error)) {
+        return false;
+    }
+
+    const uint8_t* data = view.file.Data();
+    size_t size = view.file.Size();
+    if (size < HEADER_SIZE || memcmp(data, CACHE_FILE_MAGIC, CACHE_FILE_MAGIC_SIZE) != 0
+        || ReadUInt64(data + 8) != demoFileSize || ReadUInt64(data + 16) != demoChecksum) {
+        return false;
+    }
+
+    uint64_t tickrateBits = ReadUInt64(data + 24);
+    memcpy(&view.tickrate, &tickrateBits, sizeof(view.tickrate));
+    view.tickCount = (int32_t)ReadUInt32(data + 32);
+    view.roundCount = ReadUInt32(data + 36);
+    view.killCount = ReadUInt32(data + 40);
+    view.playerCount = ReadUInt32(data + 44);
+    view.playerKillCount = ReadUInt32(data + 48);
+    uint64_t expectedSize = HEADER_SIZE + (uint64_t)view.roundCount * ROUND_SIZE + (uint64_t)view.killCount * KILL_SIZE
+                            + (uint64_t)view.playerCount * PLAYER_SIZE
+                            + (uint64_t)view.playerKillCount * PLAYER_KILL_SIZE;
+    if (expectedSize != size) {
+        return false;
+    }
+
+    view.rounds = data + HEADER_SIZE;
+    view.kills = view.rounds + (size_t)view.roundCount * ROUND_SIZE;
+    view.players = view.kills + (size_t)view.killCount * KILL_SIZE;
+    view.playerKills = view.players + (size_t)view.playerCount * PLAYER_SIZE;
+
+    return true;
+}
+
+static PlayerKill ReadKill(const uint8_t* data)
+{
+    PlayerKill kill;
+    kill.killerSteamId = ReadUInt64(data);
+    kill.victimSteamId = ReadUInt64(data + 8);
+    kill.tick = (int32_t)ReadUInt32(data + 16);
+    kill.killerSlot = (int32_t)ReadUInt32(data + 20);
+    kill.victimSlot = (int32_t)ReadUInt32(data + 24);
+
+    return kill;
+}
+
+string AnalysisCache::GetFilePath(const DemoHeader& header, uint64_t demoFileSize) const
+{
+    string fileName = GetDemoChecksum(header, demoFileSize) + CACHE_FILE_EXTENSION;
+
+    return (std::filesystem::path(folderPath) / fileName).string();
+}
+
+bool AnalysisCache::Load(const DemoHeader& header, uint64_t demoFileSize, DemoAnalysis& analysis)
+{
+    lookupCount++;
+    CacheFileView view;
+    if (!OpenCacheFile(GetFilePath(header, demoFileSize), demoFileSize, GetDemoChecksumValue(header, demoFileSize),
+                       view)) {
+        return false;
+    }
+
+    analysis = DemoAnalysis();
+    analysis.tickrate = view.tickrate;
+    analysis.tickCount = view.tickCount;
+    // Nothing was analyzed.
+    analysis.segmentCount = 0;
+    analysis.rounds.resize(view.roundCount);
+    for (uint32_t i = 0; i < view.roundCount; i++) {
+        const uint8_t* data = view.rounds + (size_t)i * ROUND_SIZE;
+        RoundBoundary& round = analysis.rounds[i];
+        round.startOffset = ReadUInt64(data);
+        round.startTick = (int32_t)ReadUInt32(data + 8);
+        round.freezeEndTick = (int32_t)ReadUInt32(data + 12);
+        round.endTick = (int32_t)ReadUInt32(data + 16);
+    }
+
+    analysis.kills.resize(view.killCount);
+    for (uint32_t i = 0; i < view.killCount; i++) {
+        analysis.kills[i] = ReadKill(view.kills + (size_t)i * KILL_SIZE);
+    }
+    hitCount++;
+
+    return true;
+}
+
+bool AnalysisCache::LoadPlayerKills(const DemoHeader& header, uint64_t demoFileSize, uint64_t steamId,
+                                    PlayerKills& playerKills)
+{
+    lookupCount++;
+    CacheFileView view;
+    if (!OpenCacheFile(GetFilePath(header, demoFileSize), demoFileSize, GetDemoChecksumValue(header, demoFileSize),
+                       view)) {
+        return false;
+    }
+
+    playerKills = PlayerKills();
+    playerKills.tickrate = view.tickrate;
+    playerKills.tickCount = view.tickCount;
+
+    uint32_t low = 0;
+    uint32_t high = view.playerCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (ReadUInt64(view.players + (size_t)middle * PLAYER_SIZE) < steamId) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    const uint8_t* player = view.players + (size_t)low * PLAYER_SIZE;
+    if (low < view.playerCount && ReadUInt64(player) == steamId) {
+        uint32_t firstKill = ReadUInt32(player + 8);
+        uint32_t killCount = ReadUInt32(player + 12);
+        if ((uint64_t)firstKill + killCount > view.playerKillCount) {
+            return false;
+        }
+
+        playerKills.kills.reserve(killCount);
+        for (uint32_t i = 0; i < killCount; i++) {
+            uint32_t killIndex = ReadUInt32(view.playerKills + (size_t)(firstKill + i) * PLAYER_KILL_SIZE);
+            if (killIndex >= view.killCount) {
+                playerKills.kills.clear();
+                return false;
+            }
+            playerKills.kills.push_back(ReadKill(view.kills + (size_t)killIndex * KILL_SIZE));
+        }
+    }
+    hitCount++;
+
+    return true;
+}
+
+bool AnalysisCache::Store(const DemoHeader& header, uint64_t demoFileSize, const DemoAnalysis& analysis,
+                          string& error)
+{
+    // Kill indexes of each killer, in tick order like the kills.
+    std::map<uint64_t, std::vector<uint32_t>> killsByPlayer;
+    for (size_t i = 0; i < analysis.kills.size(); i++) {
+        const PlayerKill& kill = analysis.kills[i];
+        if (kill.victimSteamId != kill.killerSteamId) {
+            killsByPlayer[kill.killerSteamId].push_back((uint32_t)i);
+        }
+    }
+    uint32_t playerKillCount = 0;
+    for (const auto& entry : killsByPlayer) {
+        playerKillCount += (uint32_t)entry.second.size();
+    }
+
+    string output = CACHE_FILE_MAGIC;
+    WriteUInt64(output, demoFileSize);
+    WriteUInt64(output, GetDemoChecksumValue(header, demoFileSize));
+    uint64_t tickrateBits;
+    memcpy(&tickrateBits, &analysis.tickrate, sizeof(tickrateBits));
+    WriteUInt64(output, tickrateBits);
+    WriteUInt32(output, (uint32_t)analysis.tickCount);
+    WriteUInt32(output, (uint32_t)analysis.rounds.size());
+    WriteUInt32(output, (uint32_t)analysis.kills.size());
+    WriteUInt32(output, (uint32_t)killsByPlayer.size());
+    WriteUInt32(output, playerKillCount);
+    WriteUInt32(output, 0);
+
+    for (const RoundBoundary& round : analysis.rounds) {
+        WriteUInt64(output, round.startOffset);
+        WriteUInt32(output, (uint32_t)round.startTick);
+        WriteUInt32(output, (uint32_t)round.freezeEndTick);
+        WriteUInt32(output, (uint32_t)round.endTick);
+        WriteUInt32(output, 0);
+    }
+    for (const PlayerKill& kill : analysis.kills) {
+        WriteUInt64(output, kill.killerSteamId);
+        WriteUInt64(output, kill.victimSteamId);
+        WriteUInt32(output, (uint32_t)kill.tick);
+        WriteUInt32(output, (uint32_t)kill.killerSlot);
+        WriteUInt32(output, (uint32_t)kill.victimSlot);
+        WriteUInt32(output, 0);
+    }
+    uint32_t firstKill = 0;
+    for (const auto& entry : killsByPlayer) {
+        WriteUInt64(output, entry.first);
+        WriteUInt32(output, firstKill);
+        WriteUInt32(output, (uint32_t)entry.second.size());
+        firstKill += (uint32_t)entry.second.size();
+    }
+    for (const auto& entry : killsByPlayer) {
+        for (uint32_t killIndex : entry.second) {
+            WriteUInt32(output, killIndex);
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::create_directories(folderPath, errorCode);
+    string path = GetFilePath(header, demoFileSize);
+    // Unique so that processes storing the same demo don't write to the same temporary file.
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%08x.tmp", (unsigned int)std::random_device()());
+    string temporaryPath = path + suffix;
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        error = "Failed to write " + temporaryPath;
+        return false;
+    }
+    file.write(output.data(), output.size());
+    file.close();
+    if (!file) {
+        remove(temporaryPath.c_str());
+        error = "Failed to write " + temporaryPath;
+        return false;
+    }
+
+    // Replaces an existing file on every platform, unlike rename.
+    std::filesystem::rename(temporaryPath, path, errorCode);
+    if (errorCode) {
+        remove(temporaryPath.c_str());
+        error = "Failed to write " + path;
+        return false;
+    }
+
+    return true;
+}
+
+void AnalysisCache::GetSize(uint64_t& fileCount, uint64_t& byteCount) const
+{
+    fileCount = 0;
+    byteCount = 0;
+    std::error_code errorCode;
+    for (std::filesystem::directory_iterator it(folderPath, errorCode), end; !errorCode && it != end;
+         it.increment(errorCode)) {
+        if (it->path().extension() != CACHE_FILE_EXTENSION) {
+            continue;
+        }
+        std::error_code sizeErrorCode;
+        uint64_t size = it->file_size(sizeErrorCode);
+        if (!sizeErrorCode) {
+            fileCount++;
+            byteCount += size;
+        }
+    }
+}
+
+void PrintAnalysisCacheStats(const AnalysisCache& cache)
+{
+    uint64_t fileCount;
+    uint64_t byteCount;
+    cache.GetSize(fileCount, byteCount);
+    uint64_t lookupCount = cache.GetLookupCount();
+    uint64_t hitCount = cache.GetHitCount();
+    fprintf(stderr, "Analysis cache: %llu/%llu hits (%.1f%%), %llu demos, %.2f MB\n", (unsigned long long)hitCount,
+            (unsigned long long)lookupCount, lookupCount > 0 ? hitCount * 100.0 / lookupCount : 0,
+            (unsigned long long)fileCount, byteCount / (1024.0 * 1024.0));
+}
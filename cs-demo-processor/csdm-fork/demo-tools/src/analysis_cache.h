@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "demo_analysis.h"
+#include "demo_header.h"
+#include "player_kills.h"
+
+// Analysis results stored in a folder with one file per demo named after the demo checksum, so a demo submitted again,
+// downloaded twice or reported by several users is only analyzed once. The files have fixed-size records at offsets
+// known from their header and are read in place from a memory mapping: the kills of a player are found with a binary
+// search in the player table without reading the other kills.
+class AnalysisCache
+{
+public:
+    explicit AnalysisCache(const std::string& folderPath) : folderPath(folderPath) {}
+
+    std::string GetFilePath(const DemoHeader& header, uint64_t demoFileSize) const;
+    // Return false if the demo isn't cached, a cache file that is invalid or of another demo is a miss too.
+    bool Load(const DemoHeader& header, uint64_t demoFileSize, DemoAnalysis& analysis);
+    // Same kills as GetPlayerKills on the cached kills, suicides excluded.
+    bool LoadPlayerKills(const DemoHeader& header, uint64_t demoFileSize, uint64_t steamId, PlayerKills& playerKills);
+    // Creates the folder if needed. The file is written to a temporary file first, concurrent writers of the same demo
+    // write the same content.
+    bool Store(const DemoHeader& header, uint64_t demoFileSize, const DemoAnalysis& analysis, std::string& error);
+
+    uint64_t GetHitCount() const { return hitCount; }
+    uint64_t GetLookupCount() const { return lookupCount; }
+    // Number and total size of the cache files in the folder.
+    void GetSize(uint64_t& fileCount, uint64_t& byteCount) const;
+
+private:
+    std::string folderPath;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> lookupCount{0};
+};
+
+// Prints the hit rate and the size of the cache to stderr.
+void PrintAnalysisCacheStats(const AnalysisCache& cache);
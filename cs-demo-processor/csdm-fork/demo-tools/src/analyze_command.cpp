@@ -0,0 +1,217 @@
+// demo-tools analyze <demo or folder>... [--recursive] [--threads N] [--max-memory-mb N] [--cache folder]
+//                    [--output path]
+//
+// Analyzes many demos at once: one demo per thread, every demo read in a single pass for its tickrate, rounds and
+// kills. Each result is written as a JSON line as soon as its demo is done, in completion order, so the caller can start
+// recording the first demos while the others are analyzed.
+// Demos are started from the largest one so that a big demo doesn't run alone at the end, and the total size of the
+// demos mapped at the same time is bounded by --max-memory-mb. With less demos than threads, the remaining threads
+// analyze the segments between the full packets of big CS2 demos in parallel (segmentCount in the result).
+// With --cache, results are stored in the folder by demo checksum and a demo analyzed before is only read for its
+// header (isCached in the result, segmentCount 0), it doesn't count in --max-memory-mb.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <nlohmann/json.hpp>
+#include "analysis_cache.h"
+#include "checksum.h"
+#include "commands.h"
+#include "demo_analysis.h"
+#include "demo_files.h"
+#include "demo_header.h"
+#include "mapped_file.h"
+#include "output.h"
+#include "parallel.h"
+
+using nlohmann::json;
+using std::string;
+
+#define DEFAULT_MAX_MEMORY_MB 2048
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools analyze <demo or folder>... [--recursive] [--threads N] [--max-memory-mb N] "
+                    "[--cache folder] [--output path]\n");
+
+    return 2;
+}
+
+static json GetAnalysisJson(const DemoAnalysis& analysis)
+{
+    json rounds = json::array();
+    for (const RoundBoundary& round : analysis.rounds) {
+        rounds.push_back({
+            {"startTick", round.startTick},
+            {"freezeEndTick", round.freezeEndTick},
+            {"endTick", round.endTick},
+        });
+    }
+
+    json kills = json::array();
+    for (const PlayerKill& kill : analysis.kills) {
+        kills.push_back({
+            {"tick", kill.tick},
+            {"killerSlot", kill.killerSlot},
+            {"killerSteamId", std::to_string(kill.killerSteamId)},
+            {"victimSlot", kill.victimSlot},
+            {"victimSteamId", std::to_string(kill.victimSteamId)},
+        });
+    }
+
+    return {
+        {"tickrate", analysis.tickrate},
+        {"tickCount", analysis.tickCount},
+        {"rounds", rounds},
+        {"kills", kills},
+    };
+}
+
+// cache is null without --cache. The whole demo is read only when it's not cached, its size is reserved in the memory
+// budget for the analysis, a cache hit only reads the header pages of the mapping.
+static json AnalyzeDemoFile(const string& demoPath,
+                            unsigned int threadCount,
+                            AnalysisCache* cache,
+                            MemoryBudget& memoryBudget)
+{
+    json result = {{"path", demoPath}};
+    MappedFile file;
+    DemoHeader header;
+    DemoAnalysis analysis;
+    string error;
+    auto startTime = std::chrono::steady_clock::now();
+    if (!file.Open(demoPath, error) || !ReadDemoHeader(file.Data(), file.Size(), header, error)) {
+        result["error"] = error;
+        return result;
+    }
+
+    bool isCached = cache != nullptr && cache->Load(header, file.Size(), analysis);
+    if (!isCached) {
+        memoryBudget.Acquire(file.Size());
+        bool isAnalyzed = AnalyzeDemo(file.Data(), file.Size(), header, threadCount, analysis, error);
+        memoryBudget.Release(file.Size());
+        if (!isAnalyzed) {
+            result["error"] = error;
+            return result;
+        }
+        // A failed store only costs a new analysis next time.
+        if (cache != nullptr && !cache->Store(header, file.Size(), analysis, error)) {
+            fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+        }
+    }
+
+    result["fileSize"] = file.Size();
+    result["checksum"] = GetDemoChecksum(header, file.Size());
+    result.update(GetAnalysisJson(analysis));
+    result["segmentCount"] = analysis.segmentCount;
+    if (cache != nullptr) {
+        result["isCached"] = isCached;
+    }
+    result["durationMs"] =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    return result;
+}
+
+int RunAnalyzeCommand(int argc, char** argv)
+{
+    std::vector<string> paths;
+    string outputPath;
+    string cachePath;
+    bool isRecursive = false;
+    unsigned int threadCount = GetDefaultThreadCount();
+    uint64_t maxMemoryMb = DEFAULT_MAX_MEMORY_MB;
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--recursive") {
+            isRecursive = true;
+        }
+        else if (arg == "--threads" && hasValue) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "--max-memory-mb" && hasValue) {
+            maxMemoryMb = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--cache" && hasValue) {
+            cachePath = argv[++i];
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() || threadCount == 0 || maxMemoryMb == 0) {
+        return PrintUsage();
+    }
+
+    std::vector<string> demoPaths;
+    string error;
+    if (!CollectDemoPaths(paths, isRecursive, demoPaths, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    JsonLinesWriter writer;
+    if (!writer.Open(outputPath)) {
+        return 2;
+    }
+
+    std::vector<uint64_t> fileSizes(demoPaths.size(), 0);
+    for (size_t i = 0; i < demoPaths.size(); i++) {
+        std::error_code errorCode;
+        uint64_t fileSize = std::filesystem::file_size(demoPaths[i], errorCode);
+        fileSizes[i] = errorCode ? 0 : fileSize;
+    }
+    std::vector<size_t> order(demoPaths.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fileSizes[a] > fileSizes[b]; });
+
+    std::unique_ptr<AnalysisCache> cache;
+    if (!cachePath.empty()) {
+        cache.reset(new AnalysisCache(cachePath));
+    }
+    MemoryBudget memoryBudget(maxMemoryMb * 1024 * 1024);
+    std::atomic<int> errorCount(0);
+    std::atomic<uint64_t> analyzedByteCount(0);
+    auto startTime = std::chrono::steady_clock::now();
+    // Threads left over when there are less demos than threads split the demos.
+    unsigned int demoThreadCount = std::max(1u, threadCount / (unsigned int)std::max<size_t>(demoPaths.size(), 1));
+    ParallelFor(order.size(), threadCount, [&](size_t orderIndex) {
+        size_t index = order[orderIndex];
+        json result = AnalyzeDemoFile(demoPaths[index], demoThreadCount, cache.get(), memoryBudget);
+
+        if (result.contains("error")) {
+            errorCount++;
+        }
+        else {
+            analyzedByteCount += fileSizes[index];
+        }
+        writer.Write(result);
+    });
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    double analyzedMb = analyzedByteCount / (1024.0 * 1024.0);
+    fprintf(stderr,
+            "Analyzed %zu demos (%d errors, %.1f MB) in %.1f ms with %u threads, %.1f demos/min, %.1f MB peak mapped\n",
+            demoPaths.size(), errorCount.load(), analyzedMb, elapsedMs, threadCount,
+            elapsedMs > 0 ? demoPaths.size() * 60000 / elapsedMs : 0,
+            memoryBudget.GetPeakUsage() / (1024.0 * 1024.0));
+    if (cache != nullptr) {
+        PrintAnalysisCacheStats(*cache);
+    }
+
+    return errorCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#include "arena.h"
+
+#define ARENA_ALIGNMENT 8
+
+uint8_t* Arena::Allocate(size_t size)
+{
+    size_t alignedOffset = (offset + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (blocks.empty() || alignedOffset + size > blocks.back().size) {
+        size_t newBlockSize = size > blockSize ? size : blockSize;
+        blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[newBlockSize]), newBlockSize});
+        blockAllocationCount++;
+        alignedOffset = 0;
+    }
+
+    offset = alignedOffset + size;
+
+    return blocks.back().data.get() + alignedOffset;
+}
+
+void Arena::Reset()
+{
+    offset = 0;
+    if (blocks.size() <= 1) {
+        return;
+    }
+
+    // The packet didn't fit in a block, a single block as big as all of them avoids chaining blocks again for the
+    // next packets of this size.
+    size_t capacity = GetCapacity();
+    blocks.clear();
+    blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[capacity]), capacity});
+    blockAllocationCount++;
+}
+
+size_t Arena::GetCapacity() const
+{
+    size_t capacity = 0;
+    for (const Block& block : blocks) {
+        capacity += block.size;
+    }
+
+    return capacity;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+// Bump allocator for the messages decoded from a packet. Allocations are never freed one by one, Reset() forgets all
+// of them at once and keeps the memory for the next packet, so parsing a demo only allocates while packets grow.
+class Arena
+{
+public:
+    explicit Arena(size_t blockSize = ARENA_DEFAULT_BLOCK_SIZE) : blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // The memory is aligned on 8 bytes and stays valid until the next reset.
+    uint8_t* Allocate(size_t size);
+    void Reset();
+    // Number of blocks allocated on the heap since the arena creation.
+    uint64_t GetBlockAllocationCount() const { return blockAllocationCount; }
+    size_t GetCapacity() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    // Position in the last block.
+    size_t offset = 0;
+    uint64_t blockAllocationCount = 0;
+};
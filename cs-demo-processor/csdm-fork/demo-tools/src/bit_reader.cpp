@@ -0,0 +1,204 @@
+#include "bit_reader.h"
+
+// bf_read::ReadBitCoord constants, coordsize.h.
+#define COORD_INTEGER_BITS 14
+#define COORD_FRACTIONAL_BITS 5
+#define COORD_RESOLUTION (1.0 / (1 << COORD_FRACTIONAL_BITS))
+
+void BitReader::RefillTail()
+{
+    while (next < end && cachedBitCount <= 56) {
+        cache |= (uint64_t)*next << cachedBitCount;
+        next++;
+        cachedBitCount += 8;
+    }
+}
+
+void BitReader::SetPosition(size_t position)
+{
+    next = data + (position >> 3);
+    cache = 0;
+    cachedBitCount = 0;
+    if ((position & 7) != 0) {
+        HasCachedBits(8);
+        Consume((int)(position & 7));
+    }
+}
+
+uint32_t BitReader::Overflow()
+{
+    isOverflowed = true;
+    SetPosition(bitCount);
+
+    return 0;
+}
+
+void BitReader::ReadBytes(uint8_t* output, size_t count)
+{
+    if (count * 8 > GetRemainingBits()) {
+        Overflow();
+        memset(output, 0, count);
+        return;
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    size_t position = GetPosition();
+    if ((position & 7) == 0) {
+        memcpy(output, data + (position >> 3), count);
+        SetPosition(position + count * 8);
+        return;
+    }
+
+    // 4 bytes per read, the 32 bits are written as is on little-endian hosts.
+    for (; count >= 4; count -= 4, output += 4) {
+        uint32_t value = ReadBits(32);
+        memcpy(output, &value, 4);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        output[i] = (uint8_t)ReadBits(8);
+    }
+}
+
+void BitReader::ReadBitsToBytes(uint8_t* output, size_t count)
+{
+    ReadBytes(output, count / 8);
+    if (count % 8 != 0) {
+        output[count / 8] = (uint8_t)ReadBits(count % 8);
+    }
+}
+
+std::string BitReader::ReadString()
+{
+    std::string value;
+    while (!isOverflowed) {
+        char character = (char)ReadBits(8);
+        if (character == '\0') {
+            break;
+        }
+        value += character;
+    }
+
+    return value;
+}
+
+void BitReader::SkipBits(size_t count)
+{
+    if (count <= (size_t)cachedBitCount) {
+        Consume((int)count);
+        return;
+    }
+
+    if (count > GetRemainingBits()) {
+        Overflow();
+        return;
+    }
+
+    SetPosition(GetPosition() + count);
+}
+
+uint32_t BitReader::ReadUBitVarFromBits()
+{
+    uint32_t value = ReadBits(6);
+    switch (value & 0x30) {
+    case 0x10:
+        value = (value & 15) | (ReadBits(4) << 4);
+        break;
+    case 0x20:
+        value = (value & 15) | (ReadBits(8) << 4);
+        break;
+    case 0x30:
+        value = (value & 15) | (ReadBits(28) << 4);
+        break;
+    }
+
+    return value;
+}
+
+uint32_t BitReader::ReadVarUInt32FromBits()
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint32_t byte = ReadBits(8);
+        value |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0 || isOverflowed) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+float BitReader::ReadBitCoord()
+{
+    int integerValue = ReadBit();
+    int fractionalValue = ReadBit();
+    if (!integerValue && !fractionalValue) {
+        return 0;
+    }
+
+    bool isNegative = ReadBit();
+    if (integerValue) {
+        integerValue = ReadBits(COORD_INTEGER_BITS) + 1;
+    }
+    if (fractionalValue) {
+        fractionalValue = ReadBits(COORD_FRACTIONAL_BITS);
+    }
+
+    // Same operations as bf_read to get the same float.
+    float value = integerValue + ((float)fractionalValue * COORD_RESOLUTION);
+
+    return isNegative ? -value : value;
+}
+
+// Number of values of up to maxBits bits whose refills stay in the buffer: a refill loads the 8 bytes following the
+// cached bits, which end at most 8 bytes after the position.
+static size_t GetUncheckedBatchSize(size_t remainingBits, int maxBits, size_t count)
+{
+    if (remainingBits < 128) {
+        return 0;
+    }
+
+    size_t batchSize = (remainingBits - 128) / maxBits;
+
+    return batchSize < count ? batchSize : count;
+}
+
+bool BitReader::ReadUBitVars(uint32_t* output, size_t count)
+{
+    size_t batchSize = GetUncheckedBatchSize(GetRemainingBits(), UBITVAR_MAX_BITS, count);
+    size_t index = 0;
+    for (; index < batchSize; index++) {
+        if (cachedBitCount < UBITVAR_MAX_BITS) {
+            RefillUnchecked();
+        }
+        output[index] = ReadCachedUBitVar();
+    }
+
+    for (; index < count; index++) {
+        output[index] = ReadUBitVar();
+    }
+
+    return !isOverflowed;
+}
+
+bool BitReader::ReadVarUInt32s(uint32_t* output, size_t count)
+{
+    size_t batchSize = GetUncheckedBatchSize(GetRemainingBits(), VARINT32_MAX_BITS, count);
+    size_t index = 0;
+    for (; index < batchSize; index++) {
+        if (cachedBitCount < VARINT32_MAX_BITS) {
+            RefillUnchecked();
+        }
+        output[index] = ReadCachedVarUInt32();
+    }
+
+    for (; index < count; index++) {
+        output[index] = ReadVarUInt32();
+    }
+
+    return !isOverflowed;
+}
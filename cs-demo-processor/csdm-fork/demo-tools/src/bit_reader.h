@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "BitReader loads little-endian words directly"
+#endif
+
+// Reads the little-endian bit stream of packets and string tables (bf_read layout), reads past the end return zeros
+// and set the overflow flag.
+// The next bits are kept in a 64-bit cache refilled with a single unaligned 8-byte load when it has less bits than
+// the read needs, so most reads are a mask and a shift. Only the last 8 bytes of the buffer are loaded byte by byte.
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), end(data + size), next(data), bitCount(size * 8) {}
+
+    // Up to 32 bits.
+    uint32_t ReadBits(int count)
+    {
+        if (!HasCachedBits(count)) {
+            return Overflow();
+        }
+
+        uint32_t value = (uint32_t)(cache & GetMask(count));
+        Consume(count);
+
+        return value;
+    }
+    bool ReadBit() { return ReadBits(1) != 0; }
+    void ReadBytes(uint8_t* output, size_t count);
+    // Reads count bits into ceil(count / 8) bytes, the last byte contains the remaining bits.
+    void ReadBitsToBytes(uint8_t* output, size_t count);
+    // Null-terminated string.
+    std::string ReadString();
+    void SkipBits(size_t count);
+    // Message types of Source 2 packets.
+    uint32_t ReadUBitVar()
+    {
+        if (HasCachedBits(UBITVAR_MAX_BITS)) {
+            return ReadCachedUBitVar();
+        }
+
+        return ReadUBitVarFromBits();
+    }
+    uint32_t ReadVarUInt32()
+    {
+        if (HasCachedBits(VARINT32_MAX_BITS)) {
+            return ReadCachedVarUInt32();
+        }
+
+        return ReadVarUInt32FromBits();
+    }
+    float ReadBitCoord();
+    // Bulk decoders, a single range check covers the whole batch instead of one per value when enough data remains,
+    // the cache is then refilled without checking the end of the buffer. Return false if the data is too short.
+    bool ReadUBitVars(uint32_t* output, size_t count);
+    bool ReadVarUInt32s(uint32_t* output, size_t count);
+
+    bool IsOverflowed() const { return isOverflowed; }
+    size_t GetRemainingBits() const { return bitCount - GetPosition(); }
+    size_t GetPosition() const { return (size_t)(next - data) * 8 - cachedBitCount; }
+
+private:
+    static const int UBITVAR_MAX_BITS = 6 + 28;
+    static const int VARINT32_MAX_BITS = 5 * 8;
+
+    static uint64_t GetMask(int count) { return (1ULL << count) - 1; }
+
+    // Returns false if less than count bits remain in the buffer.
+    bool HasCachedBits(int count)
+    {
+        if (cachedBitCount >= count) {
+            return true;
+        }
+
+        if (end - next >= 8) {
+            RefillUnchecked();
+        }
+        else {
+            RefillTail();
+        }
+
+        return cachedBitCount >= count;
+    }
+    // Completes the cache to at least 56 bits, the 8 bytes following next must be in the buffer.
+    void RefillUnchecked()
+    {
+        uint64_t word;
+        memcpy(&word, next, 8);
+        cache |= word << cachedBitCount;
+        // Whole bytes only, the bits of the last byte that didn't fit are loaded again by the next refill.
+        int byteCount = (63 - cachedBitCount) >> 3;
+        next += byteCount;
+        cachedBitCount += byteCount * 8;
+    }
+    void RefillTail();
+    void Consume(int count)
+    {
+        cache >>= count;
+        cachedBitCount -= count;
+    }
+    void SetPosition(size_t position);
+    // The cache must have UBITVAR_MAX_BITS and VARINT32_MAX_BITS bits.
+    uint32_t ReadCachedUBitVar();
+    uint32_t ReadCachedVarUInt32();
+    uint32_t ReadUBitVarFromBits();
+    uint32_t ReadVarUInt32FromBits();
+    uint32_t Overflow();
+
+    const uint8_t* data;
+    const uint8_t* end;
+    // Next byte to load in the cache.
+    const uint8_t* next;
+    size_t bitCount;
+    // The next bits of the stream from the least significant bit, only cachedBitCount bits are valid.
+    uint64_t cache = 0;
+    int cachedBitCount = 0;
+    bool isOverflowed = false;
+};
+
+inline uint32_t BitReader::ReadCachedUBitVar()
+{
+    // Number of bits following the 6 bits of the prefix, depending on its 2 high bits. Looking it up instead of
+    // branching on it avoids mispredictions since message types are spread on the 4 sizes.
+    static const int extraBitCounts[4] = {0, 4, 8, 28};
+    int extraBitCount = extraBitCounts[(cache >> 4) & 3];
+    uint32_t value = (uint32_t)(cache & 15) | (uint32_t)(((cache >> 6) & GetMask(extraBitCount)) << 4);
+    Consume(6 + extraBitCount);
+
+    return value;
+}
+
+inline uint32_t BitReader::ReadCachedVarUInt32()
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 5; i++) {
+        uint32_t byte = (uint32_t)(cache >> (i * 8)) & 0xFF;
+        value |= (byte & 0x7F) << (i * 7);
+        if ((byte & 0x80) == 0) {
+            Consume((i + 1) * 8);
+            return value;
+        }
+    }
+
+    // Like bf_read::ReadVarInt32, the value stops after 5 bytes even if the continuation bit is set.
+    Consume(VARINT32_MAX_BITS);
+    return value;
+}
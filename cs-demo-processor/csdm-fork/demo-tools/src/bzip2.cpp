@@ -0,0 +1,911 @@
+#include "bzip2.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "parallel.h"
+
+using std::string;
+
+// "BZh" followed by the block size in hundreds of KB, '1' to '9'.
+#define STREAM_SIGNATURE 0x425A68
+#define BLOCK_SIZE_UNIT 100000
+// 48-bit magic numbers of the blocks (BCD pi) and of the end of the streams (BCD sqrt(pi)), not byte-aligned.
+#define BLOCK_MAGIC 0x314159265359ULL
+#define END_OF_STREAM_MAGIC 0x177245385090ULL
+#define MIN_GROUPS 2
+#define MAX_GROUPS 6
+#define MAX_ALPHABET_SIZE 258
+#define MAX_CODE_LENGTH 20
+// bzip2 1.0.8 ignores the selectors after this many, the last ones of a block are never used.
+#define MAX_SELECTORS 18002
+// Number of symbols coded with the same Huffman table.
+#define GROUP_SIZE 50
+#define RUN_A 0
+#define RUN_B 1
+#define INPUT_BUFFER_SIZE (64 * 1024)
+
+static std::vector<uint32_t> CreateCrcTable()
+{
+    std::vector<uint32_t> table(256);
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 24;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) != 0 ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+        }
+        table[i] = crc;
+    }
+
+    return table;
+}
+
+// CRC-32 with the bits of each byte most significant first, unlike zlib.
+static const std::vector<uint32_t> crcTable = CreateCrcTable();
+
+// Reads the bits most significant first, pulling the input when the buffered bytes run out.
+class Bzip2BitReader
+{
+public:
+    explicit Bzip2BitReader(const Bzip2Input& input) : input(&input), buffer(INPUT_BUFFER_SIZE) {}
+    // Reads the bytes in memory from the bit position.
+    Bzip2BitReader(const uint8_t* data, size_t size, size_t bitPosition)
+        : next(data + bitPosition / 8), end(data + size), loadedBitCount(bitPosition / 8 * 8)
+    {
+        Refill();
+        Consume((int)(bitPosition & 7));
+    }
+
+    // Up to 32 bits.
+    uint32_t ReadBits(int count)
+    {
+        uint32_t value = PeekBits(count);
+        Consume(count);
+
+        return value;
+    }
+    bool ReadBit() { return ReadBits(1) != 0; }
+    // The bits past the end of the input are zeros.
+    uint32_t PeekBits(int count)
+    {
+        if (cachedBitCount < count) {
+            Refill();
+            if (cachedBitCount < count) {
+                return (uint32_t)((cache << (count - cachedBitCount)) & GetMask(count));
+            }
+        }
+
+        return (uint32_t)((cache >> (cachedBitCount - count)) & GetMask(count));
+    }
+    void Consume(int count)
+    {
+        if (count > cachedBitCount) {
+            isOverflowed = true;
+            cachedBitCount = 0;
+            return;
+        }
+
+        cachedBitCount -= count;
+    }
+    // Bytes are loaded whole, the cache holds a multiple of 8 bits at byte boundaries.
+    void AlignToByte() { Consume(cachedBitCount & 7); }
+    bool IsAtEnd()
+    {
+        Refill();
+
+        return cachedBitCount == 0;
+    }
+    bool IsOverflowed() const { return isOverflowed; }
+    // Number of bits read since the beginning of the input.
+    uint64_t GetPosition() const { return loadedBitCount - cachedBitCount; }
+
+private:
+    static uint64_t GetMask(int count) { return (1ULL << count) - 1; }
+
+    // Completes the cache to more than 56 bits if the input has them.
+    void Refill()
+    {
+        if (end - next >= 8) {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; i++) {
+                word = (word << 8) | next[i];
+            }
+            int byteCount = (63 - cachedBitCount) >> 3;
+            cache = (cache << (byteCount * 8)) | (word >> (64 - byteCount * 8));
+            next += byteCount;
+            cachedBitCount += byteCount * 8;
+            loadedBitCount += byteCount * 8;
+            return;
+        }
+
+        while (cachedBitCount <= 56) {
+            if (next == end && !ReadInput()) {
+                return;
+            }
+            cache = (cache << 8) | *next++;
+            cachedBitCount += 8;
+            loadedBitCount += 8;
+        }
+    }
+    bool ReadInput()
+    {
+        if (input == nullptr || isInputDone) {
+            return false;
+        }
+
+        size_t size = (*input)(buffer.data(), buffer.size());
+        if (size == 0) {
+            isInputDone = true;
+            return false;
+        }
+        next = buffer.data();
+        end = next + size;
+
+        return true;
+    }
+
+    const Bzip2Input* input = nullptr;
+    std::vector<uint8_t> buffer;
+    const uint8_t* next = nullptr;
+    const uint8_t* end = nullptr;
+    uint64_t loadedBitCount = 0;
+    bool isInputDone = false;
+    // The next bits are the cachedBitCount low bits, the first one is the most significant.
+    uint64_t cache = 0;
+    int cachedBitCount = 0;
+    bool isOverflowed = false;
+};
+
+// Canonical Huffman table, codes of the same length are consecutive and ordered by symbol.
+struct HuffmanTable
+{
+    // Largest code of each length, -1 if there are none.
+    int32_t limits[MAX_CODE_LENGTH + 1];
+    // Subtracted from a code to get the index of its symbol in symbols.
+    int32_t bases[MAX_CODE_LENGTH + 1];
+    // Symbols sorted by code length.
+    uint16_t symbols[MAX_ALPHABET_SIZE];
+    int minLength;
+    int maxLength;
+};
+
+// Decodes the blocks of a stream, the buffers are kept from block to block.
+class Bzip2BlockDecoder
+{
+public:
+    // Decodes the block following a block magic and checks its CRC.
+    bool Decode(Bzip2BitReader& reader, uint32_t maxBlockSize, std::vector<uint8_t>& output, uint32_t& crc,
+                string& error);
+
+private:
+    bool ReadTables(Bzip2BitReader& reader, string& error);
+    void CreateTable(const uint8_t* lengths, HuffmanTable& table);
+    bool ReadSymbols(Bzip2BitReader& reader, uint32_t maxBlockSize, string& error);
+    // Inverts the Burrows-Wheeler transform and the initial run-length encoding.
+    void WriteBlock(std::vector<uint8_t>& output, uint32_t& crc);
+
+    int alphabetSize = 0;
+    uint8_t symbolBytes[256];
+    int groupCount = 0;
+    std::vector<uint8_t> selectors;
+    HuffmanTable tables[MAX_GROUPS];
+    uint32_t originPointer = 0;
+    // Bytes of the Burrows-Wheeler transform in the low 8 bits, then the index of the next byte in the high bits.
+    std::vector<uint32_t> transform;
+    uint32_t blockSize = 0;
+    uint32_t byteCounts[256];
+};
+
+bool Bzip2BlockDecoder::Decode(Bzip2BitReader& reader, uint32_t maxBlockSize, std::vector<uint8_t>& output,
+                               uint32_t& crc, string& error)
+{
+    uint32_t expectedCrc = reader.ReadBits(32);
+    // Randomization was removed from the compressor in bzip2 0.9.5.
+    if (reader.ReadBit()) {
+        error = "Randomized bzip2 blocks are not supported";
+        return false;
+    }
+    originPointer = reader.ReadBits(24);
+
+    if (!ReadTables(reader, error) || !ReadSymbols(reader, maxBlockSize, error)) {
+        return false;
+    }
+
+    if (originPointer >= blockSize) {
+        error = "Invalid bzip2 block origin";
+        return false;
+    }
+
+    WriteBlock(output, crc);
+    if (crc != expectedCrc) {
+        error = "bzip2 block CRC mismatch";
+        return false;
+    }
+
+    return true;
+}
+
+bool Bzip2BlockDecoder::ReadTables(Bzip2BitReader& reader, string& error)
+{
+    // Bytes used in the block, a bitmap of 16 ranges followed by the bitmaps of the used ranges.
+    int usedByteCount = 0;
+    uint32_t usedRanges = reader.ReadBits(16);
+    for (int range = 0; range < 16; range++) {
+        if ((usedRanges & (0x8000 >> range)) == 0) {
+            continue;
+        }
+        uint32_t usedBytes = reader.ReadBits(16);
+        for (int i = 0; i < 16; i++) {
+            if ((usedBytes & (0x8000 >> i)) != 0) {
+                symbolBytes[usedByteCount++] = (uint8_t)(range * 16 + i);
+            }
+        }
+    }
+    if (usedByteCount == 0) {
+        error = "Invalid bzip2 byte map";
+        return false;
+    }
+    // The move-to-front indexes from 1, RUN_A and RUN_B replace 0, and the end of block symbol.
+    alphabetSize = usedByteCount + 2;
+
+    groupCount = (int)reader.ReadBits(3);
+    uint32_t selectorCount = reader.ReadBits(15);
+    if (groupCount < MIN_GROUPS || groupCount > MAX_GROUPS || selectorCount == 0) {
+        error = "Invalid bzip2 Huffman groups";
+        return false;
+    }
+
+    // Move-to-front coded in unary.
+    uint8_t groupOrder[MAX_GROUPS];
+    for (int i = 0; i < groupCount; i++) {
+        groupOrder[i] = (uint8_t)i;
+    }
+    selectors.resize(selectorCount < MAX_SELECTORS ? selectorCount : MAX_SELECTORS);
+    for (uint32_t i = 0; i < selectorCount; i++) {
+        int index = 0;
+        while (reader.ReadBit()) {
+            if (++index >= groupCount) {
+                error = "Invalid bzip2 selector";
+                return false;
+            }
+        }
+        uint8_t group = groupOrder[index];
+        memmove(groupOrder + 1, groupOrder, index);
+        groupOrder[0] = group;
+        if (i < MAX_SELECTORS) {
+            selectors[i] = group;
+        }
+    }
+
+    // Code lengths, delta coded from a 5-bit start.
+    for (int group = 0; group < groupCount; group++) {
+        uint8_t lengths[MAX_ALPHABET_SIZE];
+        int length = (int)reader.ReadBits(5);
+        for (int symbol = 0; symbol < alphabetSize; symbol++) {
+            while (true) {
+                if (length < 1 || length > MAX_CODE_LENGTH) {
+                    error = "Invalid bzip2 code length";
+                    return false;
+                }
+                if (!reader.ReadBit()) {
+                    break;
+                }
+                length += reader.ReadBit() ? -1 : 1;
+            }
+            lengths[symbol] = (uint8_t)length;
+        }
+        CreateTable(lengths, tables[group]);
+    }
+
+    if (reader.IsOverflowed()) {
+        error = "Truncated bzip2 block";
+        return false;
+    }
+
+    return true;
+}
+
+void Bzip2BlockDecoder::CreateTable(const uint8_t* lengths, HuffmanTable& table)
+{
+    table.minLength = MAX_CODE_LENGTH;
+    table.maxLength = 0;
+    int lengthCounts[MAX_CODE_LENGTH + 1] = {};
+    for (int symbol = 0; symbol < alphabetSize; symbol++) {
+        lengthCounts[lengths[symbol]]++;
+        table.minLength = lengths[symbol] < table.minLength ? lengths[symbol] : table.minLength;
+        table.maxLength = lengths[symbol] > table.maxLength ? lengths[symbol] : table.maxLength;
+    }
+
+    int index = 0;
+    for (int length = table.minLength; length <= table.maxLength; length++) {
+        for (int symbol = 0; symbol < alphabetSize; symbol++) {
+            if (lengths[symbol] == length) {
+                table.symbols[index++] = (uint16_t)symbol;
+            }
+        }
+    }
+
+    int32_t code = 0;
+    int32_t firstIndex = 0;
+    for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+        table.bases[length] = code - firstIndex;
+        code += lengthCounts[length];
+        firstIndex += lengthCounts[length];
+        table.limits[length] = code - 1;
+        code <<= 1;
+    }
+}
+
+bool Bzip2BlockDecoder::ReadSymbols(Bzip2BitReader& reader, uint32_t maxBlockSize, string& error)
+{
+    if (transform.size() < maxBlockSize) {
+        transform.resize(maxBlockSize);
+    }
+    memset(byteCounts, 0, sizeof(byteCounts));
+    uint8_t order[256];
+    for (int i = 0; i < 256; i++) {
+        order[i] = (uint8_t)i;
+    }
+
+    int endOfBlock = alphabetSize - 1;
+    size_t selectorIndex = 0;
+    int groupRemaining = 0;
+    const HuffmanTable* table = nullptr;
+    // Runs of the first byte of the move-to-front list, the count is written in bijective base 2 with RUN_A and RUN_B
+    // as digits, least significant first.
+    uint32_t runLength = 0;
+    uint32_t runWeight = 1;
+    blockSize = 0;
+    while (true) {
+        if (groupRemaining == 0) {
+            // The bits past the end are zeros, checked once per group so a truncated block doesn't decode them.
+            if (reader.IsOverflowed()) {
+                error = "Truncated bzip2 block";
+                return false;
+            }
+            if (selectorIndex >= selectors.size()) {
+                error = "Missing bzip2 selectors";
+                return false;
+            }
+            table = &tables[selectors[selectorIndex++]];
+            groupRemaining = GROUP_SIZE;
+        }
+        groupRemaining--;
+
+        uint32_t bits = reader.PeekBits(table->maxLength);
+        int length = table->minLength;
+        int32_t code = (int32_t)(bits >> (table->maxLength - length));
+        while (code > table->limits[length]) {
+            if (++length > table->maxLength) {
+                error = "Invalid bzip2 Huffman code";
+                return false;
+            }
+            code = (int32_t)(bits >> (table->maxLength - length));
+        }
+        reader.Consume(length);
+        int symbol = table->symbols[code - table->bases[length]];
+
+        if (symbol <= RUN_B) {
+            runLength += runWeight << symbol;
+            runWeight <<= 1;
+            if (runLength > maxBlockSize) {
+                error = "bzip2 block too big";
+                return false;
+            }
+            continue;
+        }
+
+        if (runLength > 0) {
+            if (blockSize + runLength > maxBlockSize) {
+                error = "bzip2 block too big";
+                return false;
+            }
+            uint8_t byte = symbolBytes[order[0]];
+            byteCounts[byte] += runLength;
+            std::fill(transform.begin() + blockSize, transform.begin() + blockSize + runLength, byte);
+            blockSize += runLength;
+            runLength = 0;
+            runWeight = 1;
+        }
+
+        if (symbol == endOfBlock) {
+            break;
+        }
+
+        if (blockSize >= maxBlockSize) {
+            error = "bzip2 block too big";
+            return false;
+        }
+        int index = symbol - 1;
+        uint8_t byteIndex = order[index];
+        memmove(order + 1, order, index);
+        order[0] = byteIndex;
+        uint8_t byte = symbolBytes[byteIndex];
+        byteCounts[byte]++;
+        transform[blockSize++] = byte;
+    }
+
+    if (reader.IsOverflowed()) {
+        error = "Truncated bzip2 block";
+        return false;
+    }
+
+    return true;
+}
+
+void Bzip2BlockDecoder::WriteBlock(std::vector<uint8_t>& output, uint32_t& crc)
+{
+    // Links each byte to the next one of the original data: the n-th occurrence of a byte in the sorted rotations is
+    // its n-th occurrence in the transform.
+    uint32_t sortedIndexes[256];
+    uint32_t index = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        sortedIndexes[byte] = index;
+        index += byteCounts[byte];
+    }
+    for (uint32_t i = 0; i < blockSize; i++) {
+        transform[sortedIndexes[transform[i] & 0xFF]++] |= i << 8;
+    }
+
+    // Runs of 4 to 255 + 4 bytes are written as 4 bytes followed by the number of additional bytes.
+    output.clear();
+    output.reserve(blockSize);
+    crc = 0xFFFFFFFF;
+    uint32_t position = transform[originPointer] >> 8;
+    int runLength = 0;
+    int previousByte = -1;
+    for (uint32_t i = 0; i < blockSize; i++) {
+        position = transform[position];
+        uint8_t byte = (uint8_t)position;
+        position >>= 8;
+
+        if (runLength == 4) {
+            for (int j = 0; j < byte; j++) {
+                output.push_back((uint8_t)previousByte);
+                crc = (crc << 8) ^ crcTable[(crc >> 24) ^ (uint8_t)previousByte];
+            }
+            runLength = 0;
+            continue;
+        }
+
+        output.push_back(byte);
+        crc = (crc << 8) ^ crcTable[(crc >> 24) ^ byte];
+        if (byte == previousByte) {
+            runLength++;
+        }
+        else {
+            previousByte = byte;
+            runLength = 1;
+        }
+    }
+    crc = ~crc;
+}
+
+static uint64_t ReadMagic(Bzip2BitReader& reader)
+{
+    uint64_t high = reader.ReadBits(24);
+
+    return (high << 24) | reader.ReadBits(24);
+}
+
+bool Bzip2Decompress(const Bzip2Input& input, const Bzip2Output& output, string& error)
+{
+    Bzip2BitReader reader(input);
+    Bzip2BlockDecoder decoder;
+    std::vector<uint8_t> block;
+    bool isFirstStream = true;
+    while (isFirstStream || !reader.IsAtEnd()) {
+        isFirstStream = false;
+        uint32_t signature = reader.ReadBits(24);
+        uint32_t level = reader.ReadBits(8);
+        if (signature != STREAM_SIGNATURE || level < '1' || level > '9') {
+            error = "Invalid bzip2 stream header";
+            return false;
+        }
+        uint32_t maxBlockSize = (level - '0') * BLOCK_SIZE_UNIT;
+
+        // The stream CRC combines the CRCs of its blocks.
+        uint32_t streamCrc = 0;
+        while (true) {
+            uint64_t magic = ReadMagic(reader);
+            if (reader.IsOverflowed()) {
+                error = "Truncated bzip2 stream";
+                return false;
+            }
+
+            if (magic == END_OF_STREAM_MAGIC) {
+                uint32_t expectedCrc = reader.ReadBits(32);
+                if (reader.IsOverflowed()) {
+                    error = "Truncated bzip2 stream";
+                    return false;
+                }
+                if (expectedCrc != streamCrc) {
+                    error = "bzip2 stream CRC mismatch";
+                    return false;
+                }
+                // The next stream starts on a byte boundary.
+                reader.AlignToByte();
+                break;
+            }
+
+            if (magic != BLOCK_MAGIC) {
+                error = "Invalid bzip2 block magic";
+                return false;
+            }
+
+            uint32_t blockCrc;
+            if (!decoder.Decode(reader, maxBlockSize, block, blockCrc, error)) {
+                return false;
+            }
+            streamCrc = ((streamCrc << 1) | (streamCrc >> 31)) ^ blockCrc;
+            if (!output(block.data(), block.size(), error)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// For each value of 2 bytes, the bit offsets in the previous byte at which a magic number can start for these bytes to
+// follow: a magic number starting at bit s of a byte has its bits 8 - s to 23 - s in the next 2 bytes. Less than 1
+// position in 2000 has to be compared with the magic numbers.
+static std::vector<uint8_t> CreateMagicOffsetTable()
+{
+    std::vector<uint8_t> table(65536, 0);
+    for (uint64_t magic : {BLOCK_MAGIC, END_OF_STREAM_MAGIC}) {
+        for (int offset = 0; offset < 8; offset++) {
+            table[(magic >> (24 + offset)) & 0xFFFF] |= (uint8_t)(1 << offset);
+        }
+    }
+
+    return table;
+}
+
+static const std::vector<uint8_t> magicOffsetTable = CreateMagicOffsetTable();
+
+// Reads up to 48 bits at the bit position.
+static uint64_t ReadBitsAt(const uint8_t* data, size_t bitPosition, int count)
+{
+    size_t lastByte = (bitPosition + count - 1) / 8;
+    uint64_t word = 0;
+    for (size_t index = bitPosition / 8; index <= lastByte; index++) {
+        word = (word << 8) | data[index];
+    }
+
+    return (word >> ((lastByte + 1) * 8 - bitPosition - count)) & ((1ULL << count) - 1);
+}
+
+static bool IsStreamHeader(const uint8_t* data)
+{
+    return data[0] == 'B' && data[1] == 'Z' && data[2] == 'h' && data[3] >= '1' && data[3] <= '9';
+}
+
+// Finds the first block or end of stream magic number at or after the bit position. Otherwise returns false, the
+// positions before scannedBitPosition don't have to be scanned again once more data is available.
+static bool FindMagic(const uint8_t* data, size_t size, size_t bitPosition, size_t& magicPosition,
+                      uint64_t& magic, size_t& scannedBitPosition)
+{
+    size_t index = bitPosition / 8 + 1;
+    for (; index + 5 < size; index++) {
+        uint8_t offsets = magicOffsetTable[(data[index] << 8) | data[index + 1]];
+        for (int offset = 0; offsets != 0; offset++, offsets >>= 1) {
+            size_t position = (index - 1) * 8 + offset;
+            if ((offsets & 1) == 0 || position < bitPosition) {
+                continue;
+            }
+            uint64_t value = ReadBitsAt(data, position, 48);
+            if (value == BLOCK_MAGIC || value == END_OF_STREAM_MAGIC) {
+                magicPosition = position;
+                magic = value;
+                return true;
+            }
+        }
+    }
+    scannedBitPosition = (index - 1) * 8;
+
+    return false;
+}
+
+// Compressed block or end of stream, in stream order.
+struct ParallelBlock
+{
+    // Bytes from the one containing the first bit of the block magic number to the one containing the last bit
+    // before the next magic number.
+    std::vector<uint8_t> data;
+    // Bit positions in data of the magic number of the block and of the next one.
+    size_t startBit = 0;
+    size_t endBit = 0;
+    uint32_t maxBlockSize = 0;
+    // End of stream markers only carry the CRC of the stream.
+    bool isStreamEnd = false;
+    uint32_t streamCrc = 0;
+
+    // Set by the decoding thread.
+    bool isDecoded = false;
+    bool isValid = false;
+    std::vector<uint8_t> output;
+    uint32_t crc = 0;
+    string error;
+};
+
+// Decodes a block that must end at the next magic number.
+static bool DecodeBlock(const std::vector<uint8_t>& data, size_t startBit, size_t endBit, uint32_t maxBlockSize,
+                        std::vector<uint8_t>& output, uint32_t& crc, string& error)
+{
+    Bzip2BitReader reader(data.data(), data.size(), startBit + 48);
+    Bzip2BlockDecoder decoder;
+    if (!decoder.Decode(reader, maxBlockSize, output, crc, error)) {
+        return false;
+    }
+
+    if (reader.GetPosition() != endBit) {
+        error = "Invalid bzip2 block end";
+        return false;
+    }
+
+    return true;
+}
+
+class ParallelBzip2Decompressor
+{
+public:
+    ParallelBzip2Decompressor(const Bzip2Input& input, const Bzip2Output& output, unsigned int threadCount)
+        : input(input), output(output), maxBlockCount(threadCount * 2), pool(threadCount)
+    {
+    }
+
+    bool Decompress(string& error);
+
+private:
+    bool ReadInput();
+    // Returns false if the input ends first.
+    bool ReadUntil(size_t size);
+    bool FindBlockEnd(size_t blockPosition, size_t& endPosition, string& error);
+    bool Submit(const std::shared_ptr<ParallelBlock>& block, string& error);
+    bool WriteNextBlock(string& error);
+    bool DecodeWithNextBlocks(ParallelBlock& block, string& error);
+
+    const Bzip2Input& input;
+    const Bzip2Output& output;
+    size_t maxBlockCount;
+    // Input from the stream position being parsed.
+    std::vector<uint8_t> buffer;
+    bool isInputDone = false;
+    // Submitted blocks not written yet, in stream order.
+    std::deque<std::shared_ptr<ParallelBlock>> blocks;
+    std::mutex mutex;
+    std::condition_variable decoded;
+    uint32_t streamCrc = 0;
+    // Last member, its destructor waits for the decoding threads which use the other members.
+    ThreadPool pool;
+};
+
+bool ParallelBzip2Decompressor::ReadInput()
+{
+    if (isInputDone) {
+        return false;
+    }
+
+    size_t size = buffer.size();
+    buffer.resize(size + INPUT_BUFFER_SIZE);
+    size_t readSize = input(buffer.data() + size, INPUT_BUFFER_SIZE);
+    buffer.resize(size + readSize);
+    isInputDone = readSize == 0;
+
+    return !isInputDone;
+}
+
+bool ParallelBzip2Decompressor::ReadUntil(size_t size)
+{
+    while (buffer.size() < size) {
+        if (!ReadInput()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// A block ends at the next block magic number or at the end of stream magic number followed by the CRC of the stream
+// and the end of the input or another stream. Matches inside the compressed data are possible and handled when the
+// blocks are written.
+bool ParallelBzip2Decompressor::FindBlockEnd(size_t blockPosition, size_t& endPosition, string& error)
+{
+    size_t scanPosition = blockPosition + 48;
+    while (true) {
+        uint64_t magic;
+        size_t scannedPosition;
+        if (!FindMagic(buffer.data(), buffer.size(), scanPosition, endPosition, magic, scannedPosition)) {
+            scanPosition = scannedPosition > scanPosition ? scannedPosition : scanPosition;
+            if (!ReadInput()) {
+                error = "Truncated bzip2 stream";
+                return false;
+            }
+            continue;
+        }
+
+        if (magic == BLOCK_MAGIC) {
+            return true;
+        }
+
+        size_t streamEnd = (endPosition + 48 + 32 + 7) / 8;
+        bool hasNextStream = ReadUntil(streamEnd + 4);
+        if ((hasNextStream && IsStreamHeader(buffer.data() + streamEnd))
+            || (!hasNextStream && buffer.size() == streamEnd)) {
+            return true;
+        }
+        scanPosition = endPosition + 1;
+    }
+}
+
+bool ParallelBzip2Decompressor::Submit(const std::shared_ptr<ParallelBlock>& block, string& error)
+{
+    while (blocks.size() >= maxBlockCount) {
+        if (!WriteNextBlock(error)) {
+            return false;
+        }
+    }
+
+    blocks.push_back(block);
+    if (block->isStreamEnd) {
+        block->isDecoded = true;
+        return true;
+    }
+
+    pool.Submit([this, block]() {
+        std::vector<uint8_t> blockOutput;
+        uint32_t crc = 0;
+        string blockError;
+        bool isValid =
+            DecodeBlock(block->data, block->startBit, block->endBit, block->maxBlockSize, blockOutput, crc, blockError);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        block->output = std::move(blockOutput);
+        block->crc = crc;
+        block->error = blockError;
+        block->isValid = isValid;
+        block->isDecoded = true;
+        decoded.notify_all();
+    });
+
+    return true;
+}
+
+// A match of a magic number in the compressed data cuts its block in two. The block is decoded again with the data of
+// the next blocks until it ends at a magic number.
+bool ParallelBzip2Decompressor::DecodeWithNextBlocks(ParallelBlock& block, string& error)
+{
+    std::vector<uint8_t> data = block.data;
+    size_t endBit = block.endBit;
+    while (!blocks.empty() && !blocks.front()->isStreamEnd) {
+        // The next block starts in the byte containing the end of this one.
+        const ParallelBlock& nextBlock = *blocks.front();
+        data.resize(endBit / 8);
+        data.insert(data.end(), nextBlock.data.begin(), nextBlock.data.end());
+        endBit = endBit / 8 * 8 + nextBlock.endBit;
+        blocks.pop_front();
+
+        string mergeError;
+        if (DecodeBlock(data, block.startBit, endBit, block.maxBlockSize, block.output, block.crc, mergeError)) {
+            return true;
+        }
+    }
+
+    error = block.error;
+    return false;
+}
+
+bool ParallelBzip2Decompressor::WriteNextBlock(string& error)
+{
+    std::shared_ptr<ParallelBlock> block = blocks.front();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        decoded.wait(lock, [&]() { return block->isDecoded; });
+    }
+    blocks.pop_front();
+
+    if (block->isStreamEnd) {
+        if (block->streamCrc != streamCrc) {
+            error = "bzip2 stream CRC mismatch";
+            return false;
+        }
+        streamCrc = 0;
+        return true;
+    }
+
+    if (!block->isValid && !DecodeWithNextBlocks(*block, error)) {
+        return false;
+    }
+    streamCrc = ((streamCrc << 1) | (streamCrc >> 31)) ^ block->crc;
+
+    return output(block->output.data(), block->output.size(), error);
+}
+
+bool ParallelBzip2Decompressor::Decompress(string& error)
+{
+    // Bit position in the buffer, the bytes before it are discarded after each block.
+    size_t position = 0;
+    bool isFirstStream = true;
+    while (true) {
+        // Streams start on a byte boundary.
+        if (!ReadUntil(4)) {
+            if (!isFirstStream && buffer.empty()) {
+                break;
+            }
+            error = "Invalid bzip2 stream header";
+            return false;
+        }
+        if (!IsStreamHeader(buffer.data())) {
+            error = "Invalid bzip2 stream header";
+            return false;
+        }
+        isFirstStream = false;
+        uint32_t maxBlockSize = (buffer[3] - '0') * BLOCK_SIZE_UNIT;
+        position = 32;
+
+        while (true) {
+            if (!ReadUntil((position + 48 + 7) / 8)) {
+                error = "Truncated bzip2 stream";
+                return false;
+            }
+
+            std::shared_ptr<ParallelBlock> block = std::make_shared<ParallelBlock>();
+            uint64_t magic = ReadBitsAt(buffer.data(), position, 48);
+            size_t endPosition;
+            if (magic == END_OF_STREAM_MAGIC) {
+                if (!ReadUntil((position + 48 + 32 + 7) / 8)) {
+                    error = "Truncated bzip2 stream";
+                    return false;
+                }
+                block->isStreamEnd = true;
+                block->streamCrc = (uint32_t)ReadBitsAt(buffer.data(), position + 48, 32);
+                endPosition = (position + 48 + 32 + 7) / 8 * 8;
+            }
+            else if (magic != BLOCK_MAGIC) {
+                error = "Invalid bzip2 block magic";
+                return false;
+            }
+            else if (!FindBlockEnd(position, endPosition, error)) {
+                return false;
+            }
+            else {
+                block->data.assign(buffer.begin() + position / 8, buffer.begin() + (endPosition + 7) / 8);
+                block->startBit = position & 7;
+                block->endBit = endPosition - position / 8 * 8;
+                block->maxBlockSize = maxBlockSize;
+            }
+
+            if (!Submit(block, error)) {
+                return false;
+            }
+            buffer.erase(buffer.begin(), buffer.begin() + endPosition / 8);
+            position = endPosition & 7;
+            if (block->isStreamEnd) {
+                break;
+            }
+        }
+    }
+
+    while (!blocks.empty()) {
+        if (!WriteNextBlock(error)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Bzip2DecompressParallel(const Bzip2Input& input, const Bzip2Output& output, unsigned int threadCount,
+                             string& error)
+{
+    if (threadCount <= 1) {
+        return Bzip2Decompress(input, output, error);
+    }
+
+    ParallelBzip2Decompressor decompressor(input, output, threadCount);
+
+    return decompressor.Decompress(error);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Reads up to size bytes of compressed data into the buffer, blocks until some are available. Returns 0 at the end.
+typedef std::function<size_t(uint8_t* buffer, size_t size)> Bzip2Input;
+// Receives the decompressed data in order. Returns false with the error to stop the decompression.
+typedef std::function<bool(const uint8_t* data, size_t size, std::string& error)> Bzip2Output;
+
+// Decompresses .bz2 data, the format of Valve replay archives, while it's read: each block (up to 900 KB of input
+// before the run-length encoding) is written as soon as its last bit is read. Concatenated streams like the ones of
+// pbzip2 are decompressed one after the other. The CRCs of the blocks and of the streams are checked.
+bool Bzip2Decompress(const Bzip2Input& input, const Bzip2Output& output, std::string& error);
+// Same result as Bzip2Decompress with the blocks decoded by up to threadCount threads. Blocks are found by scanning
+// for their magic number since they are not byte-aligned, each one is decoded as soon as the next magic number is
+// read and the output is written in order from the calling thread. At most 2 blocks per thread are held in memory,
+// the input isn't read ahead further.
+bool Bzip2DecompressParallel(const Bzip2Input& input, const Bzip2Output& output, unsigned int threadCount,
+                             std::string& error);
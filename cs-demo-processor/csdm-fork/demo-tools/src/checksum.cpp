@@ -0,0 +1,61 @@
+#include "checksum.h"
+#include <cinttypes>
+#include <cstdio>
+
+using std::string;
+using std::to_string;
+
+#define CRC64_POLYNOMIAL 0xC96C5795D7870F42ULL
+
+struct Crc64Table
+{
+    uint64_t values[256];
+
+    Crc64Table()
+    {
+        for (int i = 0; i < 256; i++) {
+            uint64_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC64_POLYNOMIAL : crc >> 1;
+            }
+            values[i] = crc;
+        }
+    }
+};
+
+static const Crc64Table crc64Table;
+
+uint64_t Crc64(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t crc = ~0ULL;
+    for (size_t i = 0; i < size; i++) {
+        crc = crc64Table.values[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+uint64_t GetDemoChecksumValue(const DemoHeader& header, uint64_t fileSize)
+{
+    string data;
+    if (header.source == DemoSource::SOURCE_1) {
+        data = header.mapName + header.serverName + header.clientName + to_string(header.playbackFrames)
+            + to_string(header.playbackTicks) + to_string(header.networkProtocol) + to_string(header.signonLength)
+            + to_string(fileSize);
+    }
+    else {
+        data = header.mapName + header.serverName + header.clientName + to_string(header.networkProtocol)
+            + to_string(header.buildNumber) + header.demoVersionGuid + header.demoVersionName + to_string(fileSize);
+    }
+
+    return Crc64(data.data(), data.size());
+}
+
+string GetDemoChecksum(const DemoHeader& header, uint64_t fileSize)
+{
+    char checksum[17];
+    snprintf(checksum, sizeof(checksum), "%" PRIx64, GetDemoChecksumValue(header, fileSize));
+
+    return checksum;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "demo_header.h"
+
+// CRC-64/XZ (ECMA-182 polynomial, reflected), the variant of the crc64-ecma package used by the app.
+uint64_t Crc64(const void* data, size_t size);
+// Same formula as src/node/demo/get-demo-checksum-from-file-stats.ts.
+uint64_t GetDemoChecksumValue(const DemoHeader& header, uint64_t fileSize);
+// Lowercase hex without leading zeros, like the app.
+std::string GetDemoChecksum(const DemoHeader& header, uint64_t fileSize);
@@ -0,0 +1,11 @@
+#pragma once
+
+// Each command receives the arguments following its name and returns the process exit code.
+int RunAnalyzeCommand(int argc, char** argv);
+int RunDecompressCommand(int argc, char** argv);
+int RunHeaderCommand(int argc, char** argv);
+int RunHighlightsCommand(int argc, char** argv);
+int RunIndexCommand(int argc, char** argv);
+int RunParseCommand(int argc, char** argv);
+int RunSeekCommand(int argc, char** argv);
+int RunUnpackCommand(int argc, char** argv);
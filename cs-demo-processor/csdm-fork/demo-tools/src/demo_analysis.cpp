@@ -0,0 +1,383 @@
+#include "demo_analysis.h"
+#include <algorithm>
+#include "demo_commands.h"
+#include "game_events.h"
+#include "parallel.h"
+#include "players.h"
+#include "protobuf.h"
+#include "string_tables.h"
+
+using std::string;
+
+// svc_ServerInfo from the Source 1 and Source 2 netmessages.proto and its tick_interval field number.
+#define S1_SVC_SERVER_INFO 8
+#define S1_FIELD_TICK_INTERVAL 14
+#define S2_SVC_SERVER_INFO 40
+#define S2_FIELD_TICK_INTERVAL 13
+
+// Every segment after the first one replays the signon data, smaller segments wouldn't pay off.
+#define MIN_SEGMENT_SIZE (4 * 1024 * 1024)
+// Segments don't take the same time, having more segments than threads keeps all the threads busy until the end.
+#define SEGMENTS_PER_THREAD 2
+
+#define NO_OFFSET UINT64_MAX
+
+// Result of the commands between 2 full packets.
+struct SegmentAnalysis
+{
+    explicit SegmentAnalysis(DemoSource source) : startPlayers(source), endPlayers(source) {}
+
+    DemoAnalysis analysis;
+    // round_freeze_end and round_end events before the first round_start, they end the last round of the previous
+    // segment.
+    int32_t leadingFreezeEndTick = -1;
+    int32_t leadingEndTick = -1;
+    bool hasPlayerDeathEvent = false;
+    // The players a segment starts with come from the string tables snapshot of its full packet, they must be the
+    // players the previous segment ends with.
+    PlayerList startPlayers;
+    PlayerList endPlayers;
+    // False if the segment doesn't start with a players snapshot or changes what the following segments got from the
+    // signon data: game event descriptors, string tables or server info.
+    bool isMergeable = true;
+};
+
+// State of the analysis carried from command to command.
+class DemoAnalyzer
+{
+public:
+    explicit DemoAnalyzer(DemoSource source);
+    DemoAnalyzer(const DemoAnalyzer&) = delete;
+    DemoAnalyzer& operator=(const DemoAnalyzer&) = delete;
+
+    // Analyzes the commands of the reader until the command at the end offset, which is read but not analyzed. The
+    // signon data ends at the first full packet, state changes from there make the segment unmergeable.
+    void Analyze(DemoCommandReader& reader, uint64_t endOffset, uint64_t signonEndOffset, SegmentAnalysis& segment);
+    // Replaces the players with the userinfo snapshot of a full packet.
+    bool LoadPlayersSnapshot(const DemoCommand& fullPacket);
+    const PlayerList& GetPlayers() const { return players; }
+
+private:
+    void HandleMessage(uint32_t type, const uint8_t* data, size_t size);
+    void HandleGameEvent(const uint8_t* data, size_t size);
+    bool IsSignonStateMessage(uint32_t type) const;
+
+    DemoSource source;
+    uint32_t serverInfoType;
+    uint32_t eventListType;
+    uint32_t eventType;
+    double tickrate = DEFAULT_TICKRATE;
+    PlayerList players;
+    StringTables stringTables;
+    GameEventList eventList;
+    int32_t playerDeathId = -1;
+    int32_t roundStartId = -1;
+    int32_t roundFreezeEndId = -1;
+    int32_t roundEndId = -1;
+    int userIdKeyIndex = -1;
+    int attackerKeyIndex = -1;
+    std::vector<GameEventKey> keys;
+    PacketBuffers buffers;
+    // Built once, converting the lambdas for every packet would allocate.
+    NetMessageFilter filter;
+    NetMessageHandler handler;
+    DemoCommand command;
+    SegmentAnalysis* segment = nullptr;
+    bool isAfterSignon = false;
+};
+
+static float ReadTickInterval(DemoSource source, const uint8_t* data, size_t size)
+{
+    uint32_t fieldNumber = source == DemoSource::SOURCE_1 ? S1_FIELD_TICK_INTERVAL : S2_FIELD_TICK_INTERVAL;
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == fieldNumber && field.wireType == WIRE_TYPE_FIXED32) {
+            return field.GetFloat();
+        }
+    }
+
+    return 0;
+}
+
+DemoAnalyzer::DemoAnalyzer(DemoSource source)
+    : source(source),
+      serverInfoType(source == DemoSource::SOURCE_1 ? S1_SVC_SERVER_INFO : S2_SVC_SERVER_INFO),
+      eventListType(GetGameEventListMessageType(source)),
+      eventType(GetGameEventMessageType(source)),
+      players(source),
+      stringTables(source, "userinfo", [this](int32_t index, const string&, const uint8_t* value, size_t valueSize) {
+          players.Update(index, value, valueSize);
+      })
+{
+    filter = [this](uint32_t type) {
+        return type == serverInfoType || type == eventListType || (type == eventType && !eventList.IsEmpty())
+            || stringTables.IsStringTableMessage(type);
+    };
+    handler = [this](uint32_t type, const uint8_t* data, size_t size) { HandleMessage(type, data, size); };
+}
+
+void DemoAnalyzer::Analyze(DemoCommandReader& reader, uint64_t endOffset, uint64_t signonEndOffset,
+                           SegmentAnalysis& result)
+{
+    segment = &result;
+    while (reader.Next(command) && command.offset < endOffset) {
+        isAfterSignon = command.offset >= signonEndOffset;
+        if (command.tick > result.analysis.tickCount) {
+            result.analysis.tickCount = command.tick;
+        }
+
+        if (IsPacketCommand(source, command.command)) {
+            ForEachNetMessage(source, command, buffers, filter, handler);
+        }
+    }
+
+    result.analysis.tickrate = tickrate;
+    result.hasPlayerDeathEvent = playerDeathId >= 0;
+    result.endPlayers = players;
+    segment = nullptr;
+}
+
+bool DemoAnalyzer::LoadPlayersSnapshot(const DemoCommand& fullPacket)
+{
+    const uint8_t* data;
+    size_t size;
+    if (!GetFullPacketStringTables(fullPacket, buffers, data, size)) {
+        return false;
+    }
+
+    players.Clear();
+
+    return ReadStringTableSnapshot(data, size, "userinfo",
+                                   [this](int32_t index, const string&, const uint8_t* value, size_t valueSize) {
+                                       players.Update(index, value, valueSize);
+                                   });
+}
+
+bool DemoAnalyzer::IsSignonStateMessage(uint32_t type) const
+{
+    if (type == serverInfoType || type == eventListType) {
+        return true;
+    }
+
+    // Updates only change entries, the snapshots have them.
+    return stringTables.IsStringTableMessage(type) && type != S1_SVC_UPDATE_STRING_TABLE
+        && type != S2_SVC_UPDATE_STRING_TABLE;
+}
+
+void DemoAnalyzer::HandleMessage(uint32_t type, const uint8_t* data, size_t size)
+{
+    if (isAfterSignon && IsSignonStateMessage(type)) {
+        segment->isMergeable = false;
+    }
+
+    if (type == serverInfoType) {
+        float tickInterval = ReadTickInterval(source, data, size);
+        if (tickInterval > 0) {
+            tickrate = 1.0 / tickInterval;
+        }
+    }
+    else if (type == eventListType) {
+        eventList.Parse(data, size);
+        playerDeathId = eventList.FindEventId("player_death");
+        roundStartId = eventList.FindEventId("round_start");
+        roundFreezeEndId = eventList.FindEventId("round_freeze_end");
+        roundEndId = eventList.FindEventId("round_end");
+        const GameEventDescriptor* descriptor = eventList.GetDescriptor(playerDeathId);
+        if (descriptor != nullptr) {
+            userIdKeyIndex = descriptor->FindKey("userid");
+            attackerKeyIndex = descriptor->FindKey("attacker");
+        }
+    }
+    else if (type == eventType) {
+        HandleGameEvent(data, size);
+    }
+    else {
+        // A corrupted table update only loses the players it contains.
+        stringTables.HandleMessage(type, data, size);
+    }
+}
+
+void DemoAnalyzer::HandleGameEvent(const uint8_t* data, size_t size)
+{
+    int32_t eventId = ReadGameEventId(data, size);
+    if (eventId < 0) {
+        return;
+    }
+
+    std::vector<RoundBoundary>& rounds = segment->analysis.rounds;
+    if (eventId == roundStartId) {
+        rounds.push_back({command.tick, command.offset, -1, -1});
+    }
+    else if (eventId == roundFreezeEndId) {
+        (rounds.empty() ? segment->leadingFreezeEndTick : rounds.back().freezeEndTick) = command.tick;
+    }
+    else if (eventId == roundEndId) {
+        (rounds.empty() ? segment->leadingEndTick : rounds.back().endTick) = command.tick;
+    }
+    else if (eventId == playerDeathId && userIdKeyIndex >= 0 && attackerKeyIndex >= 0
+             && ReadGameEventKeys(data, size, keys) && (size_t)userIdKeyIndex < keys.size()
+             && (size_t)attackerKeyIndex < keys.size()) {
+        const PlayerInfo* killer = players.GetByEventId((int32_t)keys[attackerKeyIndex].intValue);
+        const PlayerInfo* victim = players.GetByEventId((int32_t)keys[userIdKeyIndex].intValue);
+        if (killer != nullptr && victim != nullptr) {
+            segment->analysis.kills.push_back(
+                {command.tick, killer->slot + 1, killer->steamId, victim->slot + 1, victim->steamId});
+        }
+    }
+}
+
+static bool AnalyzeDemoSequentially(const uint8_t* data, size_t size, DemoSource source, DemoAnalysis& analysis,
+                                    string& error)
+{
+    DemoAnalyzer analyzer(source);
+    DemoCommandReader reader(data, size, source);
+    SegmentAnalysis segment(source);
+    analyzer.Analyze(reader, NO_OFFSET, NO_OFFSET, segment);
+    if (!segment.hasPlayerDeathEvent) {
+        error = "No player_death event descriptor found";
+        return false;
+    }
+
+    analysis = std::move(segment.analysis);
+
+    return true;
+}
+
+// Commands analyzed by a segment, from its start offset to the start offset of the next segment. The first segment
+// starts at the beginning of the demo, the others right after the full packet whose snapshot gives their players.
+struct Segment
+{
+    uint64_t fullPacketOffset;
+    uint64_t startOffset;
+};
+
+// Returns segments spread evenly over the file, a single one if the demo can't be split.
+static std::vector<Segment> SplitDemo(const uint8_t* data, size_t size, DemoSource source, unsigned int threadCount,
+                                      uint64_t& signonEndOffset)
+{
+    std::vector<Segment> segments = {{NO_OFFSET, 0}};
+    signonEndOffset = NO_OFFSET;
+    size_t segmentCount = std::min((size_t)threadCount * SEGMENTS_PER_THREAD, size / MIN_SEGMENT_SIZE);
+    if (source != DemoSource::SOURCE_2 || threadCount <= 1 || segmentCount <= 1) {
+        return segments;
+    }
+
+    // Only the framing is read, the payloads are not touched.
+    std::vector<Segment> fullPackets;
+    DemoCommandReader reader(data, size, source);
+    DemoCommand command;
+    while (reader.Next(command)) {
+        if (command.command == DEM_FULL_PACKET) {
+            fullPackets.push_back({command.offset, (uint64_t)(command.data + command.size - data)});
+        }
+    }
+    if (fullPackets.empty()) {
+        return segments;
+    }
+
+    signonEndOffset = fullPackets[0].fullPacketOffset;
+    for (size_t i = 1; i < segmentCount; i++) {
+        uint64_t targetOffset = (uint64_t)size * i / segmentCount;
+        auto it = std::lower_bound(fullPackets.begin(), fullPackets.end(), targetOffset,
+                                   [](const Segment& segment, uint64_t offset) {
+                                       return segment.fullPacketOffset < offset;
+                                   });
+        if (it != fullPackets.end() && it->startOffset > segments.back().startOffset) {
+            segments.push_back(*it);
+        }
+    }
+
+    return segments;
+}
+
+static void AnalyzeSegment(const uint8_t* data, size_t size, DemoSource source, const Segment& segment,
+                           uint64_t endOffset, uint64_t signonEndOffset, SegmentAnalysis& result)
+{
+    DemoAnalyzer analyzer(source);
+    DemoCommandReader reader(data, size, source);
+    if (segment.fullPacketOffset == NO_OFFSET) {
+        analyzer.Analyze(reader, endOffset, signonEndOffset, result);
+        return;
+    }
+
+    // Game event descriptors, string tables and server info from the signon data.
+    SegmentAnalysis skipped(source);
+    analyzer.Analyze(reader, signonEndOffset, NO_OFFSET, skipped);
+
+    // The players of the snapshot, then the messages of the full packet without its events: the previous segment
+    // analyzes them. The snapshot may or may not contain the string table updates of the full packet, the players
+    // are the same after the full packet either way.
+    DemoCommand fullPacket;
+    reader.Seek(segment.fullPacketOffset);
+    if (!reader.Next(fullPacket) || !analyzer.LoadPlayersSnapshot(fullPacket)) {
+        result.isMergeable = false;
+        return;
+    }
+    reader.Seek(segment.fullPacketOffset);
+    analyzer.Analyze(reader, segment.startOffset, signonEndOffset, skipped);
+    result.isMergeable = skipped.isMergeable;
+    result.startPlayers = analyzer.GetPlayers();
+
+    reader.Seek(segment.startOffset);
+    analyzer.Analyze(reader, endOffset, signonEndOffset, result);
+}
+
+// Concatenates the segments, returns false if a segment didn't start from the state the previous one ends with.
+static bool MergeSegments(const std::vector<SegmentAnalysis>& segments, DemoAnalysis& analysis)
+{
+    analysis = DemoAnalysis();
+    for (size_t i = 0; i < segments.size(); i++) {
+        const SegmentAnalysis& segment = segments[i];
+        if (!segment.isMergeable || (i > 0 && !segment.startPlayers.HasSamePlayers(segments[i - 1].endPlayers))) {
+            return false;
+        }
+
+        if (!analysis.rounds.empty()) {
+            if (segment.leadingFreezeEndTick >= 0) {
+                analysis.rounds.back().freezeEndTick = segment.leadingFreezeEndTick;
+            }
+            if (segment.leadingEndTick >= 0) {
+                analysis.rounds.back().endTick = segment.leadingEndTick;
+            }
+        }
+        analysis.rounds.insert(analysis.rounds.end(), segment.analysis.rounds.begin(), segment.analysis.rounds.end());
+        analysis.kills.insert(analysis.kills.end(), segment.analysis.kills.begin(), segment.analysis.kills.end());
+        analysis.tickCount = std::max(analysis.tickCount, segment.analysis.tickCount);
+        analysis.tickrate = segment.analysis.tickrate;
+    }
+    analysis.segmentCount = (int32_t)segments.size();
+
+    return true;
+}
+
+bool AnalyzeDemo(const uint8_t* data, size_t size, const DemoHeader& header, unsigned int threadCount,
+                 DemoAnalysis& analysis, string& error)
+{
+    analysis = DemoAnalysis();
+    DemoSource source = header.source;
+    uint64_t signonEndOffset;
+    std::vector<Segment> segments = SplitDemo(data, size, source, threadCount, signonEndOffset);
+    if (segments.size() <= 1) {
+        return AnalyzeDemoSequentially(data, size, source, analysis, error);
+    }
+
+    std::vector<SegmentAnalysis> results(segments.size(), SegmentAnalysis(source));
+    ParallelFor(segments.size(), threadCount, [&](size_t index) {
+        uint64_t endOffset = index + 1 < segments.size() ? segments[index + 1].startOffset : NO_OFFSET;
+        AnalyzeSegment(data, size, source, segments[index], endOffset, signonEndOffset, results[index]);
+    });
+
+    // A snapshot was missing or didn't match the state tracked by the previous segment, only a sequential read gives
+    // the exact result.
+    if (!MergeSegments(results, analysis)) {
+        return AnalyzeDemoSequentially(data, size, source, analysis, error);
+    }
+
+    if (!results.back().hasPlayerDeathEvent) {
+        error = "No player_death event descriptor found";
+        return false;
+    }
+
+    return true;
+}
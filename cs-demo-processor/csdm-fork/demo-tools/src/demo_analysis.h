@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "demo_header.h"
+#include "demo_index.h"
+#include "player_kills.h"
+
+// What the prep stage needs from a demo, read in a single pass over its commands.
+struct DemoAnalysis
+{
+    double tickrate = DEFAULT_TICKRATE;
+    int32_t tickCount = 0;
+    // player_death events between known players sorted by tick, suicides included.
+    std::vector<PlayerKill> kills;
+    std::vector<RoundBoundary> rounds;
+    // Number of segments analyzed in parallel, 1 if the demo was read sequentially.
+    int32_t segmentCount = 1;
+};
+
+// Fails if the demo has no player_death event descriptor, i.e. not a CS demo or truncated before the signon data.
+// Big Source 2 demos are split at full packets and the segments are analyzed on up to threadCount threads. Each segment
+// replays the signon data and starts with the players of the string tables snapshot of its full packet, the result
+// is the same as a sequential read: the demo is read again sequentially if a segment doesn't start with the players the
+// previous one ends with, or if the signon state changes in the middle of the demo.
+bool AnalyzeDemo(const uint8_t* data, size_t size, const DemoHeader& header, unsigned int threadCount,
+                 DemoAnalysis& analysis, std::string& error);
@@ -0,0 +1,274 @@
+#include "demo_commands.h"
+#include "bit_reader.h"
+#include "protobuf.h"
+#include "snappy.h"
+
+#define S1_HEADER_SIZE 1072
+// democmdinfo_t with MAX_SPLITSCREEN_CLIENTS = 2 followed by the incoming and outgoing sequence numbers.
+#define S1_PACKET_INFO_SIZE (152 + 8)
+#define S2_FIRST_COMMAND_OFFSET 16
+
+// CDemoPacket and CDemoFullPacket field numbers.
+#define FIELD_PACKET_DATA 3
+#define FIELD_FULL_PACKET_STRING_TABLE 1
+#define FIELD_FULL_PACKET_PACKET 2
+
+static int32_t ReadInt32(const uint8_t* data)
+{
+    return (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16)
+                     | ((uint32_t)data[3] << 24));
+}
+
+DemoCommandReader::DemoCommandReader(const uint8_t* data, size_t size, DemoSource source)
+    : data(data), size(size), source(source)
+{
+    offset = source == DemoSource::SOURCE_1 ? S1_HEADER_SIZE : S2_FIRST_COMMAND_OFFSET;
+}
+
+void DemoCommandReader::Seek(uint64_t commandOffset)
+{
+    offset = (size_t)commandOffset;
+    isComplete = false;
+    isDone = false;
+}
+
+bool DemoCommandReader::Next(DemoCommand& command)
+{
+    if (isDone || offset >= size) {
+        isDone = true;
+        return false;
+    }
+
+    bool hasCommand = source == DemoSource::SOURCE_1 ? NextSource1Command(command) : NextSource2Command(command);
+    if (!hasCommand) {
+        isDone = true;
+    }
+
+    return hasCommand;
+}
+
+bool DemoCommandReader::NextSource1Command(DemoCommand& command)
+{
+    // Command, tick and player slot.
+    if (size - offset < 6) {
+        return false;
+    }
+
+    command.offset = offset;
+    command.command = data[offset];
+    command.tick = ReadInt32(data + offset + 1);
+    command.isCompressed = false;
+    command.data = nullptr;
+    command.size = 0;
+    size_t cursor = offset + 6;
+
+    size_t skippedSize = 0;
+    switch (command.command) {
+    case S1_DEM_STOP:
+        isComplete = true;
+        return false;
+    case S1_DEM_SYNCTICK:
+        offset = cursor;
+        return true;
+    case S1_DEM_SIGNON:
+    case S1_DEM_PACKET:
+        skippedSize = S1_PACKET_INFO_SIZE;
+        break;
+    case S1_DEM_USERCMD:
+    case S1_DEM_CUSTOMDATA:
+        // Outgoing sequence number or callback index.
+        skippedSize = 4;
+        break;
+    case S1_DEM_CONSOLECMD:
+    case S1_DEM_DATATABLES:
+    case S1_DEM_STRINGTABLES:
+        break;
+    default:
+        return false;
+    }
+
+    if (size - cursor < skippedSize + 4) {
+        return false;
+    }
+    cursor += skippedSize;
+    int32_t length = ReadInt32(data + cursor);
+    cursor += 4;
+    if (length < 0 || (size_t)length > size - cursor) {
+        return false;
+    }
+
+    command.data = data + cursor;
+    command.size = (size_t)length;
+    offset = cursor + length;
+
+    return true;
+}
+
+bool DemoCommandReader::NextSource2Command(DemoCommand& command)
+{
+    const uint8_t* cursor = data + offset;
+    const uint8_t* end = data + size;
+    uint64_t type;
+    uint64_t tick;
+    uint64_t length;
+    if (!ReadVarInt(cursor, end, type) || !ReadVarInt(cursor, end, tick) || !ReadVarInt(cursor, end, length)
+        || length > (uint64_t)(end - cursor)) {
+        return false;
+    }
+
+    command.offset = offset;
+    command.command = (uint32_t)type & ~DEM_IS_COMPRESSED;
+    command.isCompressed = (type & DEM_IS_COMPRESSED) != 0;
+    command.tick = (int32_t)(uint32_t)tick;
+    command.data = cursor;
+    command.size = (size_t)length;
+    offset = (cursor - data) + (size_t)length;
+
+    if (command.command == DEM_STOP) {
+        isComplete = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool IsPacketCommand(DemoSource source, uint32_t command)
+{
+    if (source == DemoSource::SOURCE_1) {
+        return command == S1_DEM_SIGNON || command == S1_DEM_PACKET;
+    }
+
+    return command == DEM_PACKET || command == DEM_SIGNON_PACKET || command == DEM_FULL_PACKET;
+}
+
+static bool ForEachSource1NetMessage(const uint8_t* data, size_t size, const NetMessageFilter& filter,
+                                     const NetMessageHandler& handler)
+{
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + size;
+    while (cursor < end) {
+        uint64_t type;
+        uint64_t length;
+        if (!ReadVarInt(cursor, end, type) || !ReadVarInt(cursor, end, length) || length > (uint64_t)(end - cursor)) {
+            return false;
+        }
+
+        if (filter((uint32_t)type)) {
+            handler((uint32_t)type, cursor, (size_t)length);
+        }
+        cursor += length;
+    }
+
+    return true;
+}
+
+// Returns the bit stream of a CDemoPacket message.
+static bool GetPacketData(const uint8_t* data, size_t size, const uint8_t*& packetData, size_t& packetSize)
+{
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == FIELD_PACKET_DATA && field.IsBytes()) {
+            packetData = field.data;
+            packetSize = field.size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool ForEachSource2NetMessage(const uint8_t* data, size_t size, PacketBuffers& buffers,
+                                     const NetMessageFilter& filter, const NetMessageHandler& handler)
+{
+    BitReader reader(data, size);
+    // A message header is at least 14 bits long, the last bits of the stream are padding.
+    while (reader.GetRemainingBits() > 8) {
+        uint32_t type = reader.ReadUBitVar();
+        uint32_t length = reader.ReadVarUInt32();
+        if (reader.IsOverflowed() || (size_t)length * 8 > reader.GetRemainingBits()) {
+            return false;
+        }
+
+        if (!filter(type)) {
+            reader.SkipBits((size_t)length * 8);
+            continue;
+        }
+
+        uint8_t* message = buffers.messages.Allocate(length);
+        reader.ReadBytes(message, length);
+        handler(type, message, length);
+    }
+
+    return true;
+}
+
+bool ForEachNetMessage(DemoSource source, const DemoCommand& command, PacketBuffers& buffers,
+                       const NetMessageFilter& filter, const NetMessageHandler& handler)
+{
+    if (source == DemoSource::SOURCE_1) {
+        return ForEachSource1NetMessage(command.data, command.size, filter, handler);
+    }
+
+    buffers.messages.Reset();
+    const uint8_t* data = command.data;
+    size_t size = command.size;
+    if (command.isCompressed) {
+        if (!SnappyUncompress(data, size, buffers.uncompressed)) {
+            return false;
+        }
+        data = buffers.uncompressed.data();
+        size = buffers.uncompressed.size();
+    }
+
+    if (command.command == DEM_FULL_PACKET) {
+        ProtoReader reader(data, size);
+        ProtoField field;
+        bool hasPacket = false;
+        while (reader.Next(field)) {
+            if (field.number == FIELD_FULL_PACKET_PACKET && field.IsBytes()) {
+                data = field.data;
+                size = field.size;
+                hasPacket = true;
+                break;
+            }
+        }
+        // Full packets without packet only contain string tables.
+        if (!hasPacket) {
+            return !reader.HasError();
+        }
+    }
+
+    const uint8_t* packetData;
+    size_t packetSize;
+    if (!GetPacketData(data, size, packetData, packetSize)) {
+        return true;
+    }
+
+    return ForEachSource2NetMessage(packetData, packetSize, buffers, filter, handler);
+}
+
+bool GetFullPacketStringTables(const DemoCommand& command, PacketBuffers& buffers, const uint8_t*& data, size_t& size)
+{
+    const uint8_t* commandData = command.data;
+    size_t commandSize = command.size;
+    if (command.isCompressed) {
+        if (!SnappyUncompress(commandData, commandSize, buffers.uncompressed)) {
+            return false;
+        }
+        commandData = buffers.uncompressed.data();
+        commandSize = buffers.uncompressed.size();
+    }
+
+    ProtoReader reader(commandData, commandSize);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == FIELD_FULL_PACKET_STRING_TABLE && field.IsBytes()) {
+            data = field.data;
+            size = field.size;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "arena.h"
+#include "demo_header.h"
+
+// Source 1 demo messages, demoformat.h.
+#define S1_DEM_SIGNON 1
+#define S1_DEM_PACKET 2
+#define S1_DEM_SYNCTICK 3
+#define S1_DEM_CONSOLECMD 4
+#define S1_DEM_USERCMD 5
+#define S1_DEM_DATATABLES 6
+#define S1_DEM_STOP 7
+#define S1_DEM_CUSTOMDATA 8
+#define S1_DEM_STRINGTABLES 9
+
+// Source 2 EDemoCommands values from demo.proto.
+#define DEM_STOP 0
+#define DEM_FILE_HEADER 1
+#define DEM_FILE_INFO 2
+#define DEM_SYNC_TICK 3
+#define DEM_SEND_TABLES 4
+#define DEM_CLASS_INFO 5
+#define DEM_STRING_TABLES 6
+#define DEM_PACKET 7
+#define DEM_SIGNON_PACKET 8
+#define DEM_CONSOLE_CMD 9
+#define DEM_USER_CMD 12
+#define DEM_FULL_PACKET 13
+#define DEM_IS_COMPRESSED 64
+
+struct DemoCommand
+{
+    // Without the compression flag.
+    uint32_t command = 0;
+    // Source 2 commands written before the first tick have the tick -1.
+    int32_t tick = 0;
+    // File offset of the command, seeking there and reading the commands again gives the same stream.
+    uint64_t offset = 0;
+    // Source 1 packets: the net messages. Source 2: the protobuf message, compressed if isCompressed is true.
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    bool isCompressed = false;
+};
+
+// Walks the commands of a demo file in memory, only the framing is decoded.
+class DemoCommandReader
+{
+public:
+    DemoCommandReader(const uint8_t* data, size_t size, DemoSource source);
+
+    // Returns false at the stop command, at the end of the data or if the command is truncated.
+    bool Next(DemoCommand& command);
+    // Continues from the command at the offset, e.g. a full packet found by a previous walk.
+    void Seek(uint64_t commandOffset);
+    // True if the stop command was reached, demos of interrupted recordings don't have it.
+    bool IsComplete() const { return isComplete; }
+    // Offset of the next command, the one that was truncated if Next() returned false at the end of the data.
+    uint64_t GetOffset() const { return offset; }
+    DemoSource GetSource() const { return source; }
+
+private:
+    bool NextSource1Command(DemoCommand& command);
+    bool NextSource2Command(DemoCommand& command);
+
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    DemoSource source;
+    bool isComplete = false;
+    bool isDone = false;
+};
+
+// Buffers reused between packets to avoid allocations.
+struct PacketBuffers
+{
+    std::vector<uint8_t> uncompressed;
+    // Source 2 messages are not byte-aligned in the packet bit stream, the accepted ones are copied here.
+    Arena messages;
+};
+
+typedef std::function<bool(uint32_t type)> NetMessageFilter;
+typedef std::function<void(uint32_t type, const uint8_t* data, size_t size)> NetMessageHandler;
+
+bool IsPacketCommand(DemoSource source, uint32_t command);
+// Calls the handler for the net messages of a packet command accepted by the filter, the other messages are skipped
+// by their size without being copied or decoded. The message data stays valid until the buffers are used for the next
+// packet. Returns false if the packet is malformed.
+bool ForEachNetMessage(DemoSource source, const DemoCommand& command, PacketBuffers& buffers,
+                       const NetMessageFilter& filter, const NetMessageHandler& handler);
+// Returns the CDemoStringTables message of a Source 2 full packet, the state of all the string tables at its tick.
+// The data stays valid until the buffers are used for the next packet. Returns false if the full packet doesn't
+// have one or is malformed.
+bool GetFullPacketStringTables(const DemoCommand& command, PacketBuffers& buffers, const uint8_t*& data,
+                               size_t& size);
@@ -0,0 +1,60 @@
+#include "demo_files.h"
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+namespace fs = std::filesystem;
+using std::string;
+
+static bool IsDemoFile(const fs::path& path)
+{
+    string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    return extension == ".dem";
+}
+
+template <typename Iterator>
+static void AddFolderDemos(Iterator iterator, std::vector<string>& demoPaths, std::error_code& errorCode)
+{
+    for (auto end = Iterator(); iterator != end; iterator.increment(errorCode)) {
+        if (errorCode) {
+            return;
+        }
+        std::error_code fileErrorCode;
+        if (iterator->is_regular_file(fileErrorCode) && IsDemoFile(iterator->path())) {
+            demoPaths.push_back(iterator->path().string());
+        }
+    }
+}
+
+bool CollectDemoPaths(const std::vector<string>& paths, bool isRecursive, std::vector<string>& demoPaths, string& error)
+{
+    for (const string& path : paths) {
+        std::error_code errorCode;
+        if (!fs::is_directory(path, errorCode)) {
+            // Explicit files are kept whatever their extension, errors are reported per file.
+            demoPaths.push_back(path);
+            continue;
+        }
+
+        std::vector<string> folderDemoPaths;
+        auto options = fs::directory_options::skip_permission_denied;
+        if (isRecursive) {
+            AddFolderDemos(fs::recursive_directory_iterator(path, options, errorCode), folderDemoPaths, errorCode);
+        }
+        else {
+            AddFolderDemos(fs::directory_iterator(path, options, errorCode), folderDemoPaths, errorCode);
+        }
+
+        if (errorCode) {
+            error = "Failed to scan folder " + path + ": " + errorCode.message();
+            return false;
+        }
+
+        std::sort(folderDemoPaths.begin(), folderDemoPaths.end());
+        demoPaths.insert(demoPaths.end(), folderDemoPaths.begin(), folderDemoPaths.end());
+    }
+
+    return true;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Expands the command line paths into a sorted list of demo files, folders are scanned for .dem files.
+bool CollectDemoPaths(const std::vector<std::string>& paths, bool isRecursive, std::vector<std::string>& demoPaths,
+                      std::string& error);
@@ -0,0 +1,191 @@
+#include "demo_header.h"
+#include <cstring>
+#include "protobuf.h"
+#include "utf8.h"
+
+using std::string;
+
+// Source 1 demoheader_t layout.
+#define S1_NETWORK_PROTOCOL_OFFSET 12
+#define S1_SERVER_NAME_OFFSET 16
+#define S1_CLIENT_NAME_OFFSET 276
+#define S1_MAP_NAME_OFFSET 536
+#define S1_STRING_LENGTH 260
+#define S1_PLAYBACK_TIME_OFFSET 1056
+#define S1_PLAYBACK_TICKS_OFFSET 1060
+#define S1_PLAYBACK_FRAMES_OFFSET 1064
+#define S1_SIGNON_LENGTH_OFFSET 1068
+#define S1_HEADER_SIZE 1072
+// Source 2 demos start with the filestamp, the file info offset and the spawn groups offset.
+#define S2_FIRST_COMMAND_OFFSET 16
+#define DEM_FILE_HEADER 1
+
+// CDemoFileHeader field numbers.
+#define FIELD_NETWORK_PROTOCOL 2
+#define FIELD_SERVER_NAME 3
+#define FIELD_CLIENT_NAME 4
+#define FIELD_MAP_NAME 5
+#define FIELD_DEMO_VERSION_NAME 11
+#define FIELD_DEMO_VERSION_GUID 12
+#define FIELD_BUILD_NUM 13
+#define FIELD_GAME 14
+
+static uint32_t ReadUInt32(const uint8_t* data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static float ReadFloat(const uint8_t* data)
+{
+    uint32_t bits = ReadUInt32(data);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+// Fixed-size strings are decoded as a whole and null bytes removed afterwards, bytes following the terminator are
+// kept on purpose to match the app.
+static string ReadSource1String(const uint8_t* data)
+{
+    return RemoveChar(SanitizeUtf8((const char*)data, S1_STRING_LENGTH), '\0');
+}
+
+static bool ReadSource1DemoHeader(const uint8_t* data, size_t size, DemoHeader& header, string& error)
+{
+    if (size < S1_HEADER_SIZE) {
+        error = "File too small";
+        return false;
+    }
+
+    header.source = DemoSource::SOURCE_1;
+    header.networkProtocol = ReadUInt32(data + S1_NETWORK_PROTOCOL_OFFSET);
+    header.serverName = ReadSource1String(data + S1_SERVER_NAME_OFFSET);
+    header.clientName = ReadSource1String(data + S1_CLIENT_NAME_OFFSET);
+    header.mapName = ReadSource1String(data + S1_MAP_NAME_OFFSET);
+    header.playbackTime = ReadFloat(data + S1_PLAYBACK_TIME_OFFSET);
+    header.playbackTicks = ReadUInt32(data + S1_PLAYBACK_TICKS_OFFSET);
+    header.playbackFrames = ReadUInt32(data + S1_PLAYBACK_FRAMES_OFFSET);
+    header.signonLength = ReadUInt32(data + S1_SIGNON_LENGTH_OFFSET);
+
+    return true;
+}
+
+static bool ReadFileHeaderMessage(const uint8_t* data, size_t size, DemoHeader& header, string& error)
+{
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.IsVarInt()) {
+            switch (field.number) {
+            case FIELD_NETWORK_PROTOCOL:
+                header.networkProtocol = (uint32_t)field.value;
+                break;
+            case FIELD_BUILD_NUM:
+                header.buildNumber = field.GetInt32();
+                break;
+            }
+            continue;
+        }
+
+        if (!field.IsBytes()) {
+            continue;
+        }
+
+        string value = SanitizeUtf8((const char*)field.data, field.size);
+        switch (field.number) {
+        case FIELD_SERVER_NAME:
+            header.serverName = value;
+            break;
+        case FIELD_CLIENT_NAME:
+            header.clientName = value;
+            break;
+        case FIELD_MAP_NAME:
+            header.mapName = value;
+            break;
+        case FIELD_DEMO_VERSION_NAME:
+            header.demoVersionName = value;
+            break;
+        case FIELD_DEMO_VERSION_GUID:
+            header.demoVersionGuid = value;
+            break;
+        case FIELD_GAME:
+            header.game = value;
+            break;
+        }
+    }
+
+    if (reader.HasError()) {
+        error = "Truncated protobuf message";
+        return false;
+    }
+
+    return true;
+}
+
+static bool ReadSource2DemoHeader(const uint8_t* data, size_t size, DemoHeader& header, string& error)
+{
+    const uint8_t* cursor = data + S2_FIRST_COMMAND_OFFSET;
+    const uint8_t* end = data + size;
+    uint64_t type;
+    uint64_t tick;
+    uint64_t messageSize;
+    if (size < S2_FIRST_COMMAND_OFFSET || !ReadVarInt(cursor, end, type) || !ReadVarInt(cursor, end, tick)
+        || !ReadVarInt(cursor, end, messageSize)) {
+        error = "File too small";
+        return false;
+    }
+
+    // The first message should always be EDemoCommands.DEM_FileHeader, uncompressed.
+    if (type != DEM_FILE_HEADER) {
+        error = "Unexpected first proto message type";
+        return false;
+    }
+
+    if (messageSize > (uint64_t)(end - cursor)) {
+        error = "Truncated file header message";
+        return false;
+    }
+
+    header.source = DemoSource::SOURCE_2;
+    if (!ReadFileHeaderMessage(cursor, (size_t)messageSize, header, error)) {
+        return false;
+    }
+
+    if (header.networkProtocol == 0 || header.serverName.empty() || header.clientName.empty() || header.mapName.empty()
+        || header.buildNumber == 0 || header.demoVersionGuid.empty() || header.demoVersionName.empty()) {
+        error = "Missing required protobuf fields";
+        return false;
+    }
+
+    header.serverName = RemoveReplacementChars(header.serverName);
+    header.clientName = RemoveReplacementChars(header.clientName);
+
+    return true;
+}
+
+const char* GetFilestamp(DemoSource source)
+{
+    return source == DemoSource::SOURCE_1 ? "HL2DEMO" : "PBDEMS2";
+}
+
+bool ReadDemoHeader(const uint8_t* data, size_t size, DemoHeader& header, string& error)
+{
+    header = DemoHeader();
+    if (size < 8) {
+        error = "File too small";
+        return false;
+    }
+
+    string filestamp = RemoveChar(SanitizeUtf8((const char*)data, 8), '\0');
+    if (filestamp == "HL2DEMO") {
+        return ReadSource1DemoHeader(data, size, header, error);
+    }
+
+    if (filestamp == "PBDEMS2") {
+        return ReadSource2DemoHeader(data, size, header, error);
+    }
+
+    error = "Invalid filestamp " + filestamp;
+    return false;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class DemoSource
+{
+    SOURCE_1,
+    SOURCE_2,
+};
+
+// Mirrors the DemoHeader type of src/node/demo/get-demo-header.ts, field names and string sanitization included,
+// so that checksums computed from it match the ones computed by the app.
+struct DemoHeader
+{
+    DemoSource source = DemoSource::SOURCE_1;
+    std::string serverName;
+    std::string clientName;
+    std::string mapName;
+    uint32_t networkProtocol = 0;
+    // Source 1 only.
+    float playbackTime = 0;
+    uint32_t playbackTicks = 0;
+    uint32_t playbackFrames = 0;
+    uint32_t signonLength = 0;
+    // Source 2 only.
+    int32_t buildNumber = 0;
+    std::string demoVersionGuid;
+    std::string demoVersionName;
+    std::string game;
+};
+
+const char* GetFilestamp(DemoSource source);
+// Decodes the header from the beginning of the demo file, only the first few KB are read.
+bool ReadDemoHeader(const uint8_t* data, size_t size, DemoHeader& header, std::string& error);
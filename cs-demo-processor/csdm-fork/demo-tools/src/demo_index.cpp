@@ -0,0 +1,321 @@
+#include "demo_index.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include "checksum.h"
+#include "protobuf.h"
+
+using std::string;
+
+// Sidecar layout, all integers are varints, ticks are zigzag encoded and lists are delta encoded:
+// magic, source, demo file size, demo checksum (8 bytes LE), is complete, last tick, seek interval,
+// seek point count, (tick delta, offset delta)..., full packet count, (tick delta, offset delta)...,
+// round count, (start tick, start offset delta, freeze end tick, end tick)...
+#define INDEX_FILE_MAGIC "CSDMIDX1"
+#define INDEX_FILE_MAGIC_SIZE 8
+
+DemoIndexBuilder::DemoIndexBuilder(const DemoHeader& header, int32_t seekInterval)
+    : header(header),
+      eventListType(GetGameEventListMessageType(header.source)),
+      eventType(GetGameEventMessageType(header.source)),
+      nextOffset(DemoCommandReader(nullptr, 0, header.source).GetOffset())
+{
+    index.source = header.source;
+    index.seekInterval = seekInterval;
+    filter = [this](uint32_t type) {
+        return type == eventListType || (type == eventType && !eventList.IsEmpty());
+    };
+    handler = [this](uint32_t type, const uint8_t* data, size_t size) { HandleMessage(type, data, size); };
+}
+
+void DemoIndexBuilder::HandleMessage(uint32_t type, const uint8_t* data, size_t size)
+{
+    if (type == eventListType) {
+        eventList.Parse(data, size);
+        roundStartId = eventList.FindEventId("round_start");
+        roundFreezeEndId = eventList.FindEventId("round_freeze_end");
+        roundEndId = eventList.FindEventId("round_end");
+        return;
+    }
+
+    int32_t eventId = ReadGameEventId(data, size);
+    if (eventId < 0) {
+        return;
+    }
+
+    if (eventId == roundStartId) {
+        index.rounds.push_back({command.tick, command.offset, -1, -1});
+    }
+    else if (eventId == roundFreezeEndId && !index.rounds.empty()) {
+        index.rounds.back().freezeEndTick = command.tick;
+    }
+    else if (eventId == roundEndId && !index.rounds.empty()) {
+        index.rounds.back().endTick = command.tick;
+    }
+}
+
+uint64_t DemoIndexBuilder::AddData(const uint8_t* data, size_t size, uint64_t dataOffset)
+{
+    if (index.isComplete) {
+        return nextOffset;
+    }
+
+    DemoSource source = header.source;
+    DemoCommandReader reader(data, size, source);
+    reader.Seek(nextOffset - dataOffset);
+    while (reader.Next(command)) {
+        command.offset += dataOffset;
+        if (command.tick >= 0 && command.tick >= nextSeekTick) {
+            index.seekPoints.push_back({command.tick, command.offset});
+            nextSeekTick = ((int64_t)command.tick / index.seekInterval + 1) * index.seekInterval;
+        }
+
+        if (command.tick > index.lastTick) {
+            index.lastTick = command.tick;
+        }
+
+        if ((source == DemoSource::SOURCE_2 && command.command == DEM_FULL_PACKET)
+            || (source == DemoSource::SOURCE_1 && command.command == S1_DEM_SYNCTICK)) {
+            index.fullPackets.push_back({command.tick, command.offset});
+        }
+
+        if (IsPacketCommand(source, command.command)) {
+            // A corrupted packet doesn't prevent indexing the next commands.
+            ForEachNetMessage(source, command, buffers, filter, handler);
+        }
+    }
+    index.isComplete = reader.IsComplete();
+    nextOffset = dataOffset + reader.GetOffset();
+
+    return nextOffset;
+}
+
+void DemoIndexBuilder::Finish(uint64_t demoFileSize, DemoIndex& result)
+{
+    index.demoFileSize = demoFileSize;
+    index.demoChecksum = GetDemoChecksumValue(header, demoFileSize);
+    result = std::move(index);
+}
+
+bool BuildDemoIndex(const uint8_t* data, size_t size, const DemoHeader& header, int32_t seekInterval,
+                    DemoIndex& index, string& error)
+{
+    if (seekInterval <= 0) {
+        error = "Invalid seek interval";
+        return false;
+    }
+
+    DemoIndexBuilder builder(header, seekInterval);
+    builder.AddData(data, size, 0);
+    builder.Finish(size, index);
+
+    return true;
+}
+
+bool IsDemoIndexUpToDate(const DemoIndex& index, const DemoHeader& header, uint64_t demoFileSize)
+{
+    return index.demoFileSize == demoFileSize && index.demoChecksum == GetDemoChecksumValue(header, demoFileSize);
+}
+
+string GetDemoIndexFilePath(const string& demoPath)
+{
+    return demoPath + ".idx";
+}
+
+static void WriteVarInt(string& output, uint64_t value)
+{
+    while (value >= 0x80) {
+        output += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    output += (char)value;
+}
+
+static void WriteSignedVarInt(string& output, int64_t value)
+{
+    WriteVarInt(output, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void WriteSeekPoints(string& output, const std::vector<SeekPoint>& points)
+{
+    WriteVarInt(output, points.size());
+    int32_t previousTick = 0;
+    uint64_t previousOffset = 0;
+    for (const SeekPoint& point : points) {
+        WriteSignedVarInt(output, (int64_t)point.tick - previousTick);
+        WriteVarInt(output, point.offset - previousOffset);
+        previousTick = point.tick;
+        previousOffset = point.offset;
+    }
+}
+
+bool WriteDemoIndexFile(const string& path, const DemoIndex& index, string& error)
+{
+    string output = INDEX_FILE_MAGIC;
+    WriteVarInt(output, index.source == DemoSource::SOURCE_1 ? 1 : 2);
+    WriteVarInt(output, index.demoFileSize);
+    for (int i = 0; i < 8; i++) {
+        output += (char)(index.demoChecksum >> (i * 8));
+    }
+    WriteVarInt(output, index.isComplete ? 1 : 0);
+    WriteSignedVarInt(output, index.lastTick);
+    WriteVarInt(output, index.seekInterval);
+    WriteSeekPoints(output, index.seekPoints);
+    WriteSeekPoints(output, index.fullPackets);
+    WriteVarInt(output, index.rounds.size());
+    uint64_t previousOffset = 0;
+    for (const RoundBoundary& round : index.rounds) {
+        WriteSignedVarInt(output, round.startTick);
+        WriteVarInt(output, round.startOffset - previousOffset);
+        WriteSignedVarInt(output, round.freezeEndTick);
+        WriteSignedVarInt(output, round.endTick);
+        previousOffset = round.startOffset;
+    }
+
+    // Written to a temporary file first so readers never see a partial index.
+    string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        error = "Failed to write " + temporaryPath;
+        return false;
+    }
+    file.write(output.data(), output.size());
+    file.close();
+    if (!file || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        error = "Failed to write " + path;
+        return false;
+    }
+
+    return true;
+}
+
+static bool ReadSignedVarInt(const uint8_t*& cursor, const uint8_t* end, int32_t& value)
+{
+    uint64_t encoded;
+    if (!ReadVarInt(cursor, end, encoded)) {
+        return false;
+    }
+    value = (int32_t)(int64_t)((encoded >> 1) ^ (~(encoded & 1) + 1));
+
+    return true;
+}
+
+static bool ReadSeekPoints(const uint8_t*& cursor, const uint8_t* end, std::vector<SeekPoint>& points)
+{
+    uint64_t count;
+    // Each point takes at least 2 bytes.
+    if (!ReadVarInt(cursor, end, count) || count > (uint64_t)(end - cursor) / 2) {
+        return false;
+    }
+
+    points.resize((size_t)count);
+    int32_t tick = 0;
+    uint64_t offset = 0;
+    for (SeekPoint& point : points) {
+        int32_t tickDelta;
+        uint64_t offsetDelta;
+        if (!ReadSignedVarInt(cursor, end, tickDelta) || !ReadVarInt(cursor, end, offsetDelta)) {
+            return false;
+        }
+        tick += tickDelta;
+        offset += offsetDelta;
+        point = {tick, offset};
+    }
+
+    return true;
+}
+
+bool ReadDemoIndexFile(const string& path, DemoIndex& index, string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = "Failed to open " + path;
+        return false;
+    }
+    string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    index = DemoIndex();
+    const uint8_t* cursor = (const uint8_t*)content.data();
+    const uint8_t* end = cursor + content.size();
+    if (content.size() < INDEX_FILE_MAGIC_SIZE || memcmp(cursor, INDEX_FILE_MAGIC, INDEX_FILE_MAGIC_SIZE) != 0) {
+        error = "Invalid index file";
+        return false;
+    }
+    cursor += INDEX_FILE_MAGIC_SIZE;
+
+    uint64_t source;
+    uint64_t isComplete;
+    uint64_t seekInterval;
+    uint64_t roundCount;
+    if (!ReadVarInt(cursor, end, source) || !ReadVarInt(cursor, end, index.demoFileSize) || end - cursor < 8) {
+        error = "Invalid index file";
+        return false;
+    }
+    index.source = source == 1 ? DemoSource::SOURCE_1 : DemoSource::SOURCE_2;
+    for (int i = 0; i < 8; i++) {
+        index.demoChecksum |= (uint64_t)cursor[i] << (i * 8);
+    }
+    cursor += 8;
+
+    if (!ReadVarInt(cursor, end, isComplete) || !ReadSignedVarInt(cursor, end, index.lastTick)
+        || !ReadVarInt(cursor, end, seekInterval) || !ReadSeekPoints(cursor, end, index.seekPoints)
+        || !ReadSeekPoints(cursor, end, index.fullPackets) || !ReadVarInt(cursor, end, roundCount)
+        || roundCount > (uint64_t)(end - cursor) / 4) {
+        error = "Invalid index file";
+        return false;
+    }
+    index.isComplete = isComplete != 0;
+    index.seekInterval = (int32_t)seekInterval;
+
+    index.rounds.resize((size_t)roundCount);
+    uint64_t offset = 0;
+    for (RoundBoundary& round : index.rounds) {
+        uint64_t offsetDelta;
+        if (!ReadSignedVarInt(cursor, end, round.startTick) || !ReadVarInt(cursor, end, offsetDelta)
+            || !ReadSignedVarInt(cursor, end, round.freezeEndTick) || !ReadSignedVarInt(cursor, end, round.endTick)) {
+            error = "Invalid index file";
+            return false;
+        }
+        offset += offsetDelta;
+        round.startOffset = offset;
+    }
+
+    return true;
+}
+
+// Returns the last point at or before the tick, points are sorted by tick.
+static const SeekPoint* FindLastPointBefore(const std::vector<SeekPoint>& points, int32_t tick)
+{
+    auto it = std::upper_bound(points.begin(), points.end(), tick, [](int32_t value, const SeekPoint& point) {
+        return value < point.tick;
+    });
+
+    return it == points.begin() ? nullptr : &*(it - 1);
+}
+
+bool FindSeekTarget(const DemoIndex& index, int32_t tick, SeekTarget& target)
+{
+    const SeekPoint* point = nullptr;
+    bool isFullPacket = false;
+    if (index.source == DemoSource::SOURCE_2) {
+        point = FindLastPointBefore(index.fullPackets, tick);
+        isFullPacket = point != nullptr;
+    }
+
+    if (point == nullptr) {
+        point = FindLastPointBefore(index.seekPoints, tick);
+    }
+
+    if (point == nullptr) {
+        return false;
+    }
+
+    target.point = *point;
+    target.simulatedTicks = tick - point->tick;
+    target.isFullPacket = isFullPacket;
+
+    return true;
+}
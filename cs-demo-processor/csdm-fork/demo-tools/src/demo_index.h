@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "demo_commands.h"
+#include "demo_header.h"
+#include "game_events.h"
+
+// Default number of ticks between 2 seek points.
+#define DEFAULT_SEEK_INTERVAL 64
+
+struct SeekPoint
+{
+    int32_t tick;
+    // File offset of the command.
+    uint64_t offset;
+};
+
+struct RoundBoundary
+{
+    // round_start event, offset of the command containing it.
+    int32_t startTick;
+    uint64_t startOffset;
+    // round_freeze_end and round_end events, -1 if the demo ends before them.
+    int32_t freezeEndTick;
+    int32_t endTick;
+};
+
+// Positions of a demo found by walking its commands once, stored next to the demo in a .dem.idx sidecar.
+struct DemoIndex
+{
+    DemoSource source = DemoSource::SOURCE_1;
+    // The sidecar is stale if the size or the checksum of the demo changed.
+    uint64_t demoFileSize = 0;
+    uint64_t demoChecksum = 0;
+    // False if the demo doesn't end with a stop command (interrupted recording or truncated file).
+    bool isComplete = false;
+    int32_t lastTick = 0;
+    int32_t seekInterval = DEFAULT_SEEK_INTERVAL;
+    // First command of every seekInterval ticks.
+    std::vector<SeekPoint> seekPoints;
+    // Source 2 DEM_FullPacket commands, seeking loads the closest one before the target tick and simulates the
+    // following packets. Source 1 demos don't have full packets, the sync tick command that ends the signon data is
+    // used instead.
+    std::vector<SeekPoint> fullPackets;
+    std::vector<RoundBoundary> rounds;
+};
+
+struct SeekTarget
+{
+    SeekPoint point;
+    // Ticks to simulate from the loaded position to reach the requested tick.
+    int32_t simulatedTicks;
+    bool isFullPacket;
+};
+
+// Builds the index of a demo received in chunks, e.g. while it's decompressed: each command is indexed as soon as
+// all its bytes were added.
+class DemoIndexBuilder
+{
+public:
+    DemoIndexBuilder(const DemoHeader& header, int32_t seekInterval);
+    DemoIndexBuilder(const DemoIndexBuilder&) = delete;
+    DemoIndexBuilder& operator=(const DemoIndexBuilder&) = delete;
+
+    // Indexes the complete commands of the demo bytes found at the file offset, which must not be after the next
+    // command. Returns the offset of the next command, its bytes must be added again with the ones that follow.
+    uint64_t AddData(const uint8_t* data, size_t size, uint64_t dataOffset);
+    // Ends the index once the whole demo was added.
+    void Finish(uint64_t demoFileSize, DemoIndex& result);
+
+private:
+    void HandleMessage(uint32_t type, const uint8_t* data, size_t size);
+
+    DemoHeader header;
+    DemoIndex index;
+    uint32_t eventListType;
+    uint32_t eventType;
+    GameEventList eventList;
+    int32_t roundStartId = -1;
+    int32_t roundFreezeEndId = -1;
+    int32_t roundEndId = -1;
+    int64_t nextSeekTick = 0;
+    uint64_t nextOffset;
+    PacketBuffers buffers;
+    // Built once, converting the lambdas for every packet would allocate.
+    NetMessageFilter filter;
+    NetMessageHandler handler;
+    DemoCommand command;
+};
+
+bool BuildDemoIndex(const uint8_t* data, size_t size, const DemoHeader& header, int32_t seekInterval,
+                    DemoIndex& index, std::string& error);
+bool IsDemoIndexUpToDate(const DemoIndex& index, const DemoHeader& header, uint64_t demoFileSize);
+std::string GetDemoIndexFilePath(const std::string& demoPath);
+bool WriteDemoIndexFile(const std::string& path, const DemoIndex& index, std::string& error);
+bool ReadDemoIndexFile(const std::string& path, DemoIndex& index, std::string& error);
+// Returns the closest position before the tick from where the game can start playing, the latest full packet for
+// Source 2 demos.
+bool FindSeekTarget(const DemoIndex& index, int32_t tick, SeekTarget& target);
@@ -0,0 +1,178 @@
+#include "game_events.h"
+#include "protobuf.h"
+
+// descriptor_t field numbers.
+#define FIELD_LIST_DESCRIPTORS 1
+#define FIELD_DESCRIPTOR_EVENT_ID 1
+#define FIELD_DESCRIPTOR_NAME 2
+#define FIELD_DESCRIPTOR_KEYS 3
+#define FIELD_KEY_NAME 2
+// Game event field numbers.
+#define FIELD_EVENT_ID 2
+#define FIELD_EVENT_KEYS 3
+// key_t field numbers.
+#define FIELD_KEY_TYPE 1
+#define FIELD_KEY_VAL_STRING 2
+#define FIELD_KEY_VAL_FLOAT 3
+#define FIELD_KEY_VAL_LONG 4
+#define FIELD_KEY_VAL_SHORT 5
+#define FIELD_KEY_VAL_BYTE 6
+#define FIELD_KEY_VAL_BOOL 7
+#define FIELD_KEY_VAL_UINT64 8
+
+using std::string;
+
+int GameEventDescriptor::FindKey(const string& keyName) const
+{
+    for (size_t i = 0; i < keyNames.size(); i++) {
+        if (keyNames[i] == keyName) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+uint32_t GetGameEventListMessageType(DemoSource source)
+{
+    return source == DemoSource::SOURCE_1 ? SVC_GAME_EVENT_LIST : GE_SOURCE1_LEGACY_GAME_EVENT_LIST;
+}
+
+uint32_t GetGameEventMessageType(DemoSource source)
+{
+    return source == DemoSource::SOURCE_1 ? SVC_GAME_EVENT : GE_SOURCE1_LEGACY_GAME_EVENT;
+}
+
+static bool ParseDescriptor(const uint8_t* data, size_t size, int32_t& eventId, GameEventDescriptor& descriptor)
+{
+    eventId = -1;
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == FIELD_DESCRIPTOR_EVENT_ID && field.IsVarInt()) {
+            eventId = field.GetInt32();
+        }
+        else if (field.number == FIELD_DESCRIPTOR_NAME && field.IsBytes()) {
+            descriptor.name = field.GetString();
+        }
+        else if (field.number == FIELD_DESCRIPTOR_KEYS && field.IsBytes()) {
+            string keyName;
+            ProtoReader keyReader(field.data, field.size);
+            ProtoField keyField;
+            while (keyReader.Next(keyField)) {
+                if (keyField.number == FIELD_KEY_NAME && keyField.IsBytes()) {
+                    keyName = keyField.GetString();
+                }
+            }
+            if (keyReader.HasError()) {
+                return false;
+            }
+            descriptor.keyNames.push_back(keyName);
+        }
+    }
+
+    return !reader.HasError() && eventId >= 0;
+}
+
+bool GameEventList::Parse(const uint8_t* data, size_t size)
+{
+    descriptors.clear();
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number != FIELD_LIST_DESCRIPTORS || !field.IsBytes()) {
+            continue;
+        }
+
+        int32_t eventId;
+        GameEventDescriptor descriptor;
+        if (!ParseDescriptor(field.data, field.size, eventId, descriptor)) {
+            return false;
+        }
+        descriptors[eventId] = std::move(descriptor);
+    }
+
+    return !reader.HasError();
+}
+
+const GameEventDescriptor* GameEventList::GetDescriptor(int32_t eventId) const
+{
+    auto it = descriptors.find(eventId);
+
+    return it != descriptors.end() ? &it->second : nullptr;
+}
+
+int32_t GameEventList::FindEventId(const string& name) const
+{
+    for (const auto& entry : descriptors) {
+        if (entry.second.name == name) {
+            return entry.first;
+        }
+    }
+
+    return -1;
+}
+
+int32_t ReadGameEventId(const uint8_t* data, size_t size)
+{
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == FIELD_EVENT_ID && field.IsVarInt()) {
+            return field.GetInt32();
+        }
+    }
+
+    return -1;
+}
+
+static bool ReadGameEventKey(const uint8_t* data, size_t size, GameEventKey& key)
+{
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        switch (field.number) {
+        case FIELD_KEY_TYPE:
+            key.type = field.GetInt32();
+            break;
+        case FIELD_KEY_VAL_STRING:
+            if (field.IsBytes()) {
+                key.stringValue = field.GetStringView();
+            }
+            break;
+        case FIELD_KEY_VAL_FLOAT:
+            key.floatValue = field.GetFloat();
+            break;
+        case FIELD_KEY_VAL_LONG:
+        case FIELD_KEY_VAL_SHORT:
+        case FIELD_KEY_VAL_BYTE:
+            key.intValue = field.GetInt32();
+            break;
+        case FIELD_KEY_VAL_BOOL:
+        case FIELD_KEY_VAL_UINT64:
+            key.intValue = (int64_t)field.value;
+            break;
+        }
+    }
+
+    return !reader.HasError();
+}
+
+bool ReadGameEventKeys(const uint8_t* data, size_t size, std::vector<GameEventKey>& keys)
+{
+    keys.clear();
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number != FIELD_EVENT_KEYS || !field.IsBytes()) {
+            continue;
+        }
+
+        keys.emplace_back();
+        if (!ReadGameEventKey(field.data, field.size, keys.back())) {
+            return false;
+        }
+    }
+
+    return !reader.HasError();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "demo_header.h"
+
+// svc_GameEventList and svc_GameEvent from the Source 1 netmessages.proto.
+#define SVC_GAME_EVENT 25
+#define SVC_GAME_EVENT_LIST 30
+// GE_Source1LegacyGameEventList and GE_Source1LegacyGameEvent from the Source 2 gameevents.proto.
+#define GE_SOURCE1_LEGACY_GAME_EVENT_LIST 205
+#define GE_SOURCE1_LEGACY_GAME_EVENT 207
+
+struct GameEventDescriptor
+{
+    std::string name;
+    std::vector<std::string> keyNames;
+
+    // Returns -1 if the event doesn't have the key.
+    int FindKey(const std::string& keyName) const;
+};
+
+// Value of a game event key, only the field matching the key type is set.
+struct GameEventKey
+{
+    int32_t type = 0;
+    // Points into the game event message.
+    std::string_view stringValue;
+    float floatValue = 0;
+    // long, short, byte, bool and uint64 values.
+    int64_t intValue = 0;
+};
+
+uint32_t GetGameEventListMessageType(DemoSource source);
+uint32_t GetGameEventMessageType(DemoSource source);
+
+// Descriptors of the game events sent at the beginning of the demo, game events only contain the event id and the
+// key values in the order of the descriptor.
+// CSVCMsg_GameEventList and CMsgSource1LegacyGameEventList share the same layout.
+class GameEventList
+{
+public:
+    bool Parse(const uint8_t* data, size_t size);
+    bool IsEmpty() const { return descriptors.empty(); }
+    const GameEventDescriptor* GetDescriptor(int32_t eventId) const;
+    // Returns -1 if the event doesn't exist.
+    int32_t FindEventId(const std::string& name) const;
+
+private:
+    std::unordered_map<int32_t, GameEventDescriptor> descriptors;
+};
+
+// Returns the eventid field of a game event message without decoding its keys, -1 if missing.
+int32_t ReadGameEventId(const uint8_t* data, size_t size);
+// Decodes the keys of a game event message, in the order of the descriptor keys.
+bool ReadGameEventKeys(const uint8_t* data, size_t size, std::vector<GameEventKey>& keys);
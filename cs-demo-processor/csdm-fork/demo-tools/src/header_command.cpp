@@ -0,0 +1,108 @@
+// demo-tools header <demo or folder>... [--recursive] [--threads N] [--output path]
+//
+// Prints the header and the checksum of demos, folders are scanned for .dem files in parallel. Only the first pages of
+// each demo are mapped in memory so the cost per demo doesn't depend on its size.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include "commands.h"
+#include "checksum.h"
+#include "demo_files.h"
+#include "demo_header.h"
+#include "mapped_file.h"
+#include "output.h"
+#include "parallel.h"
+
+using nlohmann::json;
+using std::string;
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools header <demo or folder>... [--recursive] [--threads N] [--output path]\n");
+
+    return 2;
+}
+
+static json ReadDemo(const string& demoPath)
+{
+    json result = {{"path", demoPath}};
+    MappedFile file;
+    string error;
+    DemoHeader header;
+    if (!file.Open(demoPath, error) || !ReadDemoHeader(file.Data(), file.Size(), header, error)) {
+        result["error"] = error;
+        return result;
+    }
+
+    result["fileSize"] = file.Size();
+    result["checksum"] = GetDemoChecksum(header, file.Size());
+    result["header"] = GetDemoHeaderJson(header);
+
+    return result;
+}
+
+int RunHeaderCommand(int argc, char** argv)
+{
+    std::vector<string> paths;
+    string outputPath;
+    bool isRecursive = false;
+    unsigned int threadCount = GetDefaultThreadCount();
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--recursive") {
+            isRecursive = true;
+        }
+        else if (arg == "--threads" && hasValue) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() || threadCount == 0) {
+        return PrintUsage();
+    }
+
+    std::vector<string> demoPaths;
+    string error;
+    if (!CollectDemoPaths(paths, isRecursive, demoPaths, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<json> results(demoPaths.size());
+    ParallelFor(demoPaths.size(), threadCount, [&](size_t index) {
+        results[index] = ReadDemo(demoPaths[index]);
+    });
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    int errorCount = 0;
+    for (const json& result : results) {
+        if (result.contains("error")) {
+            errorCount++;
+        }
+    }
+    fprintf(stderr, "Read %zu demo headers (%d errors) in %.1f ms with %u threads\n", results.size(), errorCount,
+            elapsedMs, threadCount);
+
+    // A single file argument gives an object, anything else an array.
+    bool isSingleFile = paths.size() == 1 && demoPaths.size() == 1 && demoPaths[0] == paths[0];
+    json output = isSingleFile ? results[0] : json(results);
+    if (!WriteJsonOutput(output, outputPath)) {
+        return 2;
+    }
+
+    return errorCount > 0 ? 1 : 0;
+}
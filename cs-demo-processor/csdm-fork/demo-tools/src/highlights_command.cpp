@@ -0,0 +1,214 @@
+// demo-tools highlights <demo> <steamId64> [--before seconds] [--after seconds] [--no-voices] [--split-sequences]
+//                       [--cache folder] [--output path]
+//
+// Extracts the kills of a player from the demo game events and writes the actions file of the player highlights, the same
+// file as generatePlayerHighlightsJsonFile (src/node/counter-strike/json-actions-file) from the player perspective,
+// without analyzing the demo into the database first.
+// With --split-sequences, kills too far away from the previous one start a new sequence (go_to_next_sequence) instead
+// of skipping ahead, e.g. to record each group of kills separately.
+// With --cache, the kills are read from the analysis cache of analyze when the demo is in it, otherwise the analysis is
+// added to it.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "actions_file.h"
+#include "analysis_cache.h"
+#include "commands.h"
+#include "demo_analysis.h"
+#include "demo_header.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "player_kills.h"
+
+using std::string;
+
+// Kills further away than this are reached by skipping ahead.
+#define MAX_NEXT_ACTION_DELAY_SECONDS 15
+#define DEFAULT_BEFORE_DELAY_SECONDS 5
+#define DEFAULT_AFTER_DELAY_SECONDS 2
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools highlights <demo> <steamId64> [--before seconds] [--after seconds] [--no-voices] "
+                    "[--split-sequences] [--cache folder] [--output path]\n");
+
+    return 2;
+}
+
+static string GetPlayerIdToFocus(DemoSource source, const PlayerKill& kill)
+{
+    return source == DemoSource::SOURCE_1 ? std::to_string(kill.killerSteamId) : std::to_string(kill.killerSlot);
+}
+
+static void GenerateHighlights(ActionsFileGenerator& generator, DemoSource source, const PlayerKills& playerKills,
+                               double beforeDelaySeconds, double nextDelaySeconds, bool isPlayerVoicesEnabled,
+                               bool isSplittingSequences)
+{
+    if (isPlayerVoicesEnabled) {
+        generator.EnablePlayerVoices();
+    }
+    else {
+        generator.DisablePlayerVoices();
+    }
+
+    beforeDelaySeconds = std::max(1.0, beforeDelaySeconds);
+    nextDelaySeconds = std::max(1.0, nextDelaySeconds);
+    double tickrate = playerKills.tickrate;
+    int32_t tickBeforeDelayCount = (int32_t)std::round(tickrate * beforeDelaySeconds);
+    int32_t tickNextDelayCount = (int32_t)std::round(tickrate * nextDelaySeconds);
+    int32_t maxNextActionDelayTickCount =
+        std::max((int32_t)std::round(tickrate * MAX_NEXT_ACTION_DELAY_SECONDS), tickNextDelayCount);
+
+    const std::vector<PlayerKill>& kills = playerKills.kills;
+    for (size_t index = 0; index < kills.size(); index++) {
+        const PlayerKill& kill = kills[index];
+        if (index == 0) {
+            // Skip ahead to the first kill and focus the camera on the player.
+            int32_t toTick = std::max(0, kill.tick - tickBeforeDelayCount);
+            generator.AddSkipAhead(0, toTick);
+            generator.AddSpecPlayer(toTick, GetPlayerIdToFocus(source, kill));
+        }
+
+        if (index == kills.size() - 1) {
+            int32_t stopTick = std::min(playerKills.tickCount, kill.tick + tickNextDelayCount);
+            generator.AddExecCommand(stopTick, "quit");
+            break;
+        }
+
+        const PlayerKill& nextKill = kills[index + 1];
+        string playerIdToFocus = GetPlayerIdToFocus(source, nextKill);
+        bool isNextKillTooFarAway = nextKill.tick - kill.tick > maxNextActionDelayTickCount;
+        if (!isNextKillTooFarAway) {
+            // The next kill is close, only move the camera on the player.
+            int32_t tick = (int32_t)std::round(kill.tick + (nextKill.tick - kill.tick) / 2.0);
+            generator.AddSpecPlayer(tick, playerIdToFocus);
+            continue;
+        }
+
+        int32_t skipAheadTick = kill.tick + tickNextDelayCount;
+        int32_t toTick = nextKill.tick - tickBeforeDelayCount;
+        if (isSplittingSequences) {
+            // The plugin goes back to the beginning of the demo when starting the next sequence.
+            generator.AddGoToNextSequence(skipAheadTick);
+            generator.AddSkipAhead(0, toTick);
+        }
+        else {
+            generator.AddSkipAhead(skipAheadTick, toTick);
+        }
+        generator.AddSpecPlayer(toTick, playerIdToFocus);
+    }
+}
+
+int RunHighlightsCommand(int argc, char** argv)
+{
+    std::vector<string> positionalArgs;
+    string outputPath;
+    string cachePath;
+    double beforeDelaySeconds = DEFAULT_BEFORE_DELAY_SECONDS;
+    double nextDelaySeconds = DEFAULT_AFTER_DELAY_SECONDS;
+    bool isPlayerVoicesEnabled = true;
+    bool isSplittingSequences = false;
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--before" && hasValue) {
+            beforeDelaySeconds = atof(argv[++i]);
+        }
+        else if (arg == "--after" && hasValue) {
+            nextDelaySeconds = atof(argv[++i]);
+        }
+        else if (arg == "--no-voices") {
+            isPlayerVoicesEnabled = false;
+        }
+        else if (arg == "--split-sequences") {
+            isSplittingSequences = true;
+        }
+        else if (arg == "--cache" && hasValue) {
+            cachePath = argv[++i];
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            positionalArgs.push_back(arg);
+        }
+    }
+
+    if (positionalArgs.size() != 2) {
+        return PrintUsage();
+    }
+
+    string demoPath = positionalArgs[0];
+    char* steamIdEnd;
+    uint64_t steamId = strtoull(positionalArgs[1].c_str(), &steamIdEnd, 10);
+    if (*steamIdEnd != '\0' || steamId == 0) {
+        fprintf(stderr, "Invalid SteamID64: %s\n", positionalArgs[1].c_str());
+        return 2;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    MappedFile file;
+    DemoHeader header;
+    PlayerKills playerKills;
+    string error;
+    if (!file.Open(demoPath, error) || !ReadDemoHeader(file.Data(), file.Size(), header, error)) {
+        fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+        return 1;
+    }
+
+    if (cachePath.empty()) {
+        if (!ExtractPlayerKills(file.Data(), file.Size(), header, steamId, GetDefaultThreadCount(), playerKills,
+                                error)) {
+            fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+            return 1;
+        }
+    }
+    else {
+        AnalysisCache cache(cachePath);
+        if (!cache.LoadPlayerKills(header, file.Size(), steamId, playerKills)) {
+            DemoAnalysis analysis;
+            if (!AnalyzeDemo(file.Data(), file.Size(), header, GetDefaultThreadCount(), analysis, error)) {
+                fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+                return 1;
+            }
+            if (!cache.Store(header, file.Size(), analysis, error)) {
+                fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+            }
+            playerKills.tickrate = analysis.tickrate;
+            playerKills.tickCount = analysis.tickCount;
+            playerKills.kills = GetPlayerKills(analysis.kills, steamId);
+        }
+        PrintAnalysisCacheStats(cache);
+    }
+
+    ActionsFileGenerator generator(demoPath, header.source);
+    if (!outputPath.empty()) {
+        generator.SetFilePath(outputPath);
+    }
+    // Like the app, a previous actions file must not be used if the player has no kills.
+    remove(generator.GetFilePath().c_str());
+    if (playerKills.kills.empty()) {
+        fprintf(stderr, "No kills found for player %llu\n", (unsigned long long)steamId);
+        return 1;
+    }
+
+    GenerateHighlights(generator, header.source, playerKills, beforeDelaySeconds, nextDelaySeconds,
+                       isPlayerVoicesEnabled, isSplittingSequences);
+    if (!generator.Write(error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    fprintf(stderr, "Found %zu kills in %.1f ms, actions written to %s\n", playerKills.kills.size(), elapsedMs,
+            generator.GetFilePath().c_str());
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+// demo-tools index <demo or folder>... [--recursive] [--threads N] [--interval N] [--force] [--details]
+//                  [--output path]
+// demo-tools seek <demo> <tick>
+//
+// index walks the commands of demos once and writes a .dem.idx sidecar next to them with a sparse tick to file offset
+// table, the full packet positions and the round boundaries. Sidecars that are up to date are not rebuilt unless
+// --force is used. --details adds the index content to the output.
+// seek prints the cheapest position to load before playing the tick, the sidecar is used if it's up to date.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include "commands.h"
+#include "demo_files.h"
+#include "demo_header.h"
+#include "demo_index.h"
+#include "mapped_file.h"
+#include "output.h"
+#include "parallel.h"
+
+using nlohmann::json;
+using std::string;
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools index <demo or folder>... [--recursive] [--threads N] [--interval N] [--force] "
+                    "[--details] [--output path]\n"
+                    "       demo-tools seek <demo> <tick>\n");
+
+    return 2;
+}
+
+static json GetSeekPointsJson(const std::vector<SeekPoint>& points)
+{
+    json pointsJson = json::array();
+    for (const SeekPoint& point : points) {
+        pointsJson.push_back({point.tick, point.offset});
+    }
+
+    return pointsJson;
+}
+
+static json GetRoundsJson(const std::vector<RoundBoundary>& rounds)
+{
+    json roundsJson = json::array();
+    for (const RoundBoundary& round : rounds) {
+        roundsJson.push_back({
+            {"startTick", round.startTick},
+            {"startOffset", round.startOffset},
+            {"freezeEndTick", round.freezeEndTick},
+            {"endTick", round.endTick},
+        });
+    }
+
+    return roundsJson;
+}
+
+// Reads the sidecar if it's up to date, builds the index otherwise.
+static bool LoadDemoIndex(const string& demoPath, const MappedFile& file, const DemoHeader& header,
+                          int32_t seekInterval, bool isForced, DemoIndex& index, bool& isBuilt, string& error)
+{
+    string indexError;
+    if (!isForced && ReadDemoIndexFile(GetDemoIndexFilePath(demoPath), index, indexError)
+        && IsDemoIndexUpToDate(index, header, file.Size()) && index.seekInterval == seekInterval) {
+        isBuilt = false;
+        return true;
+    }
+
+    isBuilt = true;
+    return BuildDemoIndex(file.Data(), file.Size(), header, seekInterval, index, error);
+}
+
+static json IndexDemo(const string& demoPath, int32_t seekInterval, bool isForced, bool hasDetails,
+                      uint64_t& indexedByteCount)
+{
+    json result = {{"path", demoPath}};
+    MappedFile file;
+    DemoHeader header;
+    DemoIndex index;
+    string error;
+    bool isBuilt;
+    auto startTime = std::chrono::steady_clock::now();
+    if (!file.Open(demoPath, error) || !ReadDemoHeader(file.Data(), file.Size(), header, error)
+        || !LoadDemoIndex(demoPath, file, header, seekInterval, isForced, index, isBuilt, error)) {
+        result["error"] = error;
+        return result;
+    }
+
+    string indexPath = GetDemoIndexFilePath(demoPath);
+    if (isBuilt) {
+        indexedByteCount += file.Size();
+        if (!WriteDemoIndexFile(indexPath, index, error)) {
+            result["error"] = error;
+            return result;
+        }
+    }
+
+    result["indexPath"] = indexPath;
+    result["isUpToDate"] = !isBuilt;
+    result["isComplete"] = index.isComplete;
+    result["lastTick"] = index.lastTick;
+    result["seekPointCount"] = index.seekPoints.size();
+    result["fullPacketCount"] = index.fullPackets.size();
+    result["roundCount"] = index.rounds.size();
+    if (hasDetails) {
+        result["seekInterval"] = index.seekInterval;
+        result["seekPoints"] = GetSeekPointsJson(index.seekPoints);
+        result["fullPackets"] = GetSeekPointsJson(index.fullPackets);
+        result["rounds"] = GetRoundsJson(index.rounds);
+    }
+    else {
+        result["durationMs"] =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    return result;
+}
+
+int RunIndexCommand(int argc, char** argv)
+{
+    std::vector<string> paths;
+    string outputPath;
+    bool isRecursive = false;
+    bool isForced = false;
+    bool hasDetails = false;
+    int32_t seekInterval = DEFAULT_SEEK_INTERVAL;
+    unsigned int threadCount = GetDefaultThreadCount();
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--recursive") {
+            isRecursive = true;
+        }
+        else if (arg == "--force") {
+            isForced = true;
+        }
+        else if (arg == "--details") {
+            hasDetails = true;
+        }
+        else if (arg == "--threads" && hasValue) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "--interval" && hasValue) {
+            seekInterval = atoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() || threadCount == 0 || seekInterval <= 0) {
+        return PrintUsage();
+    }
+
+    std::vector<string> demoPaths;
+    string error;
+    if (!CollectDemoPaths(paths, isRecursive, demoPaths, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<json> results(demoPaths.size());
+    std::vector<uint64_t> indexedByteCounts(demoPaths.size(), 0);
+    ParallelFor(demoPaths.size(), threadCount, [&](size_t index) {
+        results[index] = IndexDemo(demoPaths[index], seekInterval, isForced, hasDetails, indexedByteCounts[index]);
+    });
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    int errorCount = 0;
+    uint64_t indexedByteCount = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].contains("error")) {
+            errorCount++;
+        }
+        indexedByteCount += indexedByteCounts[i];
+    }
+    double indexedMb = indexedByteCount / (1024.0 * 1024.0);
+    fprintf(stderr, "Indexed %zu demos (%d errors, %.1f MB) in %.1f ms with %u threads, %.1f MB/s\n", results.size(),
+            errorCount, indexedMb, elapsedMs, threadCount, elapsedMs > 0 ? indexedMb * 1000 / elapsedMs : 0);
+
+    bool isSingleFile = paths.size() == 1 && demoPaths.size() == 1 && demoPaths[0] == paths[0];
+    json output = isSingleFile ? results[0] : json(results);
+    if (!WriteJsonOutput(output, outputPath)) {
+        return 2;
+    }
+
+    return errorCount > 0 ? 1 : 0;
+}
+
+int RunSeekCommand(int argc, char** argv)
+{
+    if (argc != 2) {
+        return PrintUsage();
+    }
+
+    string demoPath = argv[0];
+    int32_t tick = atoi(argv[1]);
+    MappedFile file;
+    DemoHeader header;
+    DemoIndex index;
+    string error;
+    bool isBuilt;
+    if (!file.Open(demoPath, error) || !ReadDemoHeader(file.Data(), file.Size(), header, error)
+        || !LoadDemoIndex(demoPath, file, header, DEFAULT_SEEK_INTERVAL, false, index, isBuilt, error)) {
+        fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+        return 1;
+    }
+
+    SeekTarget target;
+    if (!FindSeekTarget(index, tick, target)) {
+        fprintf(stderr, "No seek target before tick %d\n", tick);
+        return 1;
+    }
+
+    json output = {
+        {"tick", tick},
+        {"seekTick", target.point.tick},
+        {"offset", target.point.offset},
+        {"simulatedTicks", target.simulatedTicks},
+        {"isFullPacket", target.isFullPacket},
+        {"isIndexed", !isBuilt},
+    };
+    WriteJsonOutput(output, "");
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Native tools reading demo files without loading them in the game.
+//
+// Usage: demo-tools <command> [arguments]
+// Commands:
+//   analyze   Analyzes demos in parallel and prints the result of each demo when it's done.
+//   decompress Decompresses .bz2 archives with their blocks decoded in parallel.
+//   header    Prints the header and the checksum of demos.
+//   highlights Writes the actions file of the highlights of a player.
+//   index     Writes the .dem.idx seek index sidecar of demos.
+//   parse     Parses the net messages of demos and prints the parsing statistics.
+//   seek      Prints the cheapest position to load before playing a tick.
+//   unpack    Decompresses a .dem.bz2 archive while it's downloaded and indexes the demo.
+
+#include <cstdio>
+#include <cstring>
+#include "commands.h"
+
+struct Command {
+    const char* name;
+    int (*run)(int argc, char** argv);
+};
+
+static const Command commands[] = {
+    {"analyze", RunAnalyzeCommand},
+    {"decompress", RunDecompressCommand},
+    {"header", RunHeaderCommand},
+    {"highlights", RunHighlightsCommand},
+    {"index", RunIndexCommand},
+    {"parse", RunParseCommand},
+    {"seek", RunSeekCommand},
+    {"unpack", RunUnpackCommand},
+};
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools <command> [arguments]\nCommands:\n");
+    for (const Command& command : commands) {
+        fprintf(stderr, "  %s\n", command.name);
+    }
+
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        return PrintUsage();
+    }
+
+    for (const Command& command : commands) {
+        if (strcmp(argv[1], command.name) == 0) {
+            return command.run(argc - 2, argv + 2);
+        }
+    }
+
+    return PrintUsage();
+}
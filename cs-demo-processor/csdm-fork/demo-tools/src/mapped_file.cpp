@@ -0,0 +1,129 @@
+#include "mapped_file.h"
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::string;
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const string& path, string& error)
+{
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "Failed to open file, error " + std::to_string(GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        error = "Failed to get file size, error " + std::to_string(GetLastError());
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    size = (size_t)fileSize.QuadPart;
+    // Empty files can't be mapped.
+    if (size == 0) {
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        error = "Failed to map file, error " + std::to_string(GetLastError());
+        Close();
+        return false;
+    }
+
+    mappingHandle = mapping;
+    data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        error = "Failed to map file, error " + std::to_string(GetLastError());
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+    }
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const string& path, string& error)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = string("Failed to open file: ") + strerror(errno);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        error = string("Failed to get file size: ") + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    size = (size_t)fileStat.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps a reference to the file.
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        error = string("Failed to map file: ") + strerror(errno);
+        size = 0;
+        return false;
+    }
+
+    data = (const uint8_t*)mapping;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != nullptr) {
+        munmap((void*)data, size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#endif
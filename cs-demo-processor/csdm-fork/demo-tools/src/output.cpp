@@ -0,0 +1,76 @@
+#include "output.h"
+#include <cstdio>
+#include <fstream>
+
+using nlohmann::json;
+using std::string;
+
+json GetDemoHeaderJson(const DemoHeader& header)
+{
+    json headerJson = {
+        {"filestamp", GetFilestamp(header.source)},
+        {"serverName", header.serverName},
+        {"clientName", header.clientName},
+        {"mapName", header.mapName},
+        {"networkProtocol", header.networkProtocol},
+    };
+
+    if (header.source == DemoSource::SOURCE_1) {
+        headerJson["playbackTime"] = header.playbackTime;
+        headerJson["playbackTicks"] = header.playbackTicks;
+        headerJson["playbackFrames"] = header.playbackFrames;
+        headerJson["signonLength"] = header.signonLength;
+    }
+    else {
+        headerJson["buildNumber"] = header.buildNumber;
+        headerJson["demoVersionGuid"] = header.demoVersionGuid;
+        headerJson["demoVersionName"] = header.demoVersionName;
+        headerJson["game"] = header.game;
+    }
+
+    return headerJson;
+}
+
+bool WriteJsonOutput(const json& output, const string& outputPath)
+{
+    string content = output.dump(2, ' ', false, json::error_handler_t::replace);
+    if (outputPath.empty()) {
+        printf("%s\n", content.c_str());
+        return true;
+    }
+
+    std::ofstream file(outputPath, std::ios::trunc);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to write %s\n", outputPath.c_str());
+        return false;
+    }
+    file << content;
+
+    return true;
+}
+
+JsonLinesWriter::~JsonLinesWriter()
+{
+    if (file != nullptr && file != stdout) {
+        fclose(file);
+    }
+}
+
+bool JsonLinesWriter::Open(const string& outputPath)
+{
+    file = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to write %s\n", outputPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void JsonLinesWriter::Write(const json& line)
+{
+    string content = line.dump(-1, ' ', false, json::error_handler_t::replace);
+    std::lock_guard<std::mutex> lock(mutex);
+    fprintf(file, "%s\n", content.c_str());
+    fflush(file);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "demo_header.h"
+
+// Same fields as the DemoHeader type of the app.
+nlohmann::json GetDemoHeaderJson(const DemoHeader& header);
+
+// Writes the JSON to the file or to stdout if the path is empty. Invalid UTF-8 (e.g. in paths) is replaced.
+bool WriteJsonOutput(const nlohmann::json& output, const std::string& outputPath);
+
+// Writes JSON objects one per line as they are produced, from any thread. Lines are flushed so the reader gets each
+// result as soon as it is ready.
+class JsonLinesWriter
+{
+public:
+    JsonLinesWriter() = default;
+    JsonLinesWriter(const JsonLinesWriter&) = delete;
+    JsonLinesWriter& operator=(const JsonLinesWriter&) = delete;
+    ~JsonLinesWriter();
+
+    // Writes to stdout if the path is empty.
+    bool Open(const std::string& outputPath);
+    void Write(const nlohmann::json& line);
+
+private:
+    std::mutex mutex;
+    FILE* file = nullptr;
+};
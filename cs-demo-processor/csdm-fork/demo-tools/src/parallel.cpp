@@ -0,0 +1,185 @@
+#include "parallel.h"
+#include <memory>
+#include <utility>
+
+// Tasks of a thread, the owner takes them from the front and thieves from the back.
+struct TaskQueue
+{
+    std::mutex mutex;
+    std::deque<size_t> indexes;
+};
+
+unsigned int GetDefaultThreadCount()
+{
+    unsigned int threadCount = std::thread::hardware_concurrency();
+
+    return threadCount > 0 ? threadCount : 1;
+}
+
+static bool PopTask(TaskQueue& queue, size_t& index)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.indexes.empty()) {
+        return false;
+    }
+
+    index = queue.indexes.front();
+    queue.indexes.pop_front();
+
+    return true;
+}
+
+// Moves the last half of the tasks of the busiest other queue to the thread queue, returns false when all the queues
+// are empty. Tasks never add tasks, so empty queues stay empty.
+static bool StealTasks(std::vector<std::unique_ptr<TaskQueue>>& queues, size_t thiefIndex)
+{
+    while (true) {
+        TaskQueue* victim = nullptr;
+        size_t victimTaskCount = 0;
+        for (size_t i = 0; i < queues.size(); i++) {
+            if (i == thiefIndex) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(queues[i]->mutex);
+            if (queues[i]->indexes.size() > victimTaskCount) {
+                victim = queues[i].get();
+                victimTaskCount = victim->indexes.size();
+            }
+        }
+
+        if (victim == nullptr) {
+            return false;
+        }
+
+        std::vector<size_t> stolenIndexes;
+        {
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            // The victim may have run some of its tasks since the scan.
+            size_t stolenCount = (victim->indexes.size() + 1) / 2;
+            stolenIndexes.assign(victim->indexes.end() - stolenCount, victim->indexes.end());
+            victim->indexes.resize(victim->indexes.size() - stolenCount);
+        }
+        if (stolenIndexes.empty()) {
+            continue;
+        }
+
+        TaskQueue& thiefQueue = *queues[thiefIndex];
+        std::lock_guard<std::mutex> lock(thiefQueue.mutex);
+        thiefQueue.indexes.insert(thiefQueue.indexes.end(), stolenIndexes.begin(), stolenIndexes.end());
+
+        return true;
+    }
+}
+
+void ParallelFor(size_t count, unsigned int threadCount, const std::function<void(size_t)>& task)
+{
+    if (threadCount > count) {
+        threadCount = (unsigned int)count;
+    }
+
+    if (threadCount <= 1) {
+        for (size_t index = 0; index < count; index++) {
+            task(index);
+        }
+        return;
+    }
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    for (unsigned int i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<TaskQueue>());
+    }
+    for (size_t index = 0; index < count; index++) {
+        queues[index % threadCount]->indexes.push_back(index);
+    }
+
+    auto worker = [&](size_t threadIndex) {
+        size_t index;
+        do {
+            while (PopTask(*queues[threadIndex], index)) {
+                task(index);
+            }
+        } while (StealTasks(queues, threadIndex));
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (unsigned int i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void MemoryBudget::Acquire(uint64_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [&]() { return usage == 0 || usage + size <= limit; });
+    usage += size;
+    if (usage > peakUsage) {
+        peakUsage = usage;
+    }
+}
+
+void MemoryBudget::Release(uint64_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        usage -= size;
+    }
+    released.notify_all();
+}
+
+uint64_t MemoryBudget::GetPeakUsage()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return peakUsage;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    for (unsigned int i = 0; i < threadCount; i++) {
+        threads.emplace_back([this]() { RunTasks(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    changed.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    changed.notify_one();
+}
+
+void ThreadPool::RunTasks()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return !tasks.empty() || isStopping; });
+            // The remaining tasks are run before stopping.
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
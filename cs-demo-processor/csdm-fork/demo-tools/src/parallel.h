@@ -0,0 +1,59 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Returns the number of hardware threads, at least 1.
+unsigned int GetDefaultThreadCount();
+// Calls task(index) for every index in [0, count) from up to threadCount threads, blocks until all tasks are done.
+// Indexes are dealt to the threads in turn and each thread runs its own ones in increasing order. A thread that runs
+// out of tasks steals the last half of the remaining tasks of the busiest thread, so a few long tasks don't leave the
+// other threads idle.
+void ParallelFor(size_t count, unsigned int threadCount, const std::function<void(size_t)>& task);
+
+// Bounds the total size of the resources used by concurrent tasks, e.g. the mapped demos and their buffers.
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(uint64_t limit) : limit(limit) {}
+
+    // Blocks until the size fits in the budget. A size larger than the whole budget is granted once nothing else is
+    // in use.
+    void Acquire(uint64_t size);
+    void Release(uint64_t size);
+    uint64_t GetPeakUsage();
+
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    uint64_t limit;
+    uint64_t usage = 0;
+    uint64_t peakUsage = 0;
+};
+
+// Runs the submitted tasks on a fixed number of threads in submission order, for tasks found while others run, e.g.
+// the blocks of a stream being read. The destructor waits for the submitted tasks.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task);
+
+private:
+    void RunTasks();
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> threads;
+    bool isStopping = false;
+};
@@ -0,0 +1,223 @@
+// demo-tools parse <demo or folder>... [--recursive] [--threads N] [--all-messages] [--output path]
+//
+// Parses the net messages of demos the way the other commands do (game events and string tables) and prints the
+// parsing statistics: the throughput per core and the heap allocations made while parsing, which must stay flat when
+// the demo grows. Messages of other types are skipped by their size, --all-messages decodes the fields of every
+// message instead to measure what skipping them saves.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include "allocation_stats.h"
+#include "commands.h"
+#include "demo_commands.h"
+#include "demo_files.h"
+#include "demo_header.h"
+#include "game_events.h"
+#include "mapped_file.h"
+#include "output.h"
+#include "parallel.h"
+#include "protobuf.h"
+#include "string_tables.h"
+
+using nlohmann::json;
+using std::string;
+
+struct ParseStats
+{
+    uint64_t commandCount = 0;
+    uint64_t packetCount = 0;
+    uint64_t malformedPacketCount = 0;
+    uint64_t messageCount = 0;
+    uint64_t decodedMessageCount = 0;
+    uint64_t gameEventCount = 0;
+    uint64_t stringTableEntryCount = 0;
+    uint64_t heapAllocationCount = 0;
+    uint64_t arenaBlockAllocationCount = 0;
+};
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools parse <demo or folder>... [--recursive] [--threads N] [--all-messages] "
+                    "[--output path]\n");
+
+    return 2;
+}
+
+static void DecodeFields(const uint8_t* data, size_t size)
+{
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+    }
+}
+
+static void ParseDemo(const uint8_t* data, size_t size, DemoSource source, bool isDecodingAllMessages,
+                      ParseStats& stats)
+{
+    uint64_t initialHeapAllocationCount = GetThreadHeapAllocationCount();
+    uint32_t eventListType = GetGameEventListMessageType(source);
+    uint32_t eventType = GetGameEventMessageType(source);
+    GameEventList eventList;
+    std::vector<GameEventKey> keys;
+    StringTables stringTables(source, "userinfo", [&](int32_t, const string&, const uint8_t*, size_t) {
+        stats.stringTableEntryCount++;
+    });
+    PacketBuffers buffers;
+    DemoCommand command;
+    DemoCommandReader reader(data, size, source);
+
+    // Built once, converting the lambdas for every packet would allocate.
+    NetMessageFilter filter = [&](uint32_t type) {
+        stats.messageCount++;
+        return isDecodingAllMessages || type == eventListType || type == eventType
+            || stringTables.IsStringTableMessage(type);
+    };
+    NetMessageHandler handler = [&](uint32_t type, const uint8_t* messageData, size_t messageSize) {
+        stats.decodedMessageCount++;
+        if (type == eventListType) {
+            eventList.Parse(messageData, messageSize);
+        }
+        else if (type == eventType) {
+            stats.gameEventCount++;
+            ReadGameEventKeys(messageData, messageSize, keys);
+        }
+        else if (stringTables.IsStringTableMessage(type)) {
+            stringTables.HandleMessage(type, messageData, messageSize);
+        }
+        else {
+            DecodeFields(messageData, messageSize);
+        }
+    };
+
+    while (reader.Next(command)) {
+        stats.commandCount++;
+        if (IsPacketCommand(source, command.command)) {
+            stats.packetCount++;
+            if (!ForEachNetMessage(source, command, buffers, filter, handler)) {
+                stats.malformedPacketCount++;
+            }
+        }
+    }
+
+    stats.arenaBlockAllocationCount = buffers.messages.GetBlockAllocationCount();
+    stats.heapAllocationCount = GetThreadHeapAllocationCount() - initialHeapAllocationCount;
+}
+
+static json ParseDemoFile(const string& demoPath, bool isDecodingAllMessages, uint64_t& parsedByteCount,
+                          double& parseMs)
+{
+    json result = {{"path", demoPath}};
+    MappedFile file;
+    DemoHeader header;
+    string error;
+    if (!file.Open(demoPath, error) || !ReadDemoHeader(file.Data(), file.Size(), header, error)) {
+        result["error"] = error;
+        return result;
+    }
+
+    ParseStats stats;
+    auto startTime = std::chrono::steady_clock::now();
+    ParseDemo(file.Data(), file.Size(), header.source, isDecodingAllMessages, stats);
+    parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    parsedByteCount = file.Size();
+
+    double mb = file.Size() / (1024.0 * 1024.0);
+    result["fileSize"] = file.Size();
+    result["commandCount"] = stats.commandCount;
+    result["packetCount"] = stats.packetCount;
+    result["malformedPacketCount"] = stats.malformedPacketCount;
+    result["messageCount"] = stats.messageCount;
+    result["decodedMessageCount"] = stats.decodedMessageCount;
+    result["gameEventCount"] = stats.gameEventCount;
+    result["stringTableEntryCount"] = stats.stringTableEntryCount;
+    result["heapAllocationCount"] = stats.heapAllocationCount;
+    result["arenaBlockAllocationCount"] = stats.arenaBlockAllocationCount;
+    result["durationMs"] = parseMs;
+    result["mbPerSecond"] = parseMs > 0 ? mb * 1000 / parseMs : 0;
+
+    return result;
+}
+
+int RunParseCommand(int argc, char** argv)
+{
+    std::vector<string> paths;
+    string outputPath;
+    bool isRecursive = false;
+    bool isDecodingAllMessages = false;
+    unsigned int threadCount = GetDefaultThreadCount();
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--recursive") {
+            isRecursive = true;
+        }
+        else if (arg == "--all-messages") {
+            isDecodingAllMessages = true;
+        }
+        else if (arg == "--threads" && hasValue) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty() || threadCount == 0) {
+        return PrintUsage();
+    }
+
+    std::vector<string> demoPaths;
+    string error;
+    if (!CollectDemoPaths(paths, isRecursive, demoPaths, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<json> results(demoPaths.size());
+    std::vector<uint64_t> parsedByteCounts(demoPaths.size(), 0);
+    std::vector<double> parseDurations(demoPaths.size(), 0);
+    ParallelFor(demoPaths.size(), threadCount, [&](size_t index) {
+        results[index] =
+            ParseDemoFile(demoPaths[index], isDecodingAllMessages, parsedByteCounts[index], parseDurations[index]);
+    });
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    int errorCount = 0;
+    uint64_t parsedByteCount = 0;
+    uint64_t heapAllocationCount = 0;
+    double parseMs = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].contains("error")) {
+            errorCount++;
+            continue;
+        }
+        parsedByteCount += parsedByteCounts[i];
+        parseMs += parseDurations[i];
+        heapAllocationCount += results[i]["heapAllocationCount"].get<uint64_t>();
+    }
+    // The sum of the parsing durations is the CPU time spent, whatever the number of threads.
+    double parsedMb = parsedByteCount / (1024.0 * 1024.0);
+    fprintf(stderr,
+            "Parsed %zu demos (%d errors, %.1f MB) in %.1f ms with %u threads, %.1f MB/s per core, %llu heap "
+            "allocations (%.1f per MB)\n",
+            results.size(), errorCount, parsedMb, elapsedMs, threadCount, parseMs > 0 ? parsedMb * 1000 / parseMs : 0,
+            (unsigned long long)heapAllocationCount, parsedMb > 0 ? heapAllocationCount / parsedMb : 0);
+
+    bool isSingleFile = paths.size() == 1 && demoPaths.size() == 1 && demoPaths[0] == paths[0];
+    json output = isSingleFile ? results[0] : json(results);
+    if (!WriteJsonOutput(output, outputPath)) {
+        return 2;
+    }
+
+    return errorCount > 0 ? 1 : 0;
+}
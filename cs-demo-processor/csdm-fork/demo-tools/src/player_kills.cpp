@@ -0,0 +1,30 @@
+#include "player_kills.h"
+#include "demo_analysis.h"
+
+bool ExtractPlayerKills(const uint8_t* data, size_t size, const DemoHeader& header, uint64_t steamId,
+                        unsigned int threadCount, PlayerKills& result, std::string& error)
+{
+    result = PlayerKills();
+    DemoAnalysis analysis;
+    if (!AnalyzeDemo(data, size, header, threadCount, analysis, error)) {
+        return false;
+    }
+
+    result.tickrate = analysis.tickrate;
+    result.tickCount = analysis.tickCount;
+    result.kills = GetPlayerKills(analysis.kills, steamId);
+
+    return true;
+}
+
+std::vector<PlayerKill> GetPlayerKills(const std::vector<PlayerKill>& kills, uint64_t steamId)
+{
+    std::vector<PlayerKill> playerKills;
+    for (const PlayerKill& kill : kills) {
+        if (kill.killerSteamId == steamId && kill.victimSteamId != steamId) {
+            playerKills.push_back(kill);
+        }
+    }
+
+    return playerKills;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "demo_header.h"
+
+#define DEFAULT_TICKRATE 64
+
+struct PlayerKill
+{
+    int32_t tick;
+    // Player entity index, the value expected by spec_player in CS2.
+    int32_t killerSlot;
+    uint64_t killerSteamId;
+    int32_t victimSlot;
+    uint64_t victimSteamId;
+};
+
+struct PlayerKills
+{
+    double tickrate = DEFAULT_TICKRATE;
+    int32_t tickCount = 0;
+    // Sorted by tick.
+    std::vector<PlayerKill> kills;
+};
+
+// Streams the player_death events of a demo and keeps the kills made by the player, suicides and kills of unknown
+// players excluded, like the kills query of src/node/database/watch/get-match-playback.ts.
+bool ExtractPlayerKills(const uint8_t* data, size_t size, const DemoHeader& header, uint64_t steamId,
+                        unsigned int threadCount, PlayerKills& result, std::string& error);
+// Keeps the kills made by the player from all the kills of a demo, suicides excluded.
+std::vector<PlayerKill> GetPlayerKills(const std::vector<PlayerKill>& kills, uint64_t steamId);
@@ -0,0 +1,111 @@
+#include "players.h"
+#include <cstring>
+#include "protobuf.h"
+
+// player_info_t layout, integers are big-endian.
+#define S1_PLAYER_INFO_XUID_OFFSET 8
+#define S1_PLAYER_INFO_NAME_OFFSET 16
+#define S1_PLAYER_INFO_NAME_LENGTH 128
+#define S1_PLAYER_INFO_USER_ID_OFFSET 144
+#define S1_PLAYER_INFO_MIN_SIZE 148
+// CMsgPlayerInfo field numbers.
+#define FIELD_PLAYER_NAME 1
+#define FIELD_PLAYER_XUID 2
+#define FIELD_PLAYER_USER_ID 3
+#define FIELD_PLAYER_STEAM_ID 4
+
+static uint64_t ReadBigEndian(const uint8_t* data, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value = (value << 8) | data[i];
+    }
+
+    return value;
+}
+
+bool ParsePlayerInfo(DemoSource source, int32_t slot, const uint8_t* data, size_t size, PlayerInfo& player)
+{
+    player = PlayerInfo();
+    player.slot = slot;
+    if (source == DemoSource::SOURCE_1) {
+        if (size < S1_PLAYER_INFO_MIN_SIZE) {
+            return false;
+        }
+        player.steamId = ReadBigEndian(data + S1_PLAYER_INFO_XUID_OFFSET, 8);
+        const char* name = (const char*)data + S1_PLAYER_INFO_NAME_OFFSET;
+        player.name = std::string(name, strnlen(name, S1_PLAYER_INFO_NAME_LENGTH));
+        player.userId = (int32_t)ReadBigEndian(data + S1_PLAYER_INFO_USER_ID_OFFSET, 4);
+        return true;
+    }
+
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        switch (field.number) {
+        case FIELD_PLAYER_NAME:
+            if (field.IsBytes()) {
+                player.name = field.GetString();
+            }
+            break;
+        case FIELD_PLAYER_XUID:
+            if (player.steamId == 0) {
+                player.steamId = field.value;
+            }
+            break;
+        case FIELD_PLAYER_STEAM_ID:
+            if (field.value != 0) {
+                player.steamId = field.value;
+            }
+            break;
+        case FIELD_PLAYER_USER_ID:
+            player.userId = field.GetInt32();
+            break;
+        }
+    }
+
+    return !reader.HasError();
+}
+
+void PlayerList::Update(int32_t slot, const uint8_t* data, size_t size)
+{
+    PlayerInfo player;
+    // Entries without data are players who left.
+    if (size == 0 || !ParsePlayerInfo(source, slot, data, size, player)) {
+        for (auto it = players.begin(); it != players.end(); ++it) {
+            if (it->second.slot == slot) {
+                players.erase(it);
+                break;
+            }
+        }
+        return;
+    }
+
+    int32_t eventId = source == DemoSource::SOURCE_1 ? player.userId : slot;
+    players[eventId] = player;
+}
+
+const PlayerInfo* PlayerList::GetByEventId(int32_t id) const
+{
+    auto it = players.find(id);
+
+    return it != players.end() ? &it->second : nullptr;
+}
+
+bool PlayerList::HasSamePlayers(const PlayerList& other) const
+{
+    if (players.size() != other.players.size()) {
+        return false;
+    }
+
+    for (const auto& entry : players) {
+        const PlayerInfo* otherPlayer = other.GetByEventId(entry.first);
+        const PlayerInfo& player = entry.second;
+        if (otherPlayer == nullptr || otherPlayer->slot != player.slot || otherPlayer->userId != player.userId
+            || otherPlayer->steamId != player.steamId || otherPlayer->name != player.name) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "demo_header.h"
+
+struct PlayerInfo
+{
+    // Index of the entry in the userinfo string table, the player entity index minus 1.
+    int32_t slot = -1;
+    // Source 1 game events reference players by user id, Source 2 ones by slot.
+    int32_t userId = -1;
+    uint64_t steamId = 0;
+    std::string name;
+};
+
+// Decodes a userinfo string table entry: player_info_t for Source 1 demos, CMsgPlayerInfo for Source 2 ones.
+bool ParsePlayerInfo(DemoSource source, int32_t slot, const uint8_t* data, size_t size, PlayerInfo& player);
+
+// Players of a demo indexed by the id used in game events.
+class PlayerList
+{
+public:
+    explicit PlayerList(DemoSource source) : source(source) {}
+
+    void Update(int32_t slot, const uint8_t* data, size_t size);
+    void Clear() { players.clear(); }
+    bool HasSamePlayers(const PlayerList& other) const;
+    // Returns null if the player is unknown.
+    const PlayerInfo* GetByEventId(int32_t id) const;
+
+private:
+    DemoSource source;
+    std::unordered_map<int32_t, PlayerInfo> players;
+};
@@ -0,0 +1,86 @@
+#include "protobuf.h"
+#include <cstring>
+
+float ProtoField::GetFloat() const
+{
+    uint32_t bits = (uint32_t)value;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+
+    return result;
+}
+
+bool ReadVarInt(const uint8_t*& cursor, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+        uint8_t byte = *cursor++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint64_t ReadLittleEndian(const uint8_t* data, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value |= (uint64_t)data[i] << (i * 8);
+    }
+
+    return value;
+}
+
+bool ProtoReader::Next(ProtoField& field)
+{
+    if (cursor >= end || hasError) {
+        return false;
+    }
+
+    uint64_t key;
+    if (!ReadVarInt(cursor, end, key)) {
+        hasError = true;
+        return false;
+    }
+
+    field.number = (uint32_t)(key >> 3);
+    field.wireType = (uint32_t)(key & 7);
+    field.data = nullptr;
+    field.size = 0;
+    switch (field.wireType) {
+    case WIRE_TYPE_VARINT:
+        if (!ReadVarInt(cursor, end, field.value)) {
+            hasError = true;
+            return false;
+        }
+        break;
+    case WIRE_TYPE_FIXED64:
+    case WIRE_TYPE_FIXED32: {
+        size_t length = field.wireType == WIRE_TYPE_FIXED64 ? 8 : 4;
+        if ((size_t)(end - cursor) < length) {
+            hasError = true;
+            return false;
+        }
+        field.value = ReadLittleEndian(cursor, length);
+        cursor += length;
+        break;
+    }
+    case WIRE_TYPE_LENGTH_DELIMITED:
+        if (!ReadVarInt(cursor, end, field.value) || field.value > (uint64_t)(end - cursor)) {
+            hasError = true;
+            return false;
+        }
+        field.data = cursor;
+        field.size = (size_t)field.value;
+        cursor += field.size;
+        break;
+    default:
+        hasError = true;
+        return false;
+    }
+
+    return true;
+}
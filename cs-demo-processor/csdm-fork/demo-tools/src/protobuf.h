@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#define WIRE_TYPE_VARINT 0
+#define WIRE_TYPE_FIXED64 1
+#define WIRE_TYPE_LENGTH_DELIMITED 2
+#define WIRE_TYPE_FIXED32 5
+
+struct ProtoField
+{
+    uint32_t number = 0;
+    uint32_t wireType = 0;
+    // Varint and fixed values.
+    uint64_t value = 0;
+    // Length-delimited values point into the message buffer.
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    std::string GetString() const { return std::string((const char*)data, size); }
+    // Doesn't copy the value, only valid as long as the message buffer.
+    std::string_view GetStringView() const { return std::string_view((const char*)data, size); }
+    int32_t GetInt32() const { return (int32_t)value; }
+    float GetFloat() const;
+    bool IsVarInt() const { return wireType == WIRE_TYPE_VARINT; }
+    bool IsBytes() const { return wireType == WIRE_TYPE_LENGTH_DELIMITED; }
+};
+
+bool ReadVarInt(const uint8_t*& cursor, const uint8_t* end, uint64_t& value);
+
+// Iterates over the fields of a serialized protobuf message without decoding them, nested messages are read with
+// another reader over the field bytes.
+class ProtoReader
+{
+public:
+    ProtoReader(const uint8_t* data, size_t size) : cursor(data), end(data + size) {}
+
+    // Returns false at the end of the message or if it's malformed.
+    bool Next(ProtoField& field);
+    bool HasError() const { return hasError; }
+
+private:
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool hasError = false;
+};
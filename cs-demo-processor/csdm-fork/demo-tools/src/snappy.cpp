@@ -0,0 +1,95 @@
+#include "snappy.h"
+#include <cstring>
+#include "protobuf.h"
+
+#define TAG_LITERAL 0
+#define TAG_COPY_1 1
+#define TAG_COPY_2 2
+#define TAG_COPY_4 3
+// Bigger values are considered corrupted, the biggest Source 2 commands are a few MB.
+#define MAX_UNCOMPRESSED_SIZE (256 * 1024 * 1024)
+
+static uint32_t ReadLittleEndian(const uint8_t* data, int size)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= (uint32_t)data[i] << (i * 8);
+    }
+
+    return value;
+}
+
+bool SnappyUncompress(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + size;
+    uint64_t uncompressedSize;
+    if (!ReadVarInt(cursor, end, uncompressedSize) || uncompressedSize > MAX_UNCOMPRESSED_SIZE) {
+        return false;
+    }
+
+    output.resize((size_t)uncompressedSize);
+    uint8_t* outputData = output.data();
+    size_t outputSize = 0;
+    while (cursor < end) {
+        uint8_t tag = *cursor++;
+        size_t length;
+        size_t offset;
+        switch (tag & 3) {
+        case TAG_LITERAL:
+            length = tag >> 2;
+            if (length >= 60) {
+                int byteCount = (int)length - 59;
+                if (end - cursor < byteCount) {
+                    return false;
+                }
+                length = ReadLittleEndian(cursor, byteCount);
+                cursor += byteCount;
+            }
+            length++;
+            if ((size_t)(end - cursor) < length || uncompressedSize - outputSize < length) {
+                return false;
+            }
+            memcpy(outputData + outputSize, cursor, length);
+            cursor += length;
+            outputSize += length;
+            continue;
+        case TAG_COPY_1:
+            if (end - cursor < 1) {
+                return false;
+            }
+            length = ((tag >> 2) & 7) + 4;
+            offset = ((size_t)(tag >> 5) << 8) | *cursor++;
+            break;
+        case TAG_COPY_2:
+            if (end - cursor < 2) {
+                return false;
+            }
+            length = (tag >> 2) + 1;
+            offset = ReadLittleEndian(cursor, 2);
+            cursor += 2;
+            break;
+        default:
+            if (end - cursor < 4) {
+                return false;
+            }
+            length = (tag >> 2) + 1;
+            offset = ReadLittleEndian(cursor, 4);
+            cursor += 4;
+            break;
+        }
+
+        if (offset == 0 || offset > outputSize || uncompressedSize - outputSize < length) {
+            return false;
+        }
+
+        // Copies can overlap their source to repeat a pattern.
+        const uint8_t* source = outputData + outputSize - offset;
+        for (size_t i = 0; i < length; i++) {
+            outputData[outputSize + i] = source[i];
+        }
+        outputSize += length;
+    }
+
+    return outputSize == uncompressedSize;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decompresses a raw Snappy block, the format of compressed Source 2 demo commands.
+bool SnappyUncompress(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
@@ -0,0 +1,379 @@
+#include "string_tables.h"
+#include "bit_reader.h"
+#include "protobuf.h"
+#include "snappy.h"
+
+using std::string;
+
+// Entries can reuse the beginning of one of the last 32 keys.
+#define KEY_HISTORY_SIZE 32
+#define SUBSTRING_BITS 5
+#define S1_MAX_USER_DATA_BITS 14
+#define S2_MAX_USER_DATA_BITS 17
+// Source 2 table flag telling that values may be compressed.
+#define S2_TABLE_FLAG_COMPRESSED_VALUES 1
+
+// CSVCMsg_CreateStringTable field numbers, Source 2 doesn't have max_entries so the following fields are shifted.
+#define S1_FIELD_CREATE_NAME 1
+#define S1_FIELD_CREATE_MAX_ENTRIES 2
+#define S1_FIELD_CREATE_NUM_ENTRIES 3
+#define S1_FIELD_CREATE_USER_DATA_FIXED_SIZE 4
+#define S1_FIELD_CREATE_USER_DATA_SIZE_BITS 6
+#define S1_FIELD_CREATE_FLAGS 7
+#define S1_FIELD_CREATE_STRING_DATA 8
+#define S2_FIELD_CREATE_NAME 1
+#define S2_FIELD_CREATE_NUM_ENTRIES 2
+#define S2_FIELD_CREATE_USER_DATA_FIXED_SIZE 3
+#define S2_FIELD_CREATE_USER_DATA_SIZE_BITS 5
+#define S2_FIELD_CREATE_FLAGS 6
+#define S2_FIELD_CREATE_STRING_DATA 7
+#define S2_FIELD_CREATE_DATA_COMPRESSED 9
+#define S2_FIELD_CREATE_USING_VARINT_BITCOUNTS 10
+// CSVCMsg_UpdateStringTable field numbers.
+#define FIELD_UPDATE_TABLE_ID 1
+#define FIELD_UPDATE_NUM_CHANGED_ENTRIES 2
+#define FIELD_UPDATE_STRING_DATA 3
+
+// CDemoStringTables field numbers, its table_t and items_t messages.
+#define FIELD_SNAPSHOT_TABLES 1
+#define FIELD_SNAPSHOT_TABLE_NAME 1
+#define FIELD_SNAPSHOT_TABLE_ITEMS 2
+#define FIELD_SNAPSHOT_ITEM_KEY 1
+#define FIELD_SNAPSHOT_ITEM_DATA 2
+
+static bool ReadSnapshotTableItems(const uint8_t* data, size_t size, const StringTableEntryHandler& handler)
+{
+    int32_t index = 0;
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number != FIELD_SNAPSHOT_TABLE_ITEMS || !field.IsBytes()) {
+            continue;
+        }
+
+        // Items are stored by entry index.
+        string key;
+        const uint8_t* value = nullptr;
+        size_t valueSize = 0;
+        ProtoReader itemReader(field.data, field.size);
+        ProtoField itemField;
+        while (itemReader.Next(itemField)) {
+            if (itemField.number == FIELD_SNAPSHOT_ITEM_KEY && itemField.IsBytes()) {
+                key = itemField.GetString();
+            }
+            else if (itemField.number == FIELD_SNAPSHOT_ITEM_DATA && itemField.IsBytes()) {
+                value = itemField.data;
+                valueSize = itemField.size;
+            }
+        }
+        if (itemReader.HasError()) {
+            return false;
+        }
+
+        handler(index++, key, value, valueSize);
+    }
+
+    return !reader.HasError();
+}
+
+bool ReadStringTableSnapshot(const uint8_t* data, size_t size, const string& tableName,
+                             const StringTableEntryHandler& handler)
+{
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number != FIELD_SNAPSHOT_TABLES || !field.IsBytes()) {
+            continue;
+        }
+
+        ProtoReader tableReader(field.data, field.size);
+        ProtoField tableField;
+        while (tableReader.Next(tableField)) {
+            if (tableField.number == FIELD_SNAPSHOT_TABLE_NAME && tableField.IsBytes()) {
+                if (tableField.GetStringView() != tableName) {
+                    break;
+                }
+
+                return ReadSnapshotTableItems(field.data, field.size, handler);
+            }
+        }
+    }
+
+    return false;
+}
+
+StringTables::StringTables(DemoSource source, const string& watchedTableName, const StringTableEntryHandler& handler)
+    : source(source), watchedTableName(watchedTableName), handler(handler)
+{
+}
+
+bool StringTables::IsStringTableMessage(uint32_t type) const
+{
+    if (source == DemoSource::SOURCE_1) {
+        return type == S1_SVC_CREATE_STRING_TABLE || type == S1_SVC_UPDATE_STRING_TABLE;
+    }
+
+    return type == S2_SVC_CREATE_STRING_TABLE || type == S2_SVC_UPDATE_STRING_TABLE
+        || type == S2_SVC_CLEAR_ALL_STRING_TABLES;
+}
+
+bool StringTables::HandleMessage(uint32_t type, const uint8_t* data, size_t size)
+{
+    switch (type) {
+    case S1_SVC_CREATE_STRING_TABLE:
+    case S2_SVC_CREATE_STRING_TABLE:
+        return HandleCreateMessage(data, size);
+    case S1_SVC_UPDATE_STRING_TABLE:
+    case S2_SVC_UPDATE_STRING_TABLE:
+        return HandleUpdateMessage(data, size);
+    case S2_SVC_CLEAR_ALL_STRING_TABLES:
+        tables.clear();
+        return true;
+    }
+
+    return true;
+}
+
+bool StringTables::HandleCreateMessage(const uint8_t* data, size_t size)
+{
+    bool isSource1 = source == DemoSource::SOURCE_1;
+    Table table;
+    int32_t entryCount = 0;
+    const uint8_t* stringData = nullptr;
+    size_t stringDataSize = 0;
+    bool isDataCompressed = false;
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == (isSource1 ? S1_FIELD_CREATE_NAME : S2_FIELD_CREATE_NAME) && field.IsBytes()) {
+            table.name = field.GetString();
+        }
+        else if (field.number == (isSource1 ? S1_FIELD_CREATE_STRING_DATA : S2_FIELD_CREATE_STRING_DATA)
+                 && field.IsBytes()) {
+            stringData = field.data;
+            stringDataSize = field.size;
+        }
+        else if (!field.IsVarInt()) {
+            continue;
+        }
+        else if (isSource1 && field.number == S1_FIELD_CREATE_MAX_ENTRIES) {
+            table.maxEntries = field.GetInt32();
+        }
+        else if (field.number == (isSource1 ? S1_FIELD_CREATE_NUM_ENTRIES : S2_FIELD_CREATE_NUM_ENTRIES)) {
+            entryCount = field.GetInt32();
+        }
+        else if (field.number
+                 == (isSource1 ? S1_FIELD_CREATE_USER_DATA_FIXED_SIZE : S2_FIELD_CREATE_USER_DATA_FIXED_SIZE)) {
+            table.isUserDataFixedSize = field.value != 0;
+        }
+        else if (field.number
+                 == (isSource1 ? S1_FIELD_CREATE_USER_DATA_SIZE_BITS : S2_FIELD_CREATE_USER_DATA_SIZE_BITS)) {
+            table.userDataSizeBits = field.GetInt32();
+        }
+        else if (field.number == (isSource1 ? S1_FIELD_CREATE_FLAGS : S2_FIELD_CREATE_FLAGS)) {
+            table.flags = field.GetInt32();
+        }
+        else if (!isSource1 && field.number == S2_FIELD_CREATE_DATA_COMPRESSED) {
+            isDataCompressed = field.value != 0;
+        }
+        else if (!isSource1 && field.number == S2_FIELD_CREATE_USING_VARINT_BITCOUNTS) {
+            table.isUsingVarIntBitCounts = field.value != 0;
+        }
+    }
+
+    if (reader.HasError()) {
+        return false;
+    }
+
+    tables.push_back(table);
+    if (table.name != watchedTableName || stringData == nullptr) {
+        return true;
+    }
+
+    if (isDataCompressed) {
+        if (!SnappyUncompress(stringData, stringDataSize, uncompressedData)) {
+            return false;
+        }
+        stringData = uncompressedData.data();
+        stringDataSize = uncompressedData.size();
+    }
+
+    return ParseEntries(table, entryCount, stringData, stringDataSize);
+}
+
+bool StringTables::HandleUpdateMessage(const uint8_t* data, size_t size)
+{
+    int32_t tableId = -1;
+    int32_t entryCount = 0;
+    const uint8_t* stringData = nullptr;
+    size_t stringDataSize = 0;
+    ProtoReader reader(data, size);
+    ProtoField field;
+    while (reader.Next(field)) {
+        if (field.number == FIELD_UPDATE_TABLE_ID && field.IsVarInt()) {
+            tableId = field.GetInt32();
+        }
+        else if (field.number == FIELD_UPDATE_NUM_CHANGED_ENTRIES && field.IsVarInt()) {
+            entryCount = field.GetInt32();
+        }
+        else if (field.number == FIELD_UPDATE_STRING_DATA && field.IsBytes()) {
+            stringData = field.data;
+            stringDataSize = field.size;
+        }
+    }
+
+    if (reader.HasError() || tableId < 0 || (size_t)tableId >= tables.size()) {
+        return false;
+    }
+
+    const Table& table = tables[tableId];
+    if (table.name != watchedTableName || stringData == nullptr) {
+        return true;
+    }
+
+    return ParseEntries(table, entryCount, stringData, stringDataSize);
+}
+
+bool StringTables::ParseEntries(const Table& table, int32_t entryCount, const uint8_t* data, size_t size)
+{
+    if (source == DemoSource::SOURCE_1) {
+        return ParseSource1Entries(table, entryCount, data, size);
+    }
+
+    return ParseSource2Entries(table, entryCount, data, size);
+}
+
+static int GetBitCount(int32_t value)
+{
+    int bitCount = 0;
+    while (value > 1) {
+        value >>= 1;
+        bitCount++;
+    }
+
+    return bitCount;
+}
+
+static void AddToHistory(std::vector<string>& history, const string& key)
+{
+    if (history.size() == KEY_HISTORY_SIZE) {
+        history.erase(history.begin());
+    }
+    history.push_back(key);
+}
+
+static string ReadKey(BitReader& reader, const std::vector<string>& history)
+{
+    string key;
+    // The key may start with a substring of a previous key.
+    if (reader.ReadBit()) {
+        uint32_t index = reader.ReadBits(SUBSTRING_BITS);
+        uint32_t length = reader.ReadBits(SUBSTRING_BITS);
+        if (index < history.size()) {
+            key = history[index].substr(0, length);
+        }
+    }
+    key += reader.ReadString();
+
+    return key;
+}
+
+bool StringTables::ParseSource1Entries(const Table& table, int32_t entryCount, const uint8_t* data, size_t size)
+{
+    BitReader reader(data, size);
+    // Dictionary encoding has never been used in demos.
+    if (reader.ReadBit()) {
+        return false;
+    }
+
+    int entryBits = GetBitCount(table.maxEntries);
+    std::vector<string> history;
+    int32_t index = -1;
+    for (int32_t i = 0; i < entryCount && !reader.IsOverflowed(); i++) {
+        index++;
+        if (!reader.ReadBit()) {
+            index = (int32_t)reader.ReadBits(entryBits);
+        }
+
+        // Entries without key are added to the history too.
+        string key;
+        if (reader.ReadBit()) {
+            key = ReadKey(reader, history);
+        }
+        AddToHistory(history, key);
+
+        size_t valueSize = 0;
+        if (reader.ReadBit()) {
+            size_t bitCount = table.isUserDataFixedSize ? table.userDataSizeBits
+                                                         : reader.ReadBits(S1_MAX_USER_DATA_BITS) * 8;
+            valueSize = (bitCount + 7) / 8;
+            value.resize(valueSize);
+            reader.ReadBitsToBytes(value.data(), bitCount);
+        }
+
+        if (!reader.IsOverflowed()) {
+            handler(index, key, value.data(), valueSize);
+        }
+    }
+
+    return !reader.IsOverflowed();
+}
+
+bool StringTables::ParseSource2Entries(const Table& table, int32_t entryCount, const uint8_t* data, size_t size)
+{
+    BitReader reader(data, size);
+    std::vector<string> history;
+    int32_t index = -1;
+    for (int32_t i = 0; i < entryCount && !reader.IsOverflowed(); i++) {
+        if (reader.ReadBit()) {
+            index++;
+        }
+        else {
+            index += (int32_t)reader.ReadVarUInt32() + 2;
+        }
+
+        string key;
+        if (reader.ReadBit()) {
+            key = ReadKey(reader, history);
+            AddToHistory(history, key);
+        }
+
+        const uint8_t* valueData = nullptr;
+        size_t valueSize = 0;
+        if (reader.ReadBit()) {
+            bool isCompressed = false;
+            size_t bitCount;
+            if (table.isUserDataFixedSize) {
+                bitCount = table.userDataSizeBits;
+            }
+            else {
+                if (table.flags & S2_TABLE_FLAG_COMPRESSED_VALUES) {
+                    isCompressed = reader.ReadBit();
+                }
+                bitCount = (table.isUsingVarIntBitCounts ? reader.ReadUBitVar() : reader.ReadBits(S2_MAX_USER_DATA_BITS))
+                    * (size_t)8;
+            }
+
+            if (bitCount > reader.GetRemainingBits()) {
+                return false;
+            }
+            valueSize = (bitCount + 7) / 8;
+            value.resize(valueSize);
+            reader.ReadBitsToBytes(value.data(), bitCount);
+            valueData = value.data();
+            if (isCompressed) {
+                if (!SnappyUncompress(value.data(), valueSize, uncompressedValue)) {
+                    return false;
+                }
+                valueData = uncompressedValue.data();
+                valueSize = uncompressedValue.size();
+            }
+        }
+
+        if (!reader.IsOverflowed()) {
+            handler(index, key, valueData, valueSize);
+        }
+    }
+
+    return !reader.IsOverflowed();
+}
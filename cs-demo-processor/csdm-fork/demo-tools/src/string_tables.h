@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "demo_header.h"
+
+// svc_CreateStringTable and svc_UpdateStringTable from the Source 1 netmessages.proto.
+#define S1_SVC_CREATE_STRING_TABLE 12
+#define S1_SVC_UPDATE_STRING_TABLE 13
+// Same messages in the Source 2 netmessages.proto.
+#define S2_SVC_CREATE_STRING_TABLE 44
+#define S2_SVC_UPDATE_STRING_TABLE 45
+#define S2_SVC_CLEAR_ALL_STRING_TABLES 51
+
+typedef std::function<void(int32_t index, const std::string& key, const uint8_t* value, size_t size)>
+    StringTableEntryHandler;
+
+// Calls the handler for the entries of a table in a CDemoStringTables message, the snapshot of all the string tables
+// stored in DEM_StringTables commands and Source 2 full packets. Returns false if the message is malformed or doesn't
+// contain the table.
+bool ReadStringTableSnapshot(const uint8_t* data, size_t size, const std::string& tableName,
+                             const StringTableEntryHandler& handler);
+
+// Tracks the string tables created by a demo and decodes the entries of a single table. Other tables are only
+// registered because updates reference tables by their creation order.
+class StringTables
+{
+public:
+    StringTables(DemoSource source, const std::string& watchedTableName, const StringTableEntryHandler& handler);
+
+    bool IsStringTableMessage(uint32_t type) const;
+    // Returns false if the message is malformed.
+    bool HandleMessage(uint32_t type, const uint8_t* data, size_t size);
+
+private:
+    struct Table
+    {
+        std::string name;
+        int32_t maxEntries = 0;
+        bool isUserDataFixedSize = false;
+        int32_t userDataSizeBits = 0;
+        int32_t flags = 0;
+        bool isUsingVarIntBitCounts = false;
+    };
+
+    bool HandleCreateMessage(const uint8_t* data, size_t size);
+    bool HandleUpdateMessage(const uint8_t* data, size_t size);
+    bool ParseEntries(const Table& table, int32_t entryCount, const uint8_t* data, size_t size);
+    bool ParseSource1Entries(const Table& table, int32_t entryCount, const uint8_t* data, size_t size);
+    bool ParseSource2Entries(const Table& table, int32_t entryCount, const uint8_t* data, size_t size);
+
+    DemoSource source;
+    std::string watchedTableName;
+    StringTableEntryHandler handler;
+    std::vector<Table> tables;
+    std::vector<uint8_t> uncompressedData;
+    std::vector<uint8_t> value;
+    std::vector<uint8_t> uncompressedValue;
+};
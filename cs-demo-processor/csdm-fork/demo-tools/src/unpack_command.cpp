@@ -0,0 +1,468 @@
+// demo-tools unpack <archive.dem.bz2 or -> <demo> [--threads N] [--interval N] [--output path]
+// demo-tools decompress <archive.bz2>... [--threads N] [--output path]
+//
+// unpack decompresses a .dem.bz2 archive while it's downloaded. The archive is read from stdin with -, e.g. piped from
+// the HTTP response, and every decompressed bzip2 block is written to the demo and indexed right away. The header is
+// printed as a JSON line as soon as its bytes are decompressed. When the archive ends, the .dem.idx sidecar is written
+// and a last line gives the checksum and the index summary, so the demo is ready for recording when the download ends.
+// The demo is written to <demo>.part and renamed once complete, an interrupted download never leaves a partial demo.
+// decompress writes each archive next to it without the .bz2 extension, one archive after the other.
+// The bzip2 blocks are decoded by --threads threads, the output is the same with any count.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include "bzip2.h"
+#include "checksum.h"
+#include "commands.h"
+#include "demo_header.h"
+#include "demo_index.h"
+#include "output.h"
+#include "parallel.h"
+
+using nlohmann::json;
+using std::string;
+
+#define READ_SIZE (64 * 1024)
+// Compressed bytes read ahead of the decompression, the download only waits for the decompression past that.
+#define MAX_QUEUED_SIZE (64 * 1024 * 1024)
+// The header is the first command of Source 2 demos and the first 1072 bytes of Source 1 demos.
+#define MAX_HEADER_SIZE (1024 * 1024)
+
+static int PrintUsage()
+{
+    fprintf(stderr, "Usage: demo-tools unpack <archive.dem.bz2 or -> <demo> [--threads N] [--interval N] "
+                    "[--output path]\n"
+                    "       demo-tools decompress <archive.bz2>... [--threads N] [--output path]\n");
+
+    return 2;
+}
+
+// Reads the input on its own thread so that the download continues while a block is decompressed.
+class InputQueue
+{
+public:
+    // The thread is detached and owns the queue with the caller, a failed decompression returns without waiting for
+    // the end of the download.
+    static std::shared_ptr<InputQueue> Start(FILE* file);
+
+    // Blocks until bytes are available, returns 0 at the end of the input.
+    size_t Read(uint8_t* buffer, size_t size);
+    uint64_t GetReadSize();
+    bool HasError();
+
+private:
+    void ReadFile(FILE* file);
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> chunks;
+    // Position in the first chunk.
+    size_t chunkOffset = 0;
+    size_t queuedSize = 0;
+    uint64_t readSize = 0;
+    bool isEnd = false;
+    bool hasError = false;
+};
+
+std::shared_ptr<InputQueue> InputQueue::Start(FILE* file)
+{
+    std::shared_ptr<InputQueue> queue = std::make_shared<InputQueue>();
+    std::thread([queue, file]() { queue->ReadFile(file); }).detach();
+
+    return queue;
+}
+
+void InputQueue::ReadFile(FILE* file)
+{
+    while (true) {
+        std::vector<uint8_t> chunk(READ_SIZE);
+        size_t size = fread(chunk.data(), 1, chunk.size(), file);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (size == 0) {
+            isEnd = true;
+            hasError = ferror(file) != 0;
+            changed.notify_all();
+            return;
+        }
+
+        chunk.resize(size);
+        readSize += size;
+        queuedSize += size;
+        chunks.push_back(std::move(chunk));
+        changed.notify_all();
+        changed.wait(lock, [this]() { return queuedSize < MAX_QUEUED_SIZE; });
+    }
+}
+
+size_t InputQueue::Read(uint8_t* buffer, size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return !chunks.empty() || isEnd; });
+    if (chunks.empty()) {
+        return 0;
+    }
+
+    std::vector<uint8_t>& chunk = chunks.front();
+    size_t readSize = std::min(size, chunk.size() - chunkOffset);
+    memcpy(buffer, chunk.data() + chunkOffset, readSize);
+    chunkOffset += readSize;
+    queuedSize -= readSize;
+    if (chunkOffset == chunk.size()) {
+        chunks.pop_front();
+        chunkOffset = 0;
+    }
+    changed.notify_all();
+
+    return readSize;
+}
+
+uint64_t InputQueue::GetReadSize()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return readSize;
+}
+
+bool InputQueue::HasError()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return hasError;
+}
+
+static double GetElapsedMs(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Writes the decompressed data to the demo file and feeds the header reader and the indexer as soon as they have the
+// bytes they need.
+static bool UnpackDemo(InputQueue& input, FILE* demoFile, const string& demoPath, unsigned int threadCount,
+                       int32_t seekInterval, JsonLinesWriter& writer, DemoIndex& index, DemoHeader& header,
+                       uint64_t& demoSize, string& error)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    std::unique_ptr<DemoIndexBuilder> indexBuilder;
+    // Decompressed bytes from the first command that isn't indexed yet, at the file offset pendingOffset.
+    std::vector<uint8_t> pending;
+    uint64_t pendingOffset = 0;
+    string headerError = "Empty archive";
+    demoSize = 0;
+
+    Bzip2Input read = [&](uint8_t* buffer, size_t size) { return input.Read(buffer, size); };
+    Bzip2Output write = [&](const uint8_t* data, size_t size, string& writeError) {
+        if (fwrite(data, 1, size, demoFile) != size) {
+            writeError = "Failed to write " + demoPath;
+            return false;
+        }
+        demoSize += size;
+        pending.insert(pending.end(), data, data + size);
+
+        if (indexBuilder == nullptr) {
+            if (!ReadDemoHeader(pending.data(), pending.size(), header, headerError)) {
+                // The header may be truncated, it's read again with the next block.
+                if (pending.size() < MAX_HEADER_SIZE) {
+                    return true;
+                }
+                writeError = headerError;
+                return false;
+            }
+
+            writer.Write({
+                {"path", demoPath},
+                {"header", GetDemoHeaderJson(header)},
+                {"elapsedMs", GetElapsedMs(startTime)},
+            });
+            indexBuilder.reset(new DemoIndexBuilder(header, seekInterval));
+        }
+
+        uint64_t nextOffset = indexBuilder->AddData(pending.data(), pending.size(), pendingOffset);
+        size_t indexedSize = (size_t)std::min<uint64_t>(nextOffset - pendingOffset, pending.size());
+        pending.erase(pending.begin(), pending.begin() + indexedSize);
+        pendingOffset += indexedSize;
+
+        return true;
+    };
+
+    if (!Bzip2DecompressParallel(read, write, threadCount, error)) {
+        if (input.HasError()) {
+            error = "Failed to read the archive";
+        }
+        return false;
+    }
+
+    if (indexBuilder == nullptr) {
+        error = headerError;
+        return false;
+    }
+    indexBuilder->Finish(demoSize, index);
+
+    return true;
+}
+
+int RunUnpackCommand(int argc, char** argv)
+{
+    std::vector<string> paths;
+    string outputPath;
+    unsigned int threadCount = GetDefaultThreadCount();
+    int32_t seekInterval = DEFAULT_SEEK_INTERVAL;
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "--interval" && hasValue) {
+            seekInterval = atoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.size() != 2 || threadCount == 0 || seekInterval <= 0) {
+        return PrintUsage();
+    }
+
+    const string& archivePath = paths[0];
+    const string& demoPath = paths[1];
+    FILE* archiveFile = stdin;
+    if (archivePath == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    }
+    else {
+        archiveFile = fopen(archivePath.c_str(), "rb");
+        if (archiveFile == nullptr) {
+            fprintf(stderr, "Failed to open %s\n", archivePath.c_str());
+            return 1;
+        }
+    }
+
+    JsonLinesWriter writer;
+    if (!writer.Open(outputPath)) {
+        return 2;
+    }
+
+    string partPath = demoPath + ".part";
+    FILE* demoFile = fopen(partPath.c_str(), "wb");
+    if (demoFile == nullptr) {
+        fprintf(stderr, "Failed to write %s\n", partPath.c_str());
+        return 1;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::shared_ptr<InputQueue> input = InputQueue::Start(archiveFile);
+    DemoIndex index;
+    DemoHeader header;
+    uint64_t demoSize;
+    string error;
+    bool isUnpacked = UnpackDemo(*input, demoFile, demoPath, threadCount, seekInterval, writer, index, header,
+                                 demoSize, error);
+    if (fclose(demoFile) != 0 && isUnpacked) {
+        isUnpacked = false;
+        error = "Failed to write " + partPath;
+    }
+
+    string indexPath = GetDemoIndexFilePath(demoPath);
+    if (isUnpacked) {
+        remove(demoPath.c_str());
+        if (rename(partPath.c_str(), demoPath.c_str()) != 0) {
+            isUnpacked = false;
+            error = "Failed to write " + demoPath;
+        }
+        else {
+            isUnpacked = WriteDemoIndexFile(indexPath, index, error);
+        }
+    }
+
+    if (!isUnpacked) {
+        remove(partPath.c_str());
+        writer.Write({{"path", demoPath}, {"error", error}});
+        fprintf(stderr, "%s: %s\n", demoPath.c_str(), error.c_str());
+        return 1;
+    }
+
+    // The decompression only succeeds once the input thread reached the end of the file and stopped using it.
+    if (archiveFile != stdin) {
+        fclose(archiveFile);
+    }
+
+    double elapsedMs = GetElapsedMs(startTime);
+    uint64_t archiveSize = input->GetReadSize();
+    writer.Write({
+        {"path", demoPath},
+        {"fileSize", demoSize},
+        {"archiveSize", archiveSize},
+        {"checksum", GetDemoChecksum(header, demoSize)},
+        {"indexPath", indexPath},
+        {"isComplete", index.isComplete},
+        {"lastTick", index.lastTick},
+        {"seekPointCount", index.seekPoints.size()},
+        {"fullPacketCount", index.fullPackets.size()},
+        {"roundCount", index.rounds.size()},
+        {"durationMs", elapsedMs},
+    });
+
+    double demoMb = demoSize / (1024.0 * 1024.0);
+    fprintf(stderr, "Unpacked %.1f MB from %.1f MB in %.1f ms, %.1f MB/s\n", demoMb, archiveSize / (1024.0 * 1024.0),
+            elapsedMs, elapsedMs > 0 ? demoMb * 1000 / elapsedMs : 0);
+
+    return 0;
+}
+
+// Local archives are read from the decompressing thread, the reads are short next to the decoding of the blocks.
+static bool DecompressArchive(const string& archivePath, const string& outputPath, unsigned int threadCount,
+                              uint64_t& archiveSize, uint64_t& size, string& error)
+{
+    FILE* archiveFile = fopen(archivePath.c_str(), "rb");
+    if (archiveFile == nullptr) {
+        error = "Failed to open " + archivePath;
+        return false;
+    }
+
+    string partPath = outputPath + ".part";
+    FILE* outputFile = fopen(partPath.c_str(), "wb");
+    if (outputFile == nullptr) {
+        fclose(archiveFile);
+        error = "Failed to write " + partPath;
+        return false;
+    }
+
+    archiveSize = 0;
+    size = 0;
+    Bzip2Input read = [&](uint8_t* buffer, size_t bufferSize) {
+        size_t readSize = fread(buffer, 1, bufferSize, archiveFile);
+        archiveSize += readSize;
+        return readSize;
+    };
+    Bzip2Output write = [&](const uint8_t* data, size_t dataSize, string& writeError) {
+        if (fwrite(data, 1, dataSize, outputFile) != dataSize) {
+            writeError = "Failed to write " + partPath;
+            return false;
+        }
+        size += dataSize;
+        return true;
+    };
+
+    bool isDecompressed = Bzip2DecompressParallel(read, write, threadCount, error);
+    if (!isDecompressed && ferror(archiveFile) != 0) {
+        error = "Failed to read " + archivePath;
+    }
+    fclose(archiveFile);
+    if (fclose(outputFile) != 0 && isDecompressed) {
+        isDecompressed = false;
+        error = "Failed to write " + partPath;
+    }
+
+    if (isDecompressed) {
+        remove(outputPath.c_str());
+        if (rename(partPath.c_str(), outputPath.c_str()) != 0) {
+            isDecompressed = false;
+            error = "Failed to write " + outputPath;
+        }
+    }
+    if (!isDecompressed) {
+        remove(partPath.c_str());
+    }
+
+    return isDecompressed;
+}
+
+int RunDecompressCommand(int argc, char** argv)
+{
+    std::vector<string> archivePaths;
+    string outputPath;
+    unsigned int threadCount = GetDefaultThreadCount();
+
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return PrintUsage();
+        }
+        else {
+            archivePaths.push_back(arg);
+        }
+    }
+
+    if (archivePaths.empty() || threadCount == 0) {
+        return PrintUsage();
+    }
+
+    JsonLinesWriter writer;
+    if (!writer.Open(outputPath)) {
+        return 2;
+    }
+
+    int errorCount = 0;
+    uint64_t decompressedByteCount = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    // Each archive uses all the threads, its blocks are independent unlike the archives which may be few and large.
+    for (const string& archivePath : archivePaths) {
+        auto archiveStartTime = std::chrono::steady_clock::now();
+        string error;
+        string decompressedPath;
+        uint64_t archiveSize = 0;
+        uint64_t size = 0;
+        if (archivePath.size() <= 4 || archivePath.compare(archivePath.size() - 4, 4, ".bz2") != 0) {
+            error = "Not a .bz2 archive";
+        }
+        else {
+            decompressedPath = archivePath.substr(0, archivePath.size() - 4);
+            DecompressArchive(archivePath, decompressedPath, threadCount, archiveSize, size, error);
+        }
+
+        if (!error.empty()) {
+            errorCount++;
+            writer.Write({{"path", archivePath}, {"error", error}});
+            fprintf(stderr, "%s: %s\n", archivePath.c_str(), error.c_str());
+            continue;
+        }
+
+        decompressedByteCount += size;
+        writer.Write({
+            {"path", archivePath},
+            {"outputPath", decompressedPath},
+            {"archiveSize", archiveSize},
+            {"size", size},
+            {"durationMs", GetElapsedMs(archiveStartTime)},
+        });
+    }
+
+    double elapsedMs = GetElapsedMs(startTime);
+    double decompressedMb = decompressedByteCount / (1024.0 * 1024.0);
+    fprintf(stderr, "Decompressed %zu archives (%d errors, %.1f MB) in %.1f ms with %u threads, %.1f MB/s\n",
+            archivePaths.size(), errorCount, decompressedMb, elapsedMs, threadCount,
+            elapsedMs > 0 ? decompressedMb * 1000 / elapsedMs : 0);
+
+    return errorCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+#include "utf8.h"
+#include <cstdint>
+
+using std::string;
+
+#define REPLACEMENT_CHARACTER "\xEF\xBF\xBD"
+
+string SanitizeUtf8(const char* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    string result;
+    result.reserve(size);
+
+    size_t i = 0;
+    while (i < size) {
+        uint8_t byte = bytes[i];
+        if (byte < 0x80) {
+            result += (char)byte;
+            i++;
+            continue;
+        }
+
+        int continuationCount;
+        uint8_t lowerBoundary = 0x80;
+        uint8_t upperBoundary = 0xBF;
+        if (byte >= 0xC2 && byte <= 0xDF) {
+            continuationCount = 1;
+        }
+        else if (byte >= 0xE0 && byte <= 0xEF) {
+            continuationCount = 2;
+            if (byte == 0xE0) {
+                lowerBoundary = 0xA0;
+            }
+            else if (byte == 0xED) {
+                upperBoundary = 0x9F;
+            }
+        }
+        else if (byte >= 0xF0 && byte <= 0xF4) {
+            continuationCount = 3;
+            if (byte == 0xF0) {
+                lowerBoundary = 0x90;
+            }
+            else if (byte == 0xF4) {
+                upperBoundary = 0x8F;
+            }
+        }
+        else {
+            result += REPLACEMENT_CHARACTER;
+            i++;
+            continue;
+        }
+
+        size_t end = i + 1;
+        bool isValid = true;
+        for (int count = 0; count < continuationCount; count++) {
+            if (end >= size || bytes[end] < lowerBoundary || bytes[end] > upperBoundary) {
+                isValid = false;
+                break;
+            }
+            lowerBoundary = 0x80;
+            upperBoundary = 0xBF;
+            end++;
+        }
+
+        if (isValid) {
+            result.append(data + i, end - i);
+        }
+        else {
+            // The byte that broke the sequence is decoded again as the start of a new sequence.
+            result += REPLACEMENT_CHARACTER;
+        }
+        i = end;
+    }
+
+    return result;
+}
+
+string RemoveChar(const string& value, char character)
+{
+    string result;
+    result.reserve(value.size());
+    for (char c : value) {
+        if (c != character) {
+            result += c;
+        }
+    }
+
+    return result;
+}
+
+string RemoveReplacementChars(const string& value)
+{
+    string result;
+    result.reserve(value.size());
+    size_t start = 0;
+    size_t index;
+    while ((index = value.find(REPLACEMENT_CHARACTER, start)) != string::npos) {
+        result.append(value, start, index - start);
+        start = index + 3;
+    }
+    result.append(value, start, string::npos);
+
+    return result;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Replaces invalid UTF-8 sequences with U+FFFD like the WHATWG decoder used by Node.js (Buffer.toString,
+// TextDecoder): one replacement character per maximal invalid subpart.
+// Header strings must be decoded exactly like the app does because the demo checksum is computed from them.
+std::string SanitizeUtf8(const char* data, size_t size);
+// Removes all occurrences of a character, e.g. the null bytes of fixed-size Source 1 strings.
+std::string RemoveChar(const std::string& value, char character);
+std::string RemoveReplacementChars(const std::string& value);
@@ -0,0 +1,320 @@
+// Checks BitReader against bf_read from the CS:GO SDK (tier1/newbitbuf.cpp) bit for bit: random sequences of reads
+// over random buffers must return the same values and end at the same positions. Then compares their speed.
+//
+// The CS2 SDK bf_read loads its words as unsigned long, 8 bytes on 64-bit Linux, so it can't be the reference here.
+// Its ReadVarInt32 is reproduced on top of ReadUBitLong, the CS:GO bf_read doesn't have it.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "bitbuf.h"
+#include "bit_reader.h"
+
+#define RANDOM_BUFFER_COUNT 20000
+#define BENCHMARK_VALUE_COUNT (4 * 1024 * 1024)
+
+// The only tier0 function used by tier1/newbitbuf.cpp.
+void V_tier0_memcpy(void* dest, const void* src, size_t count)
+{
+    memcpy(dest, src, count);
+}
+
+static uint32 ReadVarInt32(bf_read& reader)
+{
+    uint32 result = 0;
+    int count = 0;
+    uint32 b;
+
+    do {
+        if (count == 5) {
+            return result;
+        }
+        b = reader.ReadUBitLong(8);
+        result |= (b & 0x7F) << (7 * count);
+        ++count;
+    } while (b & 0x80);
+
+    return result;
+}
+
+static std::string ReadString(bf_read& reader)
+{
+    std::string value;
+    char character;
+    while ((character = (char)reader.ReadUBitLong(8)) != '\0') {
+        value += character;
+    }
+
+    return value;
+}
+
+// Operations with the number of bits they read at most, operations are only done when that many bits remain because
+// the two readers don't return the same partial values when they overflow.
+enum class Operation
+{
+    BITS,
+    BIT,
+    UBITVAR,
+    VARINT32,
+    BIT_COORD,
+    STRING,
+    BYTES,
+    SKIP,
+    UBITVARS,
+    VARINT32S,
+    COUNT
+};
+
+static int failureCount = 0;
+
+static void Check(bool isEqual, size_t bufferIndex, size_t operationIndex, const char* name)
+{
+    if (!isEqual && failureCount++ < 10) {
+        fprintf(stderr, "Buffer %zu, operation %zu: %s mismatch\n", bufferIndex, operationIndex, name);
+    }
+}
+
+static void CompareRandomReads(size_t bufferIndex, std::mt19937& random)
+{
+    // bf_read expects 4-byte aligned buffers.
+    std::vector<uint32_t> words(random() % 128 + 1);
+    size_t size = random() % (words.size() * 4 + 1);
+    uint8_t* data = (uint8_t*)words.data();
+    // Enough null bytes to end strings and varints often.
+    for (size_t i = 0; i < size; i++) {
+        data[i] = random() % 4 == 0 ? 0 : (uint8_t)random();
+    }
+
+    bf_read reference(data, (int)size);
+    BitReader reader(data, size);
+    for (size_t operationIndex = 0; reader.GetRemainingBits() > 0; operationIndex++) {
+        size_t remainingBits = reader.GetRemainingBits();
+        Operation operation = (Operation)(random() % (int)Operation::COUNT);
+        switch (operation) {
+        case Operation::BITS: {
+            int count = random() % 32 + 1;
+            if ((size_t)count <= remainingBits) {
+                Check(reader.ReadBits(count) == reference.ReadUBitLong(count), bufferIndex, operationIndex, "bits");
+            }
+            break;
+        }
+        case Operation::BIT:
+            Check(reader.ReadBit() == (reference.ReadOneBit() != 0), bufferIndex, operationIndex, "bit");
+            break;
+        case Operation::UBITVAR:
+            if (remainingBits >= 34) {
+                Check(reader.ReadUBitVar() == reference.ReadUBitVar(), bufferIndex, operationIndex, "ubitvar");
+            }
+            break;
+        case Operation::VARINT32:
+            if (remainingBits >= 40) {
+                Check(reader.ReadVarUInt32() == ReadVarInt32(reference), bufferIndex, operationIndex, "varint32");
+            }
+            break;
+        case Operation::BIT_COORD:
+            if (remainingBits >= 22) {
+                float value = reader.ReadBitCoord();
+                float referenceValue = reference.ReadBitCoord();
+                Check(memcmp(&value, &referenceValue, sizeof(float)) == 0, bufferIndex, operationIndex, "bit coord");
+            }
+            break;
+        case Operation::STRING: {
+            // Only if the string ends in the buffer.
+            BitReader lookahead = reader;
+            lookahead.ReadString();
+            if (!lookahead.IsOverflowed()) {
+                Check(reader.ReadString() == ReadString(reference), bufferIndex, operationIndex, "string");
+            }
+            break;
+        }
+        case Operation::BYTES: {
+            size_t count = random() % 24;
+            if (count * 8 <= remainingBits) {
+                uint8_t bytes[24];
+                uint8_t referenceBytes[24];
+                reader.ReadBytes(bytes, count);
+                for (size_t i = 0; i < count; i++) {
+                    referenceBytes[i] = (uint8_t)reference.ReadUBitLong(8);
+                }
+                Check(memcmp(bytes, referenceBytes, count) == 0, bufferIndex, operationIndex, "bytes");
+            }
+            break;
+        }
+        case Operation::SKIP: {
+            size_t count = random() % 100;
+            if (count <= remainingBits) {
+                reader.SkipBits(count);
+                reference.SeekRelative((int)count);
+            }
+            break;
+        }
+        case Operation::UBITVARS:
+        case Operation::VARINT32S: {
+            bool isUBitVar = operation == Operation::UBITVARS;
+            size_t count = random() % 40;
+            if (count * (isUBitVar ? 34 : 40) > remainingBits) {
+                break;
+            }
+            uint32_t values[40];
+            isUBitVar ? reader.ReadUBitVars(values, count) : reader.ReadVarUInt32s(values, count);
+            for (size_t i = 0; i < count; i++) {
+                uint32_t referenceValue = isUBitVar ? reference.ReadUBitVar() : ReadVarInt32(reference);
+                Check(values[i] == referenceValue, bufferIndex, operationIndex, isUBitVar ? "ubitvars" : "varint32s");
+            }
+            break;
+        }
+        case Operation::COUNT:
+            break;
+        }
+
+        Check(reader.GetPosition() == (size_t)reference.GetNumBitsRead(), bufferIndex, operationIndex, "position");
+        Check(!reader.IsOverflowed(), bufferIndex, operationIndex, "overflow");
+        if (failureCount > 0) {
+            return;
+        }
+        // Sometimes ends with a read of all the remaining bits, shorter than a word.
+        if (reader.GetRemainingBits() < 40 && random() % 2 == 0) {
+            int count = (int)reader.GetRemainingBits();
+            if (count > 0 && count <= 32) {
+                Check(reader.ReadBits(count) == reference.ReadUBitLong(count), bufferIndex, operationIndex, "tail");
+            }
+            break;
+        }
+    }
+}
+
+static void CheckOverflow()
+{
+    uint8_t data[12] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    BitReader reader(data, sizeof(data));
+    reader.SkipBits(90);
+    Check(reader.ReadBits(7) == 0 && reader.IsOverflowed(), 0, 0, "overflowed read");
+    Check(reader.GetRemainingBits() == 0 && reader.ReadBit() == false, 0, 1, "read after overflow");
+
+    BitReader varIntReader(data, sizeof(data));
+    uint32_t values[3];
+    Check(!varIntReader.ReadVarUInt32s(values, 3) && varIntReader.IsOverflowed(), 0, 2, "overflowed varint32s");
+
+    BitReader emptyReader(nullptr, 0);
+    Check(emptyReader.ReadUBitVar() == 0 && emptyReader.IsOverflowed(), 0, 3, "empty buffer");
+}
+
+template <typename Function>
+static double MeasureMs(Function function)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    function();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Writes the values in the bit stream like bf_write.
+class BitWriter
+{
+public:
+    void WriteBits(uint32_t value, int count)
+    {
+        for (int i = 0; i < count; i++, bitCount++) {
+            if (bitCount % 32 == 0) {
+                words.push_back(0);
+            }
+            words.back() |= ((value >> i) & 1) << (bitCount % 32);
+        }
+    }
+    void WriteUBitVar(uint32_t value)
+    {
+        int extraBitCount = value < 16 ? 0 : value < 256 ? 4 : value < 4096 ? 8 : 28;
+        uint32_t prefix = extraBitCount == 0 ? 0 : extraBitCount == 4 ? 16 : extraBitCount == 8 ? 32 : 48;
+        WriteBits((value & 15) | prefix, 6);
+        WriteBits(value >> 4, extraBitCount);
+    }
+    void WriteVarInt32(uint32_t value)
+    {
+        while (value >= 0x80) {
+            WriteBits((value & 0x7F) | 0x80, 8);
+            value >>= 7;
+        }
+        WriteBits(value, 8);
+    }
+
+    std::vector<uint32_t> words;
+    size_t bitCount = 0;
+};
+
+template <typename ReferenceRead, typename ReaderRead, typename BulkRead>
+static void BenchmarkValues(const char* name, const BitWriter& writer, ReferenceRead referenceRead,
+                            ReaderRead readerRead, BulkRead bulkRead)
+{
+    const uint8_t* data = (const uint8_t*)writer.words.data();
+    size_t size = writer.words.size() * 4;
+    std::vector<uint32_t> referenceValues(BENCHMARK_VALUE_COUNT);
+    std::vector<uint32_t> values(BENCHMARK_VALUE_COUNT);
+    std::vector<uint32_t> bulkValues(BENCHMARK_VALUE_COUNT);
+    double referenceMs = MeasureMs([&]() {
+        bf_read reference(data, (int)size);
+        for (uint32_t& value : referenceValues) {
+            value = referenceRead(reference);
+        }
+    });
+    double readerMs = MeasureMs([&]() {
+        BitReader reader(data, size);
+        for (uint32_t& value : values) {
+            value = readerRead(reader);
+        }
+    });
+    double bulkMs = MeasureMs([&]() {
+        BitReader reader(data, size);
+        bulkRead(reader, bulkValues.data(), bulkValues.size());
+    });
+    Check(values == referenceValues && bulkValues == referenceValues, 0, 0, name);
+
+    printf("%d %s: bf_read %.1f ms, BitReader %.1f ms (x%.1f), bulk %.1f ms (x%.1f)\n", BENCHMARK_VALUE_COUNT, name,
+           referenceMs, readerMs, referenceMs / readerMs, bulkMs, referenceMs / bulkMs);
+}
+
+static void Benchmark(std::mt19937& random)
+{
+    // Message types and sizes like in the headers of CS2 packet messages.
+    static const uint32_t messageTypes[] = {4, 5, 40, 44, 45, 55, 62, 145, 150, 207, 208, 4100, 4150};
+    BitWriter typesWriter;
+    BitWriter sizesWriter;
+    for (int i = 0; i < BENCHMARK_VALUE_COUNT; i++) {
+        typesWriter.WriteUBitVar(messageTypes[random() % (sizeof(messageTypes) / sizeof(messageTypes[0]))]);
+        sizesWriter.WriteVarInt32(random() % 8 == 0 ? random() % 20000 : random() % 100);
+    }
+
+    BenchmarkValues(
+        "ubitvars", typesWriter, [](bf_read& reader) { return reader.ReadUBitVar(); },
+        [](BitReader& reader) { return reader.ReadUBitVar(); },
+        [](BitReader& reader, uint32_t* output, size_t count) { reader.ReadUBitVars(output, count); });
+    BenchmarkValues(
+        "varint32s", sizesWriter, [](bf_read& reader) { return ReadVarInt32(reader); },
+        [](BitReader& reader) { return reader.ReadVarUInt32(); },
+        [](BitReader& reader, uint32_t* output, size_t count) { reader.ReadVarUInt32s(output, count); });
+}
+
+int main()
+{
+    std::mt19937 random(1234);
+    for (size_t i = 0; i < RANDOM_BUFFER_COUNT && failureCount == 0; i++) {
+        CompareRandomReads(i, random);
+    }
+    CheckOverflow();
+
+    if (failureCount > 0) {
+        fprintf(stderr, "BitReader differs from bf_read\n");
+        return 1;
+    }
+
+    Benchmark(random);
+    if (failureCount > 0) {
+        fprintf(stderr, "BitReader differs from bf_read\n");
+        return 1;
+    }
+    printf("BitReader matches bf_read\n");
+
+    return 0;
+}
@@ -0,0 +1,568 @@
+"""
+Generates the synthetic demos used by `make check`.
+
+Real demos are too big to be committed, these ones only contain what demo-tools reads: the header, the signon data with
+the game event list and the userinfo string table, and packets with player_death events. The content is random but
+reproducible, every fixture is generated from a fixed seed.
+
+Usage: python3 tests/generate_fixtures.py highlights
+  Writes tests/fixtures/highlights_csgo.dem.data and highlights_cs2.dem.data, and the actions files that
+  generatePlayerHighlightsJsonFile (src/node/counter-strike/json-actions-file) generates for the kills of their player
+  as tests/highlights_*.json. The fixtures are committed, they only have to be generated again when this changes.
+
+Usage: python3 tests/generate_fixtures.py split <folder>
+  Writes CS2 demos of about 12 MB that analyze splits at their full packets, and variants that make it fall back to a
+  sequential read. They are generated by make check instead of being committed.
+
+Usage: python3 tests/generate_fixtures.py archives
+       python3 tests/generate_fixtures.py archive-sources <folder>
+  archives writes the committed bzip2 archives of tests/fixtures with 100 KB blocks, archive-sources writes the files
+  they contain so that make check can compare them with the decompressed archives. The false_*_magic.txt archives
+  contain a match of the block or end of stream magic number in every block.
+"""
+import bz2
+import json
+import math
+import os
+import random
+import struct
+import sys
+import tempfile
+
+EVENTS = ['player_death', 'round_start', 'round_end', 'round_freeze_end', 'weapon_fire', 'player_hurt']
+EVENT_IDS = {name: 10 + i * 7 for i, name in enumerate(EVENTS)}
+
+GAME_CSGO = 1
+GAME_CS2 = 2
+
+
+def varint(value):
+    out = bytearray()
+    value &= (1 << 64) - 1
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def pb_field(number, wire_type, payload):
+    return varint((number << 3) | wire_type) + payload
+
+
+def pb_varint(number, value):
+    return pb_field(number, 0, varint(value))
+
+
+def pb_bytes(number, value):
+    return pb_field(number, 2, varint(len(value)) + value)
+
+
+def pb_str(number, value):
+    return pb_bytes(number, value.encode())
+
+
+def snappy_compress(data, rng):
+    """Snappy with every kind of copy, picked at random, so that the decompressor is tested on all of them."""
+    out = bytearray(varint(len(data)))
+    index = 0
+    literal_start = 0
+    table = {}
+
+    def emit_literal(start, end):
+        while start < end:
+            length = min(end - start, 65536)
+            if length - 1 < 60:
+                out.append((length - 1) << 2)
+            elif length - 1 < 256:
+                out.append(60 << 2)
+                out.append(length - 1)
+            else:
+                out.append(61 << 2)
+                out.extend(struct.pack('<H', length - 1))
+            out.extend(data[start:start + length])
+            start += length
+
+    while index + 4 <= len(data):
+        key = bytes(data[index:index + 4])
+        candidate = table.get(key)
+        table[key] = index
+        if candidate is None or index - candidate >= 65536 or rng.random() >= 0.9:
+            index += 1
+            continue
+
+        length = 4
+        while index + length < len(data) and data[candidate + length] == data[index + length] and length < 64:
+            length += 1
+        emit_literal(literal_start, index)
+        offset = index - candidate
+        if 4 <= length <= 11 and offset < 2048 and rng.random() < 0.5:
+            out.append(1 | ((length - 4) << 2) | ((offset >> 8) << 5))
+            out.append(offset & 0xFF)
+        elif rng.random() < 0.2:
+            out.append(3 | ((length - 1) << 2))
+            out.extend(struct.pack('<I', offset))
+        else:
+            out.append(2 | ((length - 1) << 2))
+            out.extend(struct.pack('<H', offset))
+        index += length
+        literal_start = index
+    emit_literal(literal_start, len(data))
+    return bytes(out)
+
+
+class BitWriter:
+    """Little-endian bit stream, like bf_write and the Source 2 bit buffers."""
+
+    def __init__(self):
+        self.value = 0
+        self.count = 0
+
+    def write(self, value, bit_count):
+        self.value |= (value & ((1 << bit_count) - 1)) << self.count
+        self.count += bit_count
+
+    def write_ubitvar(self, value):
+        if value < 16:
+            self.write(value, 6)
+        elif value < 256:
+            self.write((value & 15) | 16, 6)
+            self.write(value >> 4, 4)
+        elif value < 4096:
+            self.write((value & 15) | 32, 6)
+            self.write(value >> 4, 8)
+        else:
+            self.write((value & 15) | 48, 6)
+            self.write(value >> 4, 28)
+
+    def write_varuint(self, value):
+        self.write_bytes(varint(value))
+
+    def write_bytes(self, data):
+        if data:
+            self.write(int.from_bytes(data, 'little'), 8 * len(data))
+
+    def get(self):
+        return self.value.to_bytes((self.count + 7) // 8, 'little')
+
+
+def event_list_message():
+    descriptors = b''
+    for name in EVENTS:
+        descriptor = pb_varint(1, EVENT_IDS[name]) + pb_str(2, name)
+        for key in ['userid', 'attacker', 'weapon']:
+            descriptor += pb_bytes(3, pb_varint(1, 1) + pb_str(2, key))
+        descriptors += pb_bytes(1, descriptor)
+    return descriptors
+
+
+def event_message(name, rng):
+    return pb_varint(2, EVENT_IDS[name]) + pb_bytes(3, pb_varint(1, 1) + pb_str(2, 'x' * rng.randint(0, 5)))
+
+
+def death_message(victim, attacker):
+    def short_key(value):
+        return pb_bytes(3, pb_varint(1, 4) + pb_varint(5, value))
+
+    return (pb_varint(2, EVENT_IDS['player_death']) + short_key(victim) + short_key(attacker)
+            + pb_bytes(3, pb_varint(1, 1) + pb_str(2, 'ak47')))
+
+
+def write_entry_key(writer, key):
+    # The key is present and not a substring of the previous ones.
+    writer.write(1, 1)
+    writer.write(0, 1)
+    writer.write_bytes(key.encode() + b'\0')
+
+
+def csgo_player_info(steam_id, name, user_id):
+    info = bytearray(340)
+    struct.pack_into('>Q', info, 8, steam_id)
+    info[16:16 + len(name)] = name.encode()
+    struct.pack_into('>i', info, 144, user_id)
+    return bytes(info)
+
+
+def csgo_table_entries(entries):
+    writer = BitWriter()
+    writer.write(0, 1)
+    previous = -1
+    for index, value in entries:
+        if index == previous + 1:
+            writer.write(1, 1)
+        else:
+            writer.write(0, 1)
+            writer.write(index, 8)
+        previous = index
+        write_entry_key(writer, str(index))
+        if value is None:
+            writer.write(0, 1)
+        else:
+            writer.write(1, 1)
+            writer.write(len(value), 14)
+            writer.write_bytes(value)
+    return writer.get()
+
+
+def cs2_player_info(steam_id, name, user_id):
+    return (pb_str(1, name) + pb_field(2, 1, struct.pack('<Q', steam_id)) + pb_varint(3, user_id)
+            + pb_field(4, 1, struct.pack('<Q', steam_id)))
+
+
+def cs2_table_entries(entries, rng):
+    writer = BitWriter()
+    previous = -1
+    for index, value in entries:
+        if index == previous + 1:
+            writer.write(1, 1)
+        else:
+            writer.write(0, 1)
+            writer.write_varuint(index - previous - 2)
+        previous = index
+        write_entry_key(writer, str(index))
+        if value is None:
+            writer.write(0, 1)
+            continue
+        writer.write(1, 1)
+        is_compressed = rng.random() < 0.5
+        if is_compressed:
+            value = snappy_compress(value, rng)
+        writer.write(1 if is_compressed else 0, 1)
+        writer.write_ubitvar(len(value))
+        writer.write_bytes(value)
+    return writer.get()
+
+
+def cs2_packet(messages):
+    writer = BitWriter()
+    for message_type, payload in messages:
+        writer.write_ubitvar(message_type)
+        writer.write_varuint(len(payload))
+        writer.write_bytes(payload)
+    return pb_bytes(3, writer.get())
+
+
+class Cs2DemoWriter:
+    def __init__(self, rng):
+        self.rng = rng
+        self.data = bytearray(b'PBDEMS2\0' + b'\0' * 8)
+        header = (pb_str(1, 'PBDEMS2') + pb_varint(2, 13990) + pb_str(3, 'srv') + pb_str(4, 'cli')
+                  + pb_str(5, 'de_inferno') + pb_str(11, 'v') + pb_str(12, 'g') + pb_varint(13, 10000))
+        self.command(1, -1, header)
+
+    def command(self, command_type, tick, payload, is_compressed=False):
+        if is_compressed:
+            payload = snappy_compress(payload, self.rng)
+            command_type |= 64
+        self.data.extend(varint(command_type) + varint(tick & 0xFFFFFFFF) + varint(len(payload)) + payload)
+
+
+def generate_kills_scenario(seed, tick_count):
+    """10 players, the player 3 is the one whose highlights are generated, deaths by tick as (victim, attacker)."""
+    rng = random.Random(seed)
+    steam_id = 76561198000000000 + seed
+    players = [(steam_id if i == 3 else 76561198100000000 + i, 'p%d' % i, 100 + i) for i in range(10)]
+    deaths = {}
+    tick = 200
+    while tick < tick_count - 10:
+        deaths.setdefault(tick, []).append((rng.randrange(10), rng.randrange(10)))
+        if rng.random() < 0.5:
+            deaths[tick].append((rng.randrange(10), 3))
+        # Close kills, kills just below and above the skip ahead delay, and far away kills.
+        tick += rng.choice([5, 40, 300, 1000, 3000])
+
+    kills = []
+    for tick in sorted(deaths):
+        for victim, attacker in deaths[tick]:
+            if players[attacker][0] == steam_id and players[victim][0] != steam_id:
+                kills.append({'tick': tick, 'slot': attacker + 1, 'steamId': players[attacker][0]})
+
+    return steam_id, players, deaths, kills
+
+
+def generate_csgo_kills_demo(path, seed, tick_count, tickrate=128):
+    rng = random.Random(seed)
+    steam_id, players, deaths, kills = generate_kills_scenario(seed, tick_count)
+    header = bytearray(1072)
+    header[0:8] = b'HL2DEMO\0'
+    struct.pack_into('<ii', header, 8, 4, 13881)
+    data = bytearray(header)
+
+    def frame(command, tick, body):
+        data.extend(struct.pack('<BiB', command, tick, 0) + body)
+
+    def packet(messages):
+        content = b''.join(varint(message_type) + varint(len(payload)) + payload for message_type, payload in messages)
+        return bytes(160) + struct.pack('<i', len(content)) + content
+
+    server_info = pb_varint(1, 1) + pb_field(14, 5, struct.pack('<f', 1 / tickrate)) + pb_str(16, 'de_dust2')
+    other_table = pb_str(1, 'downloadables') + pb_varint(2, 8192) + pb_varint(3, 0)
+    # The players 8 and 9 join later with a string table update.
+    entries = [(i, csgo_player_info(*players[i])) for i in range(8)]
+    user_info_table = (pb_str(1, 'userinfo') + pb_varint(2, 256) + pb_varint(3, len(entries)) + pb_varint(4, 0)
+                       + pb_bytes(8, csgo_table_entries(entries)))
+    frame(1, 0, packet([(8, server_info), (30, event_list_message()), (12, other_table), (12, user_info_table)]))
+    frame(3, 0, b'')
+    for tick in range(1, tick_count):
+        messages = []
+        if tick == 150:
+            update = csgo_table_entries([(8, csgo_player_info(*players[8])), (9, csgo_player_info(*players[9]))])
+            messages.append((13, pb_varint(1, 1) + pb_varint(2, 2) + pb_bytes(3, update)))
+        for victim, attacker in deaths.get(tick, []):
+            messages.append((25, death_message(players[victim][2], players[attacker][2])))
+        if messages or tick == tick_count - 1 or rng.random() < 0.1:
+            frame(2, tick, packet(messages))
+    frame(7, tick_count, b'')
+    with open(path, 'wb') as file:
+        file.write(bytes(data))
+
+    return {'steamId': steam_id, 'game': GAME_CSGO, 'tickrate': tickrate, 'tickCount': tick_count - 1, 'kills': kills}
+
+
+def generate_cs2_kills_demo(path, seed, tick_count, tickrate=64):
+    rng = random.Random(seed)
+    steam_id, players, deaths, kills = generate_kills_scenario(seed, tick_count)
+    demo = Cs2DemoWriter(rng)
+    server_info = pb_varint(1, 1) + pb_field(13, 5, struct.pack('<f', 1 / tickrate))
+    other_table = pb_str(1, 'instancebaseline') + pb_varint(2, 0)
+    # The entry index is the slot, the slot 6 is filled later with a string table update.
+    entries = [(i, cs2_player_info(*players[i])) for i in range(10) if i != 6]
+    entries_data = cs2_table_entries(entries, rng)
+    user_info_table = (pb_str(1, 'userinfo') + pb_varint(2, len(entries)) + pb_varint(3, 0) + pb_varint(6, 1)
+                       + pb_bytes(7, snappy_compress(entries_data, rng)) + pb_varint(8, len(entries_data))
+                       + pb_varint(9, 1) + pb_varint(10, 1))
+    signon = [(40, server_info), (205, event_list_message()), (44, other_table), (44, user_info_table)]
+    demo.command(8, -1, cs2_packet(signon), is_compressed=True)
+    demo.command(3, -1, b'')
+    for tick in range(0, tick_count):
+        messages = []
+        if tick == 100:
+            update = cs2_table_entries([(6, cs2_player_info(*players[6]))], rng)
+            messages.append((45, pb_varint(1, 1) + pb_varint(2, 1) + pb_bytes(3, update)))
+        for victim, attacker in deaths.get(tick, []):
+            messages.append((207, death_message(victim, attacker)))
+        if messages or tick == tick_count - 1 or rng.random() < 0.1:
+            demo.command(7, tick, cs2_packet(messages), is_compressed=rng.random() < 0.5)
+    demo.command(0, tick_count, b'')
+    with open(path, 'wb') as file:
+        file.write(bytes(demo.data))
+
+    return {'steamId': steam_id, 'game': GAME_CS2, 'tickrate': tickrate, 'tickCount': tick_count - 1, 'kills': kills}
+
+
+def generate_highlights_actions(scenario, before_seconds=5, after_seconds=2, voices=True):
+    """Port of generatePlayerHighlightsJsonFile from the player perspective and of the JSONActionsFileGenerator."""
+    game = scenario['game']
+    tickrate = scenario['tickrate']
+    kills = scenario['kills']
+    actions = []
+
+    def js_round(value):
+        return math.floor(value + 0.5)
+
+    def valid_tick(tick):
+        return max(64, tick)
+
+    def add(tick, cmd):
+        actions.append({'cmd': cmd, 'tick': valid_tick(tick)})
+
+    def add_spec_player(tick, kill):
+        if game == GAME_CSGO:
+            add(tick, 'spec_lock_to_accountid %d' % kill['steamId'])
+            add(tick, 'spec_player_by_accountid %d' % kill['steamId'])
+        else:
+            add(tick, 'spec_player %d' % kill['slot'])
+            add(tick, 'spec_mode 1')
+
+    if game == GAME_CSGO:
+        add(0, 'voice_enable %d' % (1 if voices else 0))
+    else:
+        value = '-1' if voices else '0'
+        add(0, 'tv_listen_voice_indices ' + value)
+        add(0, 'tv_listen_voice_indices_h ' + value)
+
+    before_tick_count = js_round(tickrate * max(1, before_seconds))
+    after_tick_count = js_round(tickrate * max(1, after_seconds))
+    max_next_tick_count = max(js_round(tickrate * 15), after_tick_count)
+    for index, kill in enumerate(kills):
+        if index == 0:
+            to_tick = max(0, kill['tick'] - before_tick_count)
+            add(0, 'demo_gototick %d' % valid_tick(to_tick))
+            add_spec_player(to_tick, kill)
+        if index == len(kills) - 1:
+            add(min(scenario['tickCount'], kill['tick'] + after_tick_count), 'quit')
+            break
+        next_kill = kills[index + 1]
+        if next_kill['tick'] - kill['tick'] > max_next_tick_count:
+            to_tick = next_kill['tick'] - before_tick_count
+            add(kill['tick'] + after_tick_count, 'demo_gototick %d' % valid_tick(to_tick))
+            add_spec_player(to_tick, next_kill)
+        else:
+            add_spec_player(js_round(kill['tick'] + (next_kill['tick'] - kill['tick']) / 2), next_kill)
+
+    return [{'actions': actions}]
+
+
+def generate_split_demo(path, seed, variant, tick_count=8000, full_packet_interval=1280, filler_size=6144):
+    """
+    CS2 demo big enough to be split at its full packets by analyze, with players joining and leaving, kills and
+    rounds. The variants break the split in the ways that make analyze read the demo sequentially:
+    - mismatch: the full packets after the first one don't have the userinfo table in their snapshot
+    - missing_player: a player is missing from the snapshot of the full packets after the first one
+    - no_snapshot: the full packets after the first one don't have a string tables snapshot
+    - event_list: the game event list is sent again in the middle of the demo
+    """
+    rng = random.Random(seed)
+    demo = Cs2DemoWriter(rng)
+    slot_count = 12
+    players = {i: (76561198100000000 + i, 'p%d' % i, 100 + i) for i in range(10)}
+    server_info = pb_varint(1, 1) + pb_field(13, 5, struct.pack('<f', 1 / 64))
+    entries = cs2_table_entries([(i, cs2_player_info(*players[i])) for i in sorted(players)], rng)
+    user_info_table = (pb_str(1, 'userinfo') + pb_varint(2, len(players)) + pb_varint(3, 0) + pb_varint(6, 1)
+                       + pb_bytes(7, entries) + pb_varint(10, 1))
+    other_table = pb_str(1, 'instancebaseline') + pb_varint(2, 0)
+    signon = [(40, server_info), (205, event_list_message()), (44, other_table), (44, user_info_table)]
+    demo.command(8, -1, cs2_packet(signon), is_compressed=True)
+    demo.command(3, -1, b'')
+
+    def string_tables_snapshot(snapshot_players):
+        items = b''
+        for slot in range(slot_count):
+            item = pb_str(1, str(slot))
+            if slot in snapshot_players:
+                item += pb_bytes(2, cs2_player_info(*snapshot_players[slot]))
+            items += pb_bytes(2, item)
+        return pb_bytes(1, pb_str(1, 'instancebaseline')) + pb_bytes(1, pb_str(1, 'userinfo') + items)
+
+    next_round_tick = 300
+    is_in_round = False
+    for tick in range(tick_count):
+        messages = []
+        if rng.random() < 0.002:
+            slot = rng.randrange(slot_count)
+            if slot in players and rng.random() < 0.5:
+                del players[slot]
+                update = cs2_table_entries([(slot, None)], rng)
+            else:
+                players[slot] = (76561198200000000 + rng.randrange(1000), 'n%d' % rng.randrange(99), rng.randrange(1000))
+                update = cs2_table_entries([(slot, cs2_player_info(*players[slot]))], rng)
+            messages.append((45, pb_varint(1, 1) + pb_varint(2, 1) + pb_bytes(3, update)))
+        if rng.random() < 0.01:
+            messages.append((207, death_message(rng.randrange(slot_count), rng.randrange(slot_count))))
+        if tick == next_round_tick:
+            # Mostly well-formed rounds, sometimes an event out of order.
+            name = None
+            if rng.random() < 0.1:
+                name = ['round_start', 'round_freeze_end', 'round_end'][rng.randrange(3)]
+            if name is None:
+                name = 'round_end' if is_in_round else 'round_start'
+                is_in_round = not is_in_round
+                if is_in_round and rng.random() < 0.3:
+                    messages.append((207, event_message('round_freeze_end', rng)))
+            messages.append((207, event_message(name, rng)))
+            next_round_tick += rng.choice([5, 100, 1000, 2500, 3840])
+        if variant == 'event_list' and tick == tick_count // 2:
+            messages.append((205, event_list_message()))
+
+        if tick % full_packet_interval == 0:
+            snapshot = string_tables_snapshot(players)
+            if tick > 0 and variant == 'mismatch':
+                snapshot = pb_bytes(1, pb_str(1, 'instancebaseline'))
+            elif tick > 0 and variant == 'missing_player' and players:
+                snapshot = string_tables_snapshot({slot: players[slot] for slot in players if slot != min(players)})
+            body = pb_bytes(2, cs2_packet(messages))
+            if tick == 0 or variant != 'no_snapshot':
+                body = pb_bytes(1, snapshot) + body
+            demo.command(13, tick, body, is_compressed=rng.random() < 0.5)
+        elif messages or rng.random() < 0.3:
+            demo.command(7, tick, cs2_packet(messages), is_compressed=rng.random() < 0.3)
+        # Commands analyze skips, they make the demo big enough to be split.
+        if rng.random() < 0.5:
+            demo.command(12, tick, rng.randbytes(rng.randint(0, filler_size)))
+    demo.command(0, tick_count, b'')
+    with open(path, 'wb') as file:
+        file.write(bytes(demo.data))
+
+
+def generate_split_fixtures(folder):
+    os.makedirs(folder, exist_ok=True)
+    for name, seed, variant in [('consistent_1', 1, 'consistent'), ('consistent_2', 2, 'consistent'),
+                                ('mismatch', 4, 'mismatch'), ('missing_player', 5, 'missing_player'),
+                                ('no_snapshot', 6, 'no_snapshot'), ('event_list', 3, 'event_list')]:
+        generate_split_demo(os.path.join(folder, name + '.dem'), seed, variant)
+
+
+BZIP2_BLOCK_MAGIC = 0x314159265359
+BZIP2_END_MAGIC = 0x177245385090
+
+
+def bzip2_magic_alphabet(magic):
+    """Returns the bytes that make bzip2 write the magic number in the symbol map of every block.
+
+    The map starts with a 16 bits word telling which ranges of 16 byte values are used, followed by a 16 bits word per
+    used range telling which bytes of the range are used. With only bytes of the ranges 0x20, 0x30 and 0x40, the 3 words
+    of the ranges are the 3 words of the magic number, which is then found in the compressed data of the block.
+    """
+    alphabet = bytearray()
+    for index, first_byte in enumerate([0x20, 0x30, 0x40]):
+        word = (magic >> (32 - index * 16)) & 0xFFFF
+        alphabet += bytes(first_byte + j for j in range(16) if (word >> (15 - j)) & 1)
+    return bytes(alphabet)
+
+
+def generate_false_magic_text(path, magic, seed, size=250000):
+    """Writes text whose bzip2 blocks all contain a false match of the magic number."""
+    rng = random.Random(seed)
+    alphabet = bzip2_magic_alphabet(magic)
+    words = [bytes(rng.choice(alphabet) for _ in range(rng.randint(2, 8))) for _ in range(200)]
+    out = bytearray()
+    while len(out) < size:
+        # Every byte of the alphabet and no other has to be in every block for the map to be the magic number.
+        out += alphabet if len(out) % 1000 < 10 else rng.choice(words)
+    with open(path, 'wb') as file:
+        file.write(bytes(out[:size]))
+
+
+def generate_archive_sources(folder):
+    """Writes the files compressed in the .bz2 fixtures, make check compares them with the decompressed archives."""
+    os.makedirs(folder, exist_ok=True)
+    # Full packets and rounds for the index, over several 100 KB bzip2 blocks.
+    generate_split_demo(os.path.join(folder, 'unpack_cs2.dem'), 7, 'consistent', 40000, 1280, 0)
+    # Candidate blocks that don't start at a block boundary, the parallel decompression must discard them.
+    generate_false_magic_text(os.path.join(folder, 'false_block_magic.txt'), BZIP2_BLOCK_MAGIC, 1)
+    generate_false_magic_text(os.path.join(folder, 'false_end_magic.txt'), BZIP2_END_MAGIC, 2)
+
+
+def generate_archives():
+    tests_folder = os.path.dirname(os.path.abspath(__file__))
+    with tempfile.TemporaryDirectory() as folder:
+        generate_archive_sources(folder)
+        for name in sorted(os.listdir(folder)):
+            with open(os.path.join(folder, name), 'rb') as file:
+                data = file.read()
+            with open(os.path.join(tests_folder, 'fixtures', name + '.bz2'), 'wb') as file:
+                file.write(bz2.compress(data, 1))
+
+
+def generate_highlights_fixtures():
+    tests_folder = os.path.dirname(os.path.abspath(__file__))
+    for name, generate, seed, tick_count in [('highlights_csgo', generate_csgo_kills_demo, 33, 5000),
+                                             ('highlights_cs2', generate_cs2_kills_demo, 21, 30000)]:
+        scenario = generate(os.path.join(tests_folder, 'fixtures', name + '.dem.data'), seed, tick_count)
+        with open(os.path.join(tests_folder, name + '.json'), 'w', encoding='utf-8') as file:
+            file.write(json.dumps(generate_highlights_actions(scenario), indent=2, ensure_ascii=False))
+        print('%s.dem.data: player %d, %d kills' % (name, scenario['steamId'], len(scenario['kills'])))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) == 2 and sys.argv[1] == 'highlights':
+        generate_highlights_fixtures()
+    elif len(sys.argv) == 3 and sys.argv[1] == 'split':
+        generate_split_fixtures(sys.argv[2])
+    elif len(sys.argv) == 2 and sys.argv[1] == 'archives':
+        generate_archives()
+    elif len(sys.argv) == 3 and sys.argv[1] == 'archive-sources':
+        generate_archive_sources(sys.argv[2])
+    else:
+        print(__doc__.strip())
+        sys.exit(2)
@@ -4,6 +4,8 @@ import shutil
 import os
 import logging
 import re
+import json
+import subprocess
 
 # This module handles downloading and extracting CS2 demos from share codes.
 
@@ -15,6 +17,12 @@ API_URLS = [
     "https://previously-eva-frank-excessive.trycloudflare.com/decode"
     
 ]
+# Native tools of the CSDM fork, built with `make build` in csdm-fork/demo-tools. When present, demos are
+# decompressed and indexed while they're downloaded instead of after.
+DEMO_TOOLS_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'csdm-fork', 'demo-tools', 'build',
+                               'demo-tools.exe' if os.name == 'nt' else 'demo-tools')
+STREAM_CHUNK_SIZE = 64 * 1024
+
 def parse_share_code(share_link_or_code):
     """Extracts the match share code from a full steam link or just the code."""
     match = re.search(r'(CSGO(-[A-Za-z0-9]{5}){5})', share_link_or_code)
@@ -34,6 +42,44 @@ def is_demo_url(input_string):
         return True
     return False
 
+def stream_demo(response, dem_filename):
+    """
+    Pipes the .dem.bz2 download into `demo-tools unpack`, which writes the .dem and its .dem.idx seek index
+    block by block as the bytes arrive. The .dem only appears once it's complete.
+
+    Returns:
+        bool: True if the demo was written.
+    """
+    command = [DEMO_TOOLS_PATH, 'unpack', '-', dem_filename]
+    process = subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    try:
+        try:
+            for chunk in response.iter_content(chunk_size=STREAM_CHUNK_SIZE):
+                process.stdin.write(chunk)
+        finally:
+            process.stdin.close()
+    except BrokenPipeError:
+        # The tool stopped on invalid data, its error is read below.
+        pass
+    except Exception:
+        process.kill()
+        process.wait()
+        raise
+
+    # The output is only a few lines, it fits in the pipes until the tool exits.
+    stdout = process.stdout.read()
+    stderr = process.stderr.read()
+    process.wait()
+    if process.returncode != 0:
+        logging.error(f"Streaming extraction failed: {stderr.decode(errors='replace').strip()}")
+        return False
+
+    # The first line is the header, printed as soon as it was decompressed, the last one the result.
+    result = json.loads(stdout.decode(errors='replace').splitlines()[-1])
+    logging.info(f"Demo extracted and indexed while downloading in {result['durationMs'] / 1000:.1f}s: "
+                 f"{result['fileSize']} bytes, checksum {result['checksum']}, {result['roundCount']} rounds")
+    return True
+
 def download_demo(share_code_or_url, download_folder):
     """
     Downloads a demo using either a share code (via CSReplay API) or a direct demo URL.
@@ -116,6 +162,12 @@ def download_demo(share_code_or_url, download_folder):
 
         with requests.get(download_url, stream=True) as r:
             r.raise_for_status()
+            if os.path.isfile(DEMO_TOOLS_PATH):
+                if not stream_demo(r, dem_filename):
+                    return None
+                logging.info(f"Extraction complete. Demo saved to: {dem_filename}")
+                return dem_filename
+
             with open(bz2_filename, 'wb') as f:
                 for chunk in r.iter_content(chunk_size=8192):
                     f.write(chunk)